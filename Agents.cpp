@@ -0,0 +1,226 @@
+#include "Agents.hpp"
+
+#include "WorkerPool.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <limits>
+
+uint32_t Agents::add(Scene::Transform *transform, Params const &params, std::vector< glm::vec3 > const &route) {
+	assert(transform);
+	if (!(params.view_distance >= 0.0f)) {
+		throw std::runtime_error("Agent view distance must not be negative (got " + std::to_string(params.view_distance) + ").");
+	}
+
+	uint32_t id = size();
+	transforms.emplace_back(transform);
+	base_rotation.emplace_back(transform->rotation);
+
+	waypoint_begin.emplace_back(uint32_t(waypoints.size()));
+	waypoint_count.emplace_back(uint32_t(route.size()));
+	waypoint_capacity.emplace_back(uint32_t(route.size()));
+	waypoints.insert(waypoints.end(), route.begin(), route.end());
+	waypoint_pause.insert(waypoint_pause.end(), route.size(), params.wait_at_point);
+	waypoint_index.emplace_back(0);
+	wait_timer.emplace_back(0.0f);
+
+	speed.emplace_back(params.speed);
+	wait_at_point.emplace_back(params.wait_at_point);
+	reach_epsilon.emplace_back(params.reach_epsilon);
+	turn_speed.emplace_back(params.turn_speed);
+	view_distance.emplace_back(params.view_distance);
+	cos_half_fov.emplace_back(std::cos(glm::radians(params.fov_degrees * 0.5f)));
+	grace.emplace_back(params.grace);
+	eye.emplace_back(params.eye);
+
+	watching.emplace_back(0);
+	latched.emplace_back(0);
+	grace_timer.emplace_back(0.0f);
+	watched_time.emplace_back(0.0f);
+
+	return id;
+}
+
+void Agents::set_route(uint32_t id, std::vector< glm::vec3 > const &route, std::vector< float > const &pauses) {
+	assert(id < size());
+	if (!pauses.empty() && pauses.size() != route.size()) {
+		throw std::runtime_error("Route has " + std::to_string(route.size()) + " waypoints but " + std::to_string(pauses.size()) + " pauses.");
+	}
+	if (route.size() > waypoint_capacity[id]) {
+		waypoint_begin[id] = uint32_t(waypoints.size());
+		waypoint_capacity[id] = uint32_t(route.size());
+		waypoints.resize(waypoints.size() + route.size());
+		waypoint_pause.resize(waypoints.size());
+	}
+	std::copy(route.begin(), route.end(), waypoints.begin() + waypoint_begin[id]);
+	if (pauses.empty()) std::fill_n(waypoint_pause.begin() + waypoint_begin[id], route.size(), wait_at_point[id]);
+	else std::copy(pauses.begin(), pauses.end(), waypoint_pause.begin() + waypoint_begin[id]);
+	waypoint_count[id] = uint32_t(route.size());
+
+	//pick up the route wherever the agent is now:
+	glm::vec2 at = glm::vec2(transforms[id]->position);
+	uint32_t nearest = 0;
+	float best = std::numeric_limits< float >::infinity();
+	for (uint32_t k = 0; k < route.size(); ++k) {
+		glm::vec2 d = glm::vec2(route[k]) - at;
+		if (glm::dot(d, d) < best) {
+			best = glm::dot(d, d);
+			nearest = k;
+		}
+	}
+	waypoint_index[id] = nearest;
+}
+
+void Agents::for_each_range(std::function< void(uint32_t, uint32_t) > const &fn) {
+	uint32_t count = size();
+	uint32_t chunk = std::max(1U, chunk_size);
+	uint32_t chunks = (count + chunk - 1) / chunk;
+	if (count >= parallel_threshold && chunks > 1 && WorkerPool::get().size() > 0) {
+		WorkerPool::get().parallel_for(chunks, [&](uint32_t c) {
+			fn(c * chunk, std::min(count, (c + 1) * chunk));
+		});
+	} else {
+		fn(0, count);
+	}
+}
+
+//rotation by 'yaw' about +z, where (sin(yaw), cos(yaw)) = (x, y) is a unit vector:
+// (half-angle formulas, so no atan2 is needed)
+static inline glm::quat yaw_toward(float x, float y) {
+	float c = std::sqrt(std::max(0.0f, 0.5f * (1.0f + y)));
+	float s = std::copysign(std::sqrt(std::max(0.0f, 0.5f * (1.0f - y))), x);
+	return glm::quat(c, 0.0f, 0.0f, s);
+}
+
+void Agents::update(float elapsed, glm::vec3 const &target) {
+	PROFILE_SCOPE("Agents::update");
+	uint32_t count = size();
+
+	eye_x.resize(count); eye_y.resize(count); eye_z.resize(count);
+	forward_x.resize(count); forward_y.resize(count); forward_z.resize(count);
+	local_target_x.resize(count); local_target_y.resize(count);
+	in_range.resize(count);
+	in_view.resize(count);
+	blocked.resize(count);
+
+	//read transforms:
+	// (world matrices are only read -- they are as of the scene's last update_world_matrices() -- so this pass splits too)
+	for_each_range([&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			Scene::Transform const *transform = transforms[i];
+			glm::mat4x3 world_from_local = transform->make_world_from_local();
+
+			glm::vec3 at = world_from_local * glm::vec4(eye[i], 1.0f);
+			eye_x[i] = at.x; eye_y[i] = at.y; eye_z[i] = at.z;
+
+			glm::vec3 forward = -world_from_local[1];
+			float length = glm::length(forward);
+			if (length > 0.0f) forward /= length;
+			forward_x[i] = forward.x; forward_y[i] = forward.y; forward_z[i] = forward.z;
+
+			glm::vec3 local_target = target;
+			if (transform->parent) local_target = transform->parent->make_local_from_world() * glm::vec4(target, 1.0f);
+			local_target_x[i] = local_target.x; local_target_y[i] = local_target.y;
+		}
+	});
+
+	//sense -- distance and field of view:
+	for_each_range([&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			float dx = target.x - eye_x[i], dy = target.y - eye_y[i], dz = target.z - eye_z[i];
+			float distance2 = dx * dx + dy * dy + dz * dz;
+			float along = forward_x[i] * dx + forward_y[i] * dy + forward_z[i] * dz;
+			float range = view_distance[i];
+			float c = cos_half_fov[i];
+			//along / |d| > c, without a square root (x * |x| keeps the order of x, so fields of view over 180 degrees work):
+			uint8_t r = (distance2 <= range * range);
+			uint8_t v = r & (distance2 > 1e-8f) & (along * std::abs(along) > c * std::abs(c) * distance2);
+			in_range[i] = r;
+			in_view[i] = v;
+		}
+	});
+
+	//line of sight, for agents that could see the target or are checking on it:
+	rays.clear();
+	ray_agent.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		blocked[i] = 0;
+		if (line_of_sight && (in_view[i] | (latched[i] & in_range[i]))) {
+			rays.emplace_back(RayCaster::segment(glm::vec3(eye_x[i], eye_y[i], eye_z[i]), target));
+			ray_agent.emplace_back(i);
+		}
+	}
+	sight_tests = uint32_t(rays.size());
+	if (!rays.empty()) {
+		ray_blocked.resize(rays.size());
+		line_of_sight->occluded(rays.size(), rays.data(), ray_blocked.data(), line_of_sight_ignore);
+		for (uint32_t r = 0; r < rays.size(); ++r) {
+			blocked[ray_agent[r]] = ray_blocked[r];
+		}
+	}
+
+	//latch and grace timers:
+	for_each_range([&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			uint8_t seen = in_view[i] & (blocked[i] ^ 1);
+			uint8_t still = in_range[i] & (blocked[i] ^ 1);
+			uint8_t was = latched[i];
+
+			//seeing the target (or still having it in range while latched) refreshes the grace period; lapses count it down:
+			float timer = ((seen | (was & still)) ? grace[i] : grace_timer[i] - elapsed);
+			grace_timer[i] = timer;
+			latched[i] = seen | (was & (still | (timer > 0.0f)));
+			watching[i] = seen;
+			watched_time[i] = (seen ? watched_time[i] + elapsed : 0.0f);
+		}
+	});
+
+	//move and turn -- latched agents face the target, others patrol:
+	for_each_range([&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			Scene::Transform *transform = transforms[i];
+			glm::vec2 position = glm::vec2(transform->position);
+
+			glm::vec2 heading = glm::vec2(0.0f); //unit direction to face (zero => keep rotation)
+			if (latched[i]) {
+				//stand still, only turning toward the target:
+				glm::vec2 to = glm::vec2(local_target_x[i], local_target_y[i]) - position;
+				float distance = glm::length(to);
+				if (distance > 1e-4f) heading = to / distance;
+			} else if (waypoint_count[i] != 0) {
+				if (wait_timer[i] > 0.0f) {
+					wait_timer[i] = std::max(0.0f, wait_timer[i] - elapsed);
+				} else {
+					glm::vec2 to = glm::vec2(waypoints[waypoint_begin[i] + waypoint_index[i]]) - position;
+					float distance = glm::length(to);
+					if (distance <= reach_epsilon[i]) {
+						wait_timer[i] = waypoint_pause[waypoint_begin[i] + waypoint_index[i]];
+						waypoint_index[i] = (waypoint_index[i] + 1) % waypoint_count[i];
+					} else if (distance > 0.0f) {
+						heading = to / distance;
+						float step = std::min(speed[i] * elapsed, distance);
+						transform->position.x += heading.x * step;
+						transform->position.y += heading.y * step;
+					}
+				}
+			}
+
+			if (heading != glm::vec2(0.0f)) {
+				glm::quat facing = yaw_toward(heading.x, heading.y) * base_rotation[i];
+				transform->rotation = glm::slerp(transform->rotation, facing, 1.0f - std::exp(-turn_speed[i] * elapsed));
+			}
+		}
+	});
+
+	watching_count = 0;
+	latched_count = 0;
+	longest_watch = 0.0f;
+	for (uint32_t i = 0; i < count; ++i) {
+		watching_count += watching[i];
+		latched_count += latched[i];
+		longest_watch = std::max(longest_watch, watched_time[i]);
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+ * Agents runs many patrolling, watching characters (zoo visitors, keepers, ...) at once:
+ *
+ * Agents agents;
+ * Agents::Params params; //speed, view distance, field of view, ...
+ * uint32_t id = agents.add(transform, params, { waypoint_a, waypoint_b, ... });
+ *
+ * //each frame (after scene.update_world_matrices(), since agents start from their transforms' world matrices):
+ * agents.update(elapsed, player_center_in_world);
+ * if (agents.watching[id]) { ... }
+ *
+ * Each agent walks its loop of waypoints (pausing at each) until it sees the target --
+ * within view distance, inside its field of view, and (with 'line_of_sight' set) with no scene triangles in the way.
+ * Once it has seen the target it stands still and turns to face it, and keeps doing so while the target stays
+ * in range and unblocked; after the target has been out of range or blocked for 'grace' seconds, it goes back to patrolling.
+ *
+ * State is kept per agent in structure-of-arrays form, and update() makes a few passes over all agents:
+ * read transforms -> sense (distance / field of view) -> line of sight (one batched RayCaster call) -> latch timers -> move and turn.
+ * The sensing and timer passes are plain arithmetic over float arrays (written so compilers can vectorize them);
+ * big crowds are split into chunks that run on WorkerPool::get().
+ *
+ * Agent positions and waypoints are in the agent's parent's space, and only change in x and y (agents stay on the ground);
+ * "forward" is the agent's world -y axis (as with the zoo's "Enemy").
+ *
+ */
+
+#include "Scene.hpp"
+#include "RayCaster.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+struct Agents {
+	//tuning, per agent:
+	struct Params {
+		float speed = 6.0f; //walking speed (units / second)
+		float wait_at_point = 0.4f; //pause at each waypoint (seconds)
+		float reach_epsilon = 0.15f; //how close to a waypoint counts as reaching it
+		float turn_speed = 8.0f; //rate of turning toward the walking direction or target (1 / seconds)
+		float view_distance = 10.0f; //how far the agent can see
+		float fov_degrees = 70.0f; //field of view (full angle)
+		float grace = 0.15f; //seconds the target can be out of sight before the agent stops watching
+		glm::vec3 eye = glm::vec3(0.0f); //(agent-local) where the agent sees from
+	};
+
+	//start simulating an agent; returns its index in the arrays below:
+	// the agent's current rotation is taken to be "facing +y" (turning is relative to it)
+	// with no waypoints, the agent stands still (but still watches and turns)
+	uint32_t add(Scene::Transform *transform, Params const &params, std::vector< glm::vec3 > const &waypoints);
+
+	//replace an agent's route (e.g., with a path from NavMesh), continuing from the new waypoint nearest the agent:
+	// 'pauses' (if not empty) gives the seconds to wait at each waypoint; otherwise the agent's wait_at_point is used
+	// (routes are stored together in 'waypoints'; a route that doesn't fit in the old one's place is appended)
+	void set_route(uint32_t id, std::vector< glm::vec3 > const &route, std::vector< float > const &pauses = {});
+
+	//advance all agents by 'elapsed' seconds, watching for a target at 'target' (in world space):
+	void update(float elapsed, glm::vec3 const &target);
+
+	uint32_t size() const { return uint32_t(transforms.size()); }
+
+	//(optional) line-of-sight tests against scene triangles; without it, nothing blocks the view:
+	RayCaster const *line_of_sight = nullptr;
+	RayCaster::Ignore line_of_sight_ignore; //(passed along to line_of_sight)
+
+	//crowds of at least this many agents are updated on multiple threads (-1U to never do so):
+	uint32_t parallel_threshold = 512;
+	//agents per chunk handed to a thread:
+	uint32_t chunk_size = 256;
+
+	//--- results of the last update() ---
+
+	uint32_t watching_count = 0; //agents with 'watching' set
+	uint32_t latched_count = 0; //agents with 'latched' set
+	float longest_watch = 0.0f; //largest 'watched_time'
+	uint32_t sight_tests = 0; //line-of-sight rays cast
+
+	//--- per agent (structure-of-arrays) ---
+
+	std::vector< Scene::Transform * > transforms;
+	std::vector< glm::quat > base_rotation; //rotation when added ("facing +y")
+
+	//route: waypoints[waypoint_begin[i] + k] for k in [0, waypoint_count[i]):
+	std::vector< glm::vec3 > waypoints; //(shared by all agents)
+	std::vector< float > waypoint_pause; //seconds to wait on reaching each waypoint (parallel to 'waypoints')
+	std::vector< uint32_t > waypoint_begin, waypoint_count;
+	std::vector< uint32_t > waypoint_capacity; //room at waypoint_begin (>= waypoint_count)
+	std::vector< uint32_t > waypoint_index; //current waypoint (in [0, waypoint_count))
+	std::vector< float > wait_timer; //seconds left to pause at the current waypoint
+
+	//tuning (from Params; cos_half_fov is precomputed):
+	std::vector< float > speed, wait_at_point, reach_epsilon, turn_speed, view_distance, cos_half_fov, grace;
+	std::vector< glm::vec3 > eye;
+
+	//vision state:
+	std::vector< uint8_t > watching; //saw the target this update
+	std::vector< uint8_t > latched; //standing and watching the target (stays set through short lapses)
+	std::vector< float > grace_timer; //seconds left before a lapse un-latches
+	std::vector< float > watched_time; //seconds the target has been seen continuously (0 when not 'watching')
+
+	//--- internals ---
+
+	//per-update scratch, filled from transforms (world-space unless noted):
+	std::vector< float > eye_x, eye_y, eye_z;
+	std::vector< float > forward_x, forward_y, forward_z; //(unit length)
+	std::vector< float > local_target_x, local_target_y; //target in the agent's parent space
+	std::vector< uint8_t > in_range; //target within view distance
+	std::vector< uint8_t > in_view; //...and inside the field of view
+	std::vector< uint8_t > blocked; //line of sight to target blocked (only set for agents that needed a test)
+	std::vector< RayCaster::Ray > rays;
+	std::vector< uint32_t > ray_agent;
+	std::vector< uint8_t > ray_blocked;
+
+	//run fn(begin, end) over ranges covering all agents (on several threads for big crowds):
+	void for_each_range(std::function< void(uint32_t, uint32_t) > const &fn);
+};
@@ -0,0 +1,229 @@
+#include "BVH.hpp"
+
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+void BVH::resize(uint32_t count) {
+	if (count == size()) return;
+	item_min.resize(count, glm::vec3( std::numeric_limits< float >::infinity()));
+	item_max.resize(count, glm::vec3(-std::numeric_limits< float >::infinity()));
+	structure_changed = true;
+}
+
+void BVH::set(uint32_t item, glm::vec3 const &min, glm::vec3 const &max) {
+	assert(item < size());
+	if (item_min[item] == min && item_max[item] == max) return;
+	if (empty(item_min[item], item_max[item]) != empty(min, max)) structure_changed = true;
+	else boxes_changed = true;
+	item_min[item] = min;
+	item_max[item] = max;
+}
+
+void BVH::update() {
+	if (structure_changed) {
+		rebuild.reset(); //(any background build is for the old set of items)
+		build(item_min, item_max, &nodes, &order);
+		cost = built_cost = refit();
+		structure_changed = boxes_changed = false;
+		builds += 1;
+		return;
+	}
+
+	//swap in a finished background build:
+	bool adopted = false;
+	if (rebuild && rebuild->done.load(std::memory_order_acquire)) {
+		if (rebuild->item_count == size()) {
+			nodes = std::move(rebuild->nodes);
+			order = std::move(rebuild->order);
+			boxes_changed = true; //(items may have moved since the build started)
+			adopted = true;
+			background_builds += 1;
+		}
+		rebuild.reset();
+	}
+
+	if (boxes_changed) {
+		cost = refit();
+		if (adopted) built_cost = cost;
+		boxes_changed = false;
+		refits += 1;
+	}
+
+	//tree has degraded -- build a fresh one in the background:
+	if (!rebuild && cost > rebuild_ratio * built_cost) {
+		rebuild = std::make_shared< Rebuild >();
+		rebuild->item_count = size();
+		//(job works on a snapshot of the boxes and only touches its own Rebuild)
+		auto job = [job_rebuild = rebuild, snapshot_min = item_min, snapshot_max = item_max]() {
+			build(snapshot_min, snapshot_max, &job_rebuild->nodes, &job_rebuild->order);
+			job_rebuild->done.store(true, std::memory_order_release);
+		};
+		WorkerPool::get().run(job);
+	}
+}
+
+void BVH::build(std::vector< glm::vec3 > const &item_min, std::vector< glm::vec3 > const &item_max, std::vector< Node > *nodes_, std::vector< uint32_t > *order_) {
+	assert(nodes_);
+	assert(order_);
+	auto &nodes = *nodes_;
+	auto &order = *order_;
+
+	nodes.clear();
+	order.clear();
+
+	//items with boxes, and the centroids used to sort them:
+	std::vector< glm::vec3 > centroid(item_min.size());
+	for (uint32_t i = 0; i < uint32_t(item_min.size()); ++i) {
+		if (empty(item_min[i], item_max[i])) continue;
+		order.emplace_back(i);
+		centroid[i] = 0.5f * (item_min[i] + item_max[i]);
+	}
+	if (order.empty()) return;
+
+	nodes.reserve(2 * (order.size() / LeafSize + 1));
+
+	auto area = [](glm::vec3 const &min, glm::vec3 const &max) {
+		glm::vec3 size = max - min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	};
+
+	struct Task {
+		uint32_t node;
+		uint32_t begin, end; //range in 'order'
+		uint32_t depth;
+	};
+	std::vector< Task > tasks;
+	nodes.emplace_back();
+	tasks.emplace_back(Task{0, 0, uint32_t(order.size()), 0});
+
+	while (!tasks.empty()) {
+		Task task = tasks.back();
+		tasks.pop_back();
+		uint32_t count = task.end - task.begin;
+
+		//bounds (boxes are filled in later by refit(); centroid bounds pick the split axis):
+		glm::vec3 c_min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 c_max = glm::vec3(-std::numeric_limits< float >::infinity());
+		for (uint32_t i = task.begin; i < task.end; ++i) {
+			c_min = glm::min(c_min, centroid[order[i]]);
+			c_max = glm::max(c_max, centroid[order[i]]);
+		}
+
+		if (count <= LeafSize) {
+			nodes[task.node].first = task.begin;
+			nodes[task.node].count = count;
+			continue;
+		}
+
+		glm::vec3 c_size = c_max - c_min;
+		uint32_t axis = (c_size.x >= c_size.y && c_size.x >= c_size.z ? 0 : (c_size.y >= c_size.z ? 1 : 2));
+
+		uint32_t mid = task.begin;
+		if (c_size[axis] > 0.0f && task.depth < 32) {
+			//binned surface area heuristic:
+			constexpr uint32_t Bins = 12;
+			struct Bin {
+				glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+				glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+				uint32_t count = 0;
+			} bins[Bins];
+			float scale = float(Bins) / c_size[axis];
+			auto bin_of = [&](uint32_t item) {
+				return std::min(Bins - 1, uint32_t((centroid[item][axis] - c_min[axis]) * scale));
+			};
+			for (uint32_t i = task.begin; i < task.end; ++i) {
+				Bin &bin = bins[bin_of(order[i])];
+				bin.min = glm::min(bin.min, item_min[order[i]]);
+				bin.max = glm::max(bin.max, item_max[order[i]]);
+				bin.count += 1;
+			}
+
+			//sweep from the right to get costs of every right side, then from the left to pick the best split:
+			float right_cost[Bins];
+			{
+				glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+				glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+				uint32_t right_count = 0;
+				for (uint32_t b = Bins - 1; b > 0; --b) {
+					min = glm::min(min, bins[b].min);
+					max = glm::max(max, bins[b].max);
+					right_count += bins[b].count;
+					right_cost[b] = (right_count ? area(min, max) * float(right_count) : 0.0f);
+				}
+			}
+			float best_cost = std::numeric_limits< float >::infinity();
+			uint32_t best_split = 1;
+			{
+				glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+				glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+				uint32_t left_count = 0;
+				for (uint32_t b = 0; b + 1 < Bins; ++b) {
+					min = glm::min(min, bins[b].min);
+					max = glm::max(max, bins[b].max);
+					left_count += bins[b].count;
+					if (left_count == 0 || left_count == count) continue;
+					float split_cost = area(min, max) * float(left_count) + right_cost[b + 1];
+					if (split_cost < best_cost) {
+						best_cost = split_cost;
+						best_split = b + 1;
+					}
+				}
+			}
+
+			if (best_cost < std::numeric_limits< float >::infinity()) {
+				mid = uint32_t(std::partition(order.begin() + task.begin, order.begin() + task.end, [&](uint32_t item) {
+					return bin_of(item) < best_split;
+				}) - order.begin());
+			}
+		}
+
+		//no useful split (all centroids together, or very deep)? split in half:
+		// (which also bounds the depth of the tree -- queries use fixed-size stacks)
+		if (mid == task.begin || mid == task.end) {
+			mid = task.begin + count / 2;
+			std::nth_element(order.begin() + task.begin, order.begin() + mid, order.begin() + task.end, [&](uint32_t a, uint32_t b) {
+				return centroid[a][axis] < centroid[b][axis];
+			});
+		}
+
+		uint32_t first = uint32_t(nodes.size());
+		nodes.emplace_back();
+		nodes.emplace_back();
+		nodes[task.node].first = first;
+		nodes[task.node].count = 0;
+		tasks.emplace_back(Task{first, task.begin, mid, task.depth + 1});
+		tasks.emplace_back(Task{first + 1, mid, task.end, task.depth + 1});
+	}
+}
+
+float BVH::refit() {
+	if (nodes.empty()) return 0.0f;
+
+	//children always come after their parents, so walk backward:
+	float total = 0.0f;
+	for (uint32_t n = uint32_t(nodes.size()) - 1; n < nodes.size(); --n) {
+		Node &node = nodes[n];
+		if (node.count > 0) {
+			node.min = item_min[order[node.first]];
+			node.max = item_max[order[node.first]];
+			for (uint32_t i = node.first + 1; i < node.first + node.count; ++i) {
+				node.min = glm::min(node.min, item_min[order[i]]);
+				node.max = glm::max(node.max, item_max[order[i]]);
+			}
+		} else {
+			node.min = glm::min(nodes[node.first].min, nodes[node.first + 1].min);
+			node.max = glm::max(nodes[node.first].max, nodes[node.first + 1].max);
+		}
+		glm::vec3 size = node.max - node.min;
+		float area = size.x * size.y + size.y * size.z + size.z * size.x;
+		total += area * float(node.count > 0 ? node.count : 1);
+	}
+
+	//cost relative to the root's area, so that moving everything together doesn't look like degradation:
+	glm::vec3 size = nodes[0].max - nodes[0].min;
+	float root_area = size.x * size.y + size.y * size.z + size.z * size.x;
+	return (root_area > 0.0f ? total / root_area : 0.0f);
+}
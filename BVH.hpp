@@ -0,0 +1,219 @@
+#pragma once
+
+/*
+ * A BVH (bounding volume hierarchy) is a binary tree of axis-aligned boxes over
+ * a set of "items" (each with its own box), used to answer spatial queries
+ * without looking at every item:
+ *
+ * BVH bvh;
+ * bvh.resize(count);
+ * for (uint32_t i = 0; i < count; ++i) bvh.set(i, min[i], max[i]);
+ * bvh.update(); //build (or refit) as needed
+ *
+ * bvh.for_each_in_frustum(frustum, [&](uint32_t item) { ... });
+ * bvh.for_each_overlapping(min, max, [&](uint32_t item) { ... });
+ * bvh.for_each_on_ray(from, dir, t_max, [&](uint32_t item, float t) -> bool { ...; return stop; });
+ *
+ * Moving items only refits the existing tree; when refitting has made the tree
+ * much worse than a fresh build (by surface area heuristic cost), a new tree is built
+ * on a WorkerPool thread and swapped in by a later update().
+ *
+ * Items with empty boxes (min > max) are kept out of the tree and never returned by queries.
+ *
+ */
+
+#include "Frustum.hpp"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+struct BVH {
+	struct Node {
+		glm::vec3 min;
+		uint32_t first; //leaf: index of first item in 'order'; interior: index of first child (second child is first+1)
+		glm::vec3 max;
+		uint32_t count; //leaf: number of items (> 0); interior: 0
+	};
+	static_assert(sizeof(Node) == 32, "Node is packed.");
+
+	//maximum number of items in a leaf:
+	static constexpr uint32_t LeafSize = 4;
+
+	//--- items ---
+
+	//set the number of items (new items start empty):
+	void resize(uint32_t count);
+	uint32_t size() const { return uint32_t(item_min.size()); }
+
+	//set the (world space) box of an item:
+	void set(uint32_t item, glm::vec3 const &min, glm::vec3 const &max);
+
+	//bring the tree up to date with the item boxes:
+	// builds synchronously if items were added/removed or changed between empty and non-empty;
+	// otherwise refits, adopting a finished background rebuild if there is one
+	void update();
+
+	//--- queries (call after update()) ---
+
+	//fn(item) for every item whose box intersects the frustum:
+	// (items in nodes entirely inside the frustum aren't tested individually)
+	template< typename F >
+	void for_each_in_frustum(Frustum const &frustum, F &&fn) const;
+
+	//fn(item) for every item whose box overlaps [min,max]:
+	template< typename F >
+	void for_each_overlapping(glm::vec3 const &min, glm::vec3 const &max, F &&fn) const;
+
+	//fn(item, t) for every item whose box is hit by the ray from + t * dir, 0 <= t <= t_max,
+	// where 't' is where the ray enters the box; nearer nodes are visited first.
+	// return true from fn to stop early
+	template< typename F >
+	void for_each_on_ray(glm::vec3 const &from, glm::vec3 const &dir, float t_max, F &&fn) const;
+
+	//--- statistics ---
+
+	mutable uint32_t nodes_visited = 0; //running count of nodes visited by queries (reset it whenever you like)
+	float cost = 0.0f; //surface area heuristic cost of the current tree
+	float built_cost = 0.0f; //...when it was last (re-)built
+	uint32_t builds = 0, refits = 0, background_builds = 0; //running counts of update() outcomes
+
+	//rebuild in the background when refitting has made the tree this much more costly than when it was built:
+	float rebuild_ratio = 1.5f;
+
+	//--- internals ---
+
+	std::vector< Node > nodes; //nodes[0] is the root (if there are any non-empty items)
+	std::vector< uint32_t > order; //non-empty items, grouped by leaf
+	std::vector< glm::vec3 > item_min, item_max;
+
+	bool structure_changed = true; //items added/removed or changed between empty and non-empty
+	bool boxes_changed = false; //some item box changed since the last update()
+
+	//a tree being built on a worker thread:
+	struct Rebuild {
+		std::atomic< bool > done{false};
+		uint32_t item_count = 0;
+		std::vector< Node > nodes;
+		std::vector< uint32_t > order;
+	};
+	std::shared_ptr< Rebuild > rebuild;
+
+	//build a tree (binned SAH) over the non-empty items in [item_min,item_max):
+	static void build(std::vector< glm::vec3 > const &item_min, std::vector< glm::vec3 > const &item_max, std::vector< Node > *nodes, std::vector< uint32_t > *order);
+
+	//recompute node boxes from item boxes; returns the surface area heuristic cost:
+	float refit();
+
+	static bool empty(glm::vec3 const &min, glm::vec3 const &max) {
+		return !(min.x <= max.x && min.y <= max.y && min.z <= max.z);
+	}
+};
+
+//----------------------------
+//query implementations:
+
+template< typename F >
+void BVH::for_each_in_frustum(Frustum const &frustum, F &&fn) const {
+	if (nodes.empty()) return;
+	//stack of (node, whether it is known to be entirely inside):
+	uint32_t stack[64];
+	bool inside[64];
+	uint32_t top = 0;
+	stack[top] = 0; inside[top] = false; ++top;
+	while (top > 0) {
+		--top;
+		Node const &node = nodes[stack[top]];
+		bool all = inside[top];
+		nodes_visited += 1;
+		if (!all) {
+			Frustum::Overlap overlap = frustum.classify(node.min, node.max);
+			if (overlap == Frustum::Outside) continue;
+			all = (overlap == Frustum::Inside);
+		}
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				uint32_t item = order[i];
+				if (all || node.count == 1 || frustum.intersects(item_min[item], item_max[item])) fn(item);
+			}
+		} else {
+			stack[top] = node.first; inside[top] = all; ++top;
+			stack[top] = node.first + 1; inside[top] = all; ++top;
+		}
+	}
+}
+
+template< typename F >
+void BVH::for_each_overlapping(glm::vec3 const &min, glm::vec3 const &max, F &&fn) const {
+	if (nodes.empty()) return;
+	auto overlaps = [&](glm::vec3 const &a_min, glm::vec3 const &a_max) {
+		return a_min.x <= max.x && min.x <= a_max.x
+		    && a_min.y <= max.y && min.y <= a_max.y
+		    && a_min.z <= max.z && min.z <= a_max.z;
+	};
+	uint32_t stack[64];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		Node const &node = nodes[stack[--top]];
+		nodes_visited += 1;
+		if (!overlaps(node.min, node.max)) continue;
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				uint32_t item = order[i];
+				if (node.count == 1 || overlaps(item_min[item], item_max[item])) fn(item);
+			}
+		} else {
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+}
+
+template< typename F >
+void BVH::for_each_on_ray(glm::vec3 const &from, glm::vec3 const &dir, float t_max, F &&fn) const {
+	if (nodes.empty()) return;
+	glm::vec3 inv_dir = 1.0f / dir; //(infinite for zero components, which the slab test handles)
+
+	//returns the entry distance, or infinity if the box is missed:
+	auto enter = [&](glm::vec3 const &min, glm::vec3 const &max) -> float {
+		glm::vec3 t0 = (min - from) * inv_dir;
+		glm::vec3 t1 = (max - from) * inv_dir;
+		glm::vec3 t_near = glm::min(t0, t1);
+		glm::vec3 t_far = glm::max(t0, t1);
+		float t_enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+		float t_exit = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, t_max));
+		//(written so that NaNs -- from 0 * infinity on a slab boundary -- count as misses)
+		if (!(t_enter <= t_exit)) return std::numeric_limits< float >::infinity();
+		return t_enter;
+	};
+
+	uint32_t stack[64];
+	uint32_t top = 0;
+	if (enter(nodes[0].min, nodes[0].max) == std::numeric_limits< float >::infinity()) return;
+	stack[top++] = 0;
+	while (top > 0) {
+		Node const &node = nodes[stack[--top]];
+		nodes_visited += 1;
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				uint32_t item = order[i];
+				float t = enter(item_min[item], item_max[item]);
+				if (t != std::numeric_limits< float >::infinity() && fn(item, t)) return;
+			}
+		} else {
+			float t_a = enter(nodes[node.first].min, nodes[node.first].max);
+			float t_b = enter(nodes[node.first + 1].min, nodes[node.first + 1].max);
+			uint32_t a = node.first, b = node.first + 1;
+			if (t_b < t_a) { std::swap(a, b); std::swap(t_a, t_b); }
+			//push farther child first so nearer is visited first:
+			if (t_b != std::numeric_limits< float >::infinity()) stack[top++] = b;
+			if (t_a != std::numeric_limits< float >::infinity()) stack[top++] = a;
+		}
+	}
+}
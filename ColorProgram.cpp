@@ -1,5 +1,6 @@
 #include "ColorProgram.hpp"
 
+#include "UniformBlocks.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -9,13 +10,13 @@ ColorProgram::ColorProgram() {
 	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
 	program = gl_compile_program(
 		//vertex shader:
-		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
+		std::string("#version 330\n")
+		+ UniformBlocks::ObjectGLSL +
 		"in vec4 Position;\n"
 		"in vec4 Color;\n"
 		"out vec4 color;\n"
 		"void main() {\n"
-		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
+		"	gl_Position = CLIP_FROM_OBJECT * Position;\n"
 		"	color = Color;\n"
 		"}\n"
 	,
@@ -34,8 +35,8 @@ ColorProgram::ColorProgram() {
 	Position_vec4 = glGetAttribLocation(program, "Position");
 	Color_vec4 = glGetAttribLocation(program, "Color");
 
-	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
+	//attach uniform blocks to their binding points:
+	UniformBlocks::bind_blocks(program);
 }
 
 ColorProgram::~ColorProgram() {
@@ -12,8 +12,8 @@ struct ColorProgram {
 	//Attribute (per-vertex variable) locations:
 	GLuint Position_vec4 = -1U;
 	GLuint Color_vec4 = -1U;
-	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
+	//Uniforms:
+	//Object block - CLIP_FROM_OBJECT (see UniformBlocks.hpp)
 	//Textures:
 	// none
 };
@@ -1,5 +1,6 @@
 #include "ColorTextureProgram.hpp"
 
+#include "GLState.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -50,6 +51,7 @@ ColorTextureProgram::ColorTextureProgram() {
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
 
 	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+	gl_state.invalidate(); //(program was bound directly)
 }
 
 ColorTextureProgram::~ColorTextureProgram() {
@@ -1,6 +1,8 @@
 #include "DrawLines.hpp"
 #include "PathFont.hpp"
 #include "ColorProgram.hpp"
+#include "UniformBlocks.hpp"
+#include "GLState.hpp"
 
 #include "gl_errors.hpp"
 
@@ -57,6 +59,9 @@ static Load< void > setup_buffers(LoadTagDefault, [](){
 
 		//done setting up vertex array object, so unbind it:
 		glBindVertexArray(0);
+
+		//(vao and buffer were bound directly, so gl_state no longer knows what is bound)
+		gl_state.invalidate();
 	}
 
 	GL_ERRORS(); //PARANOIA: make sure nothing strange happened during setup
@@ -138,27 +143,24 @@ DrawLines::~DrawLines() {
 	//based on DrawSprites.cpp :
 
 	//upload vertices to vertex_buffer:
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer); //set vertex_buffer as current
+	gl_state.bind_array_buffer(vertex_buffer); //set vertex_buffer as current
 	glBufferData(GL_ARRAY_BUFFER, attribs.size() * sizeof(attribs[0]), attribs.data(), GL_STREAM_DRAW); //upload attribs array
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	//set color_program as current program:
-	glUseProgram(color_program->program);
+	gl_state.use_program(color_program->program);
 
-	//upload OBJECT_TO_CLIP to the proper uniform location:
-	glUniformMatrix4fv(color_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
+	//stream CLIP_FROM_OBJECT into the Object uniform block:
+	UniformBlocks::Object object;
+	object.set(world_to_clip);
+	UniformBlocks::bind_object(UniformBlocks::stream_objects(&object, sizeof(object)));
 
 	//use the mapping vertex_buffer_for_color_program to fetch vertex data:
-	glBindVertexArray(vertex_buffer_for_color_program);
+	gl_state.bind_vertex_array(vertex_buffer_for_color_program);
 
 	//run the OpenGL pipeline:
 	glDrawArrays(GL_LINES, 0, GLsizei(attribs.size()));
 
-	//reset vertex array to none:
-	glBindVertexArray(0);
-
-	//reset current program to none:
-	glUseProgram(0);
+	//(program, vertex array, and buffer stay bound -- gl_state skips re-binding them for the next DrawLines)
 }
 
 
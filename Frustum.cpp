@@ -0,0 +1,143 @@
+#include "Frustum.hpp"
+
+#include <limits>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+Frustum Frustum::from_clip(glm::mat4 const &clip_from_world) {
+	//rows of the (column-major) matrix:
+	auto row = [&](int r) {
+		return glm::vec4(clip_from_world[0][r], clip_from_world[1][r], clip_from_world[2][r], clip_from_world[3][r]);
+	};
+	glm::vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+
+	Frustum ret;
+	ret.planes[0] = w + x; //left
+	ret.planes[1] = w - x; //right
+	ret.planes[2] = w + y; //bottom
+	ret.planes[3] = w - y; //top
+	ret.planes[4] = w + z; //near
+	ret.planes[5] = w - z; //far
+	return ret;
+}
+
+bool Frustum::intersects(glm::vec3 const &min, glm::vec3 const &max) const {
+	glm::vec3 center = 0.5f * (max + min);
+	glm::vec3 extent = 0.5f * (max - min);
+	for (auto const &p : planes) {
+		float d = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+		float r = std::abs(p.x) * extent.x + std::abs(p.y) * extent.y + std::abs(p.z) * extent.z;
+		if (d + r < 0.0f) return false;
+	}
+	return true;
+}
+
+Frustum::Overlap Frustum::classify(glm::vec3 const &min, glm::vec3 const &max) const {
+	glm::vec3 center = 0.5f * (max + min);
+	glm::vec3 extent = 0.5f * (max - min);
+	Overlap ret = Inside;
+	for (auto const &p : planes) {
+		float d = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+		float r = std::abs(p.x) * extent.x + std::abs(p.y) * extent.y + std::abs(p.z) * extent.z;
+		if (d + r < 0.0f) return Outside;
+		if (d - r < 0.0f) ret = Partial;
+	}
+	return ret;
+}
+
+void Frustum::Boxes::resize(size_t count_) {
+	count = count_;
+	size_t padded = (count + 3) & ~size_t(3);
+	//(padding lanes are tested, but their results are never written)
+	center_x.resize(padded, 0.0f);
+	center_y.resize(padded, 0.0f);
+	center_z.resize(padded, 0.0f);
+	extent_x.resize(padded, 0.0f);
+	extent_y.resize(padded, 0.0f);
+	extent_z.resize(padded, 0.0f);
+}
+
+void Frustum::Boxes::set(size_t i, glm::mat4x3 const &world_from_local, glm::vec3 const &min, glm::vec3 const &max) {
+	if (!(min.x <= max.x && min.y <= max.y && min.z <= max.z)) {
+		//(not infinity: 0 * infinity would be NaN in the plane tests)
+		center_x[i] = center_y[i] = center_z[i] = 0.0f;
+		extent_x[i] = extent_y[i] = extent_z[i] = std::numeric_limits< float >::max();
+		return;
+	}
+
+	glm::vec3 center = 0.5f * (max + min);
+	glm::vec3 extent = 0.5f * (max - min);
+
+	//center transforms as a point; extent by the absolute value of the linear part:
+	glm::vec3 world_center = world_from_local * glm::vec4(center, 1.0f);
+	glm::vec3 world_extent =
+		  glm::abs(world_from_local[0]) * extent.x
+		+ glm::abs(world_from_local[1]) * extent.y
+		+ glm::abs(world_from_local[2]) * extent.z;
+
+	center_x[i] = world_center.x;
+	center_y[i] = world_center.y;
+	center_z[i] = world_center.z;
+	extent_x[i] = world_extent.x;
+	extent_y[i] = world_extent.y;
+	extent_z[i] = world_extent.z;
+}
+
+uint32_t Frustum::test(Boxes const &boxes, uint8_t *visible) const {
+	uint32_t visible_count = 0;
+	size_t count = boxes.size();
+
+#ifdef FRUSTUM_SSE
+	__m128 const sign = _mm_set1_ps(-0.0f);
+	__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+	for (uint32_t p = 0; p < 6; ++p) {
+		nx[p] = _mm_set1_ps(planes[p].x);
+		ny[p] = _mm_set1_ps(planes[p].y);
+		nz[p] = _mm_set1_ps(planes[p].z);
+		nw[p] = _mm_set1_ps(planes[p].w);
+		ax[p] = _mm_andnot_ps(sign, nx[p]);
+		ay[p] = _mm_andnot_ps(sign, ny[p]);
+		az[p] = _mm_andnot_ps(sign, nz[p]);
+	}
+
+	__m128 const zero = _mm_setzero_ps();
+	for (size_t i = 0; i < count; i += 4) {
+		__m128 cx = _mm_loadu_ps(&boxes.center_x[i]);
+		__m128 cy = _mm_loadu_ps(&boxes.center_y[i]);
+		__m128 cz = _mm_loadu_ps(&boxes.center_z[i]);
+		__m128 ex = _mm_loadu_ps(&boxes.extent_x[i]);
+		__m128 ey = _mm_loadu_ps(&boxes.extent_y[i]);
+		__m128 ez = _mm_loadu_ps(&boxes.extent_z[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (uint32_t p = 0; p < 6; ++p) {
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (size_t j = 0; j < 4 && i + j < count; ++j) {
+			visible[i + j] = ((mask >> j) & 1) ? 0 : 1;
+			visible_count += visible[i + j];
+		}
+	}
+#else
+	for (size_t i = 0; i < count; ++i) {
+		bool outside = false;
+		for (auto const &p : planes) {
+			float d = p.x * boxes.center_x[i] + p.y * boxes.center_y[i] + p.z * boxes.center_z[i] + p.w;
+			float r = std::abs(p.x) * boxes.extent_x[i] + std::abs(p.y) * boxes.extent_y[i] + std::abs(p.z) * boxes.extent_z[i];
+			outside = outside || (d + r < 0.0f);
+		}
+		visible[i] = (outside ? 0 : 1);
+		visible_count += visible[i];
+	}
+#endif
+
+	return visible_count;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+ * A Frustum is the set of six planes bounding the view volume of a clip_from_world matrix.
+ * It is used to skip objects that can't be seen.
+ *
+ * Boxes are tested in batches (four at a time with SSE, where available) from
+ * structure-of-arrays center/extent data -- see Frustum::Boxes.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct Frustum {
+	//planes as (nx, ny, nz, d); points with dot(n, p) + d >= 0 are inside:
+	// (planes are not normalized; order is left, right, bottom, top, near, far)
+	glm::vec4 planes[6];
+
+	//extract the planes of a clip_from_world matrix (Gribb & Hartmann):
+	// (works for infinite perspective matrices, whose far plane never rejects anything)
+	static Frustum from_clip(glm::mat4 const &clip_from_world);
+
+	//is the (world space, axis-aligned) box [min,max] at least partly inside?
+	// (conservative: boxes near corners of the frustum may be reported as inside)
+	bool intersects(glm::vec3 const &min, glm::vec3 const &max) const;
+
+	//classify a box as entirely outside, partly inside, or entirely inside:
+	// (same conservative test as intersects(); "Inside" is exact)
+	enum Overlap : uint8_t { Outside, Partial, Inside };
+	Overlap classify(glm::vec3 const &min, glm::vec3 const &max) const;
+
+	//a batch of axis-aligned boxes, as centers and half-extents:
+	struct Boxes {
+		std::vector< float > center_x, center_y, center_z;
+		std::vector< float > extent_x, extent_y, extent_z;
+
+		//resize (padding to a multiple of 4, so that batches never need a tail case):
+		void resize(size_t count);
+		size_t size() const { return count; }
+
+		//set box i to the bounds of local box [min,max] transformed by world_from_local:
+		// (an empty box -- min > max -- is made infinitely large, so that it is never culled)
+		void set(size_t i, glm::mat4x3 const &world_from_local, glm::vec3 const &min, glm::vec3 const &max);
+
+	private:
+		size_t count = 0;
+	};
+
+	//visible[i] = (box i intersects the frustum) for every box in the batch; returns the number of visible boxes:
+	uint32_t test(Boxes const &boxes, uint8_t *visible) const;
+};
@@ -0,0 +1,90 @@
+#include "GLState.hpp"
+
+GLState gl_state;
+
+bool GLState::use_program(GLuint program_) {
+	if (!change(program, program_)) return false;
+	glUseProgram(program_);
+	return true;
+}
+
+bool GLState::bind_vertex_array(GLuint vao_) {
+	if (!change(vao, vao_)) return false;
+	glBindVertexArray(vao_);
+	return true;
+}
+
+bool GLState::bind_array_buffer(GLuint buffer) {
+	if (!change(array_buffer, buffer)) return false;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	return true;
+}
+
+bool GLState::active_texture(uint32_t unit) {
+	if (!change(active_unit, unit)) return false;
+	glActiveTexture(GL_TEXTURE0 + unit);
+	return true;
+}
+
+uint32_t GLState::target_index(GLenum target) {
+	switch (target) {
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_3D: return 1;
+		case GL_TEXTURE_CUBE_MAP: return 2;
+		case GL_TEXTURE_2D_ARRAY: return 3;
+		case GL_TEXTURE_BUFFER: return 4;
+		default: return -1U;
+	}
+}
+
+bool GLState::bind_texture(uint32_t unit, GLenum target, GLuint texture) {
+	uint32_t index = target_index(target);
+	if (unit < TextureUnits && index != -1U) {
+		if (!change(textures[unit][index], texture)) return false;
+	} else {
+		counters.calls += 1;
+	}
+	//(not counted as a call of its own -- it's part of the bind)
+	if (!(active_unit.known && active_unit.value == unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		active_unit.known = true;
+		active_unit.value = unit;
+	}
+	glBindTexture(target, texture);
+	return true;
+}
+
+bool GLState::enable(GLenum cap) {
+	Cached< bool > *cached = (cap == GL_DEPTH_TEST ? &depth_test : cap == GL_BLEND ? &blend : nullptr);
+	if (cached) {
+		if (!change(*cached, true)) return false;
+	} else {
+		counters.calls += 1;
+	}
+	glEnable(cap);
+	return true;
+}
+
+bool GLState::disable(GLenum cap) {
+	Cached< bool > *cached = (cap == GL_DEPTH_TEST ? &depth_test : cap == GL_BLEND ? &blend : nullptr);
+	if (cached) {
+		if (!change(*cached, false)) return false;
+	} else {
+		counters.calls += 1;
+	}
+	glDisable(cap);
+	return true;
+}
+
+bool GLState::clear_color(glm::vec4 const &color) {
+	if (!change(clear, color)) return false;
+	glClearColor(color.r, color.g, color.b, color.a);
+	return true;
+}
+
+void GLState::invalidate() {
+	Counters saved = counters, saved_last = last_frame;
+	*this = GLState();
+	counters = saved;
+	last_frame = saved_last;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+ * GLState is a shadow copy of commonly-changed OpenGL state:
+ *  - current program, vertex array, and GL_ARRAY_BUFFER binding
+ *  - active texture unit and per-unit texture bindings
+ *  - GL_DEPTH_TEST and GL_BLEND enables
+ *  - clear color
+ *
+ * Code changes this state through the global 'gl_state' instead of calling OpenGL directly:
+ *
+ * gl_state.use_program(program);
+ * gl_state.disable(GL_DEPTH_TEST);
+ *
+ * Calls that wouldn't change anything are skipped (and counted).
+ *
+ * State starts out unknown, so the first call for each piece of state always reaches OpenGL.
+ * After changing any of the above with direct OpenGL calls -- or after deleting an object
+ * that might be bound (OpenGL unbinds it, and may re-use its name) -- call invalidate().
+ *
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+struct GLState {
+	//each of these returns true if it called OpenGL, false if the call was skipped:
+	bool use_program(GLuint program);
+	bool bind_vertex_array(GLuint vao);
+	bool bind_array_buffer(GLuint buffer);
+	bool active_texture(uint32_t unit); //unit is 0-based (not GL_TEXTURE0-based)
+	bool bind_texture(uint32_t unit, GLenum target, GLuint texture); //makes 'unit' active if it needs to bind
+	bool enable(GLenum cap); //GL_DEPTH_TEST and GL_BLEND are tracked; other caps always call OpenGL
+	bool disable(GLenum cap);
+	bool set_enabled(GLenum cap, bool enabled) { return enabled ? enable(cap) : disable(cap); }
+	bool clear_color(glm::vec4 const &color);
+
+	//forget all cached state:
+	void invalidate();
+
+	//count of calls made through this object and how many of them were skipped:
+	struct Counters {
+		uint32_t calls = 0;
+		uint32_t elided = 0;
+	};
+	Counters counters; //since the last next_frame()
+	Counters last_frame; //...during the previous frame
+
+	//call once per frame (main loops do this after swapping buffers):
+	void next_frame() {
+		last_frame = counters;
+		counters = Counters();
+	}
+
+	//--- internals ---
+
+	//texture units and targets that are tracked (binds to others always call OpenGL):
+	enum : uint32_t { TextureUnits = 16, TextureTargets = 5 };
+	static uint32_t target_index(GLenum target); //index in [0,TextureTargets) or -1U if not tracked
+
+	template< typename T >
+	struct Cached {
+		bool known = false;
+		T value = T();
+	};
+
+	Cached< GLuint > program;
+	Cached< GLuint > vao;
+	Cached< GLuint > array_buffer;
+	Cached< uint32_t > active_unit;
+	Cached< GLuint > textures[TextureUnits][TextureTargets];
+	Cached< bool > depth_test;
+	Cached< bool > blend;
+	Cached< glm::vec4 > clear;
+
+	//returns true if 'cached' needs to change to 'value' (and changes it), updating counters:
+	template< typename T >
+	bool change(Cached< T > &cached, T const &value) {
+		counters.calls += 1;
+		if (cached.known && cached.value == value) {
+			counters.elided += 1;
+			return false;
+		}
+		cached.known = true;
+		cached.value = value;
+		return true;
+	}
+};
+
+extern GLState gl_state;
@@ -0,0 +1,130 @@
+#include "InputLog.hpp"
+
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <cassert>
+
+//"inp0" chunk -- checked on load, since events are stored as raw SDL_Event structures:
+struct LogHeader {
+	uint32_t sdl_version = SDL_VERSION;
+	uint32_t event_size = uint32_t(sizeof(SDL_Event));
+};
+static_assert(sizeof(LogHeader) == 8, "LogHeader is packed.");
+
+InputLog::InputLog(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open input log '" + filename + "'.");
+
+	std::vector< LogHeader > header;
+	read_chunk(file, "inp0", &header);
+	if (header.size() != 1) throw std::runtime_error("Input log '" + filename + "' has a malformed header.");
+	if (header[0].event_size != sizeof(SDL_Event) || header[0].sdl_version != uint32_t(SDL_VERSION)) {
+		throw std::runtime_error("Input log '" + filename + "' was recorded with a different SDL (version " + std::to_string(header[0].sdl_version) + ", event size " + std::to_string(header[0].event_size) + ").");
+	}
+
+	read_chunk(file, "frm0", &frames);
+	read_chunk(file, "evt0", &events);
+	read_chunk(file, "tim0", &timings);
+
+	for (Frame const &frame : frames) {
+		if (!(frame.event_begin <= events.size() && frame.event_count <= events.size() - frame.event_begin)) {
+			throw std::runtime_error("Input log '" + filename + "' has a frame with out-of-range events.");
+		}
+	}
+	if (!timings.empty() && timings.size() != frames.size()) {
+		throw std::runtime_error("Input log '" + filename + "' has " + std::to_string(timings.size()) + " timings for " + std::to_string(frames.size()) + " frames.");
+	}
+}
+
+void InputLog::save(std::string const &filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	write_chunk("inp0", std::vector< LogHeader >(1), &file);
+	write_chunk("frm0", frames, &file);
+	write_chunk("evt0", events, &file);
+	write_chunk("tim0", timings, &file);
+	if (!file) throw std::runtime_error("Failed to write input log '" + filename + "'.");
+}
+
+void InputLog::begin_frame(glm::uvec2 const &window_size) {
+	Frame frame;
+	frame.event_begin = uint32_t(events.size());
+	frame.window_width = window_size.x;
+	frame.window_height = window_size.y;
+	frames.emplace_back(frame);
+}
+
+void InputLog::add_event(SDL_Event const &evt) {
+	assert(!frames.empty() && "add_event() goes between begin_frame() and end_frame()");
+	if (!can_record(evt)) return;
+	events.emplace_back(evt);
+	frames.back().event_count += 1;
+}
+
+void InputLog::end_frame(float elapsed, float update_seconds, float draw_seconds) {
+	assert(!frames.empty() && timings.size() + 1 == frames.size());
+	frames.back().elapsed = elapsed;
+	timings.emplace_back(Timing{update_seconds, draw_seconds});
+}
+
+bool InputLog::can_record(SDL_Event const &evt) {
+	switch (evt.type) {
+		case SDL_EVENT_TEXT_EDITING:
+		case SDL_EVENT_TEXT_INPUT:
+		case SDL_EVENT_TEXT_EDITING_CANDIDATES:
+		case SDL_EVENT_CLIPBOARD_UPDATE:
+		case SDL_EVENT_DROP_FILE:
+		case SDL_EVENT_DROP_TEXT:
+		case SDL_EVENT_DROP_BEGIN:
+		case SDL_EVENT_DROP_COMPLETE:
+		case SDL_EVENT_DROP_POSITION:
+			return false;
+		default:
+			return evt.type < SDL_EVENT_USER;
+	}
+}
+
+InputLog::Stats InputLog::stats(std::vector< float > seconds) {
+	Stats ret;
+	if (seconds.empty()) return ret;
+	std::sort(seconds.begin(), seconds.end());
+	auto at = [&](float fraction) {
+		return seconds[std::min(seconds.size() - 1, size_t(fraction * float(seconds.size() - 1) + 0.5f))];
+	};
+	ret.count = uint32_t(seconds.size());
+	ret.min = seconds.front();
+	ret.median = at(0.5f);
+	ret.p99 = at(0.99f);
+	ret.max = seconds.back();
+	ret.mean = float(std::accumulate(seconds.begin(), seconds.end(), 0.0) / double(seconds.size()));
+	return ret;
+}
+
+void InputLog::report(std::ostream &out, std::string const &label) const {
+	std::vector< float > update, draw;
+	update.reserve(timings.size());
+	draw.reserve(timings.size());
+	for (Timing const &timing : timings) {
+		update.emplace_back(timing.update);
+		draw.emplace_back(timing.draw);
+	}
+
+	out << label << " (" << timings.size() << " frames, ms):\n";
+	auto line = [&](char const *name, Stats const &s) {
+		out << "  " << std::setw(6) << name << std::fixed << std::setprecision(3)
+		    << "  min " << s.min * 1000.0f
+		    << "  median " << s.median * 1000.0f
+		    << "  p99 " << s.p99 * 1000.0f
+		    << "  max " << s.max * 1000.0f
+		    << "  mean " << s.mean * 1000.0f << '\n';
+	};
+	line("update", stats(update));
+	line("draw", stats(draw));
+	out << std::defaultfloat;
+	out.flush();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+/*
+ * InputLog holds a recorded play session -- the input events handled and the 'elapsed' time
+ * passed to update() each frame -- so the session can be replayed frame-for-frame:
+ *
+ * //recording (each frame):
+ * log.begin_frame(window_size);
+ * log.add_event(evt); //...for each event handled
+ * log.end_frame(elapsed, update_seconds, draw_seconds);
+ * //...then:
+ * log.save("session.input");
+ *
+ * //replaying:
+ * InputLog log("session.input");
+ * for (InputLog::Frame const &frame : log.frames) {
+ *     for (uint32_t e = frame.event_begin; e < frame.event_begin + frame.event_count; ++e) handle_event(log.events[e]);
+ *     update(frame.elapsed); ...
+ * }
+ *
+ * Each frame also stores how long update() and draw() took (CPU wall-clock time), so a replay
+ * doubles as a benchmark: save the replay's own timings and compare them against another build's.
+ *
+ * Files are read_write_chunk.hpp chunks: "inp0" (SDL version and event size), "frm0" (frames),
+ * "evt0" (raw SDL_Event structures), and "tim0" (timings, one per frame).
+ * Events are stored as-is, so logs only replay with the SDL build that recorded them;
+ * events that point at other memory (text input, drag-and-drop, clipboard, user events) aren't recorded.
+ *
+ * A replay only matches the recording if the mode's update() depends on nothing but events and elapsed time --
+ * see Mode::deterministic.
+ *
+ */
+
+#include <SDL3/SDL.h>
+#include <glm/glm.hpp>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct InputLog {
+	InputLog() = default;
+	InputLog(std::string const &filename); //load a saved log (throws on failure)
+
+	void save(std::string const &filename) const; //(throws on failure)
+
+	struct Frame {
+		uint32_t event_begin = 0; //events handled at the start of this frame are events[event_begin, event_begin + event_count)
+		uint32_t event_count = 0;
+		float elapsed = 0.0f; //seconds passed to update()
+		uint32_t window_width = 0, window_height = 0; //window size passed to handle_event()
+	};
+	static_assert(sizeof(Frame) == 20, "Frame is packed.");
+	std::vector< Frame > frames;
+
+	std::vector< SDL_Event > events;
+
+	struct Timing {
+		float update = 0.0f; //seconds spent in update() this frame (all steps)
+		float draw = 0.0f; //seconds spent in draw()
+	};
+	static_assert(sizeof(Timing) == 8, "Timing is packed.");
+	std::vector< Timing > timings; //one per frame
+
+	//--- recording ---
+
+	void begin_frame(glm::uvec2 const &window_size);
+	void add_event(SDL_Event const &evt); //(skips events that can't be stored)
+	void end_frame(float elapsed, float update_seconds, float draw_seconds);
+
+	//false for events that hold pointers (and so can't be saved):
+	static bool can_record(SDL_Event const &evt);
+
+	//--- timing reports ---
+
+	struct Stats {
+		uint32_t count = 0;
+		float min = 0.0f, median = 0.0f, p99 = 0.0f, max = 0.0f, mean = 0.0f;
+	};
+	static Stats stats(std::vector< float > seconds);
+
+	//print update and draw statistics (in milliseconds) over 'timings':
+	void report(std::ostream &out, std::string const &label) const;
+};
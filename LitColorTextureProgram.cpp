@@ -1,27 +1,28 @@
 #include "LitColorTextureProgram.hpp"
 
+#include "UniformBlocks.hpp"
+#include "GLState.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
+#include <cassert>
+
 Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
 
+//(loaded first, so the pipeline template below can refer to it)
+Load< LitColorTextureProgram > lit_color_texture_program_instanced(LoadTagEarly, []() -> LitColorTextureProgram const * {
+	return new LitColorTextureProgram(LitColorTextureProgram::Instanced);
+});
+
 Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> LitColorTextureProgram const * {
 	LitColorTextureProgram *ret = new LitColorTextureProgram();
 
 	//----- build the pipeline template -----
 	lit_color_texture_program_pipeline.program = ret->program;
 
-	lit_color_texture_program_pipeline.CLIP_FROM_OBJECT_mat4 = ret->CLIP_FROM_OBJECT_mat4;
-	lit_color_texture_program_pipeline.LIGHT_FROM_OBJECT_mat4x3 = ret->LIGHT_FROM_OBJECT_mat4x3;
-	lit_color_texture_program_pipeline.LIGHT_FROM_NORMAL_mat3 = ret->LIGHT_FROM_NORMAL_mat3;
+	lit_color_texture_program_pipeline.instanced_program = lit_color_texture_program_instanced->program;
 
-	/* This will be used later if/when we build a light loop into the Scene:
-	lit_color_texture_program_pipeline.LIGHT_TYPE_int = ret->LIGHT_TYPE_int;
-	lit_color_texture_program_pipeline.LIGHT_LOCATION_vec3 = ret->LIGHT_LOCATION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_DIRECTION_vec3 = ret->LIGHT_DIRECTION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_ENERGY_vec3 = ret->LIGHT_ENERGY_vec3;
-	lit_color_texture_program_pipeline.LIGHT_CUTOFF_float = ret->LIGHT_CUTOFF_float;
-	*/
+	//(uniforms -- including the light -- come from the Frame and Object uniform blocks Scene::draw() provides)
 
 	//make a 1-pixel white texture to bind by default:
 	GLuint tex;
@@ -35,6 +36,7 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glBindTexture(GL_TEXTURE_2D, 0);
+	gl_state.invalidate(); //(texture was bound directly)
 
 
 	lit_color_texture_program_pipeline.textures[0].texture = tex;
@@ -43,38 +45,63 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	return ret;
 });
 
-LitColorTextureProgram::LitColorTextureProgram() {
-	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
-	program = gl_compile_program(
-		//vertex shader:
-		"#version 330\n"
-		"uniform mat4 CLIP_FROM_OBJECT;\n"
-		"uniform mat4x3 LIGHT_FROM_OBJECT;\n"
-		"uniform mat3 LIGHT_FROM_NORMAL;\n"
-		"in vec4 Position;\n"
-		"in vec3 Normal;\n"
-		"in vec4 Color;\n"
-		"in vec2 TexCoord;\n"
+LitColorTextureProgram::LitColorTextureProgram(Variant variant) {
+	//Vertex attributes are at fixed locations so that both variants can share vertex array objects:
+	char const *attributes =
+		"layout(location = 0) in vec4 Position;\n"
+		"layout(location = 1) in vec3 Normal;\n"
+		"layout(location = 2) in vec4 Color;\n"
+		"layout(location = 3) in vec2 TexCoord;\n"
 		"out vec3 position;\n"
 		"out vec3 normal;\n"
 		"out vec4 color;\n"
 		"out vec2 texCoord;\n"
-		"void main() {\n"
-		"	gl_Position = CLIP_FROM_OBJECT * Position;\n"
-		"	position = LIGHT_FROM_OBJECT * Position;\n"
-		"	normal = LIGHT_FROM_NORMAL * Normal;\n"
-		"	color = Color;\n"
-		"	texCoord = TexCoord;\n"
-		"}\n"
+	;
+
+	std::string vertex_shader;
+	if (variant == Single) {
+		vertex_shader = std::string("#version 330\n")
+			+ UniformBlocks::ObjectGLSL
+			+ attributes + std::string(
+			"void main() {\n"
+			"	gl_Position = CLIP_FROM_OBJECT * Position;\n"
+			"	position = LIGHT_FROM_OBJECT * Position;\n"
+			"	normal = LIGHT_FROM_NORMAL * Normal;\n"
+			"	color = Color;\n"
+			"	texCoord = TexCoord;\n"
+			"}\n"
+		);
+	} else {
+		assert(variant == Instanced);
+		//per-instance matrices are rows in the instance buffer (see Scene::InstanceTextureUnit):
+		vertex_shader = std::string("#version 330\n")
+			+ UniformBlocks::FrameGLSL
+			+ UniformBlocks::ObjectGLSL
+			+ "uniform samplerBuffer INSTANCES;\n"
+			+ attributes + std::string(
+			"void main() {\n"
+			"	int i = (INSTANCE_BASE + gl_InstanceID) * 6;\n"
+			"	mat4x3 WORLD_FROM_OBJECT = transpose(mat3x4(texelFetch(INSTANCES, i+0), texelFetch(INSTANCES, i+1), texelFetch(INSTANCES, i+2)));\n"
+			"	mat3 WORLD_FROM_NORMAL = transpose(mat3(texelFetch(INSTANCES, i+3).xyz, texelFetch(INSTANCES, i+4).xyz, texelFetch(INSTANCES, i+5).xyz));\n"
+			"	vec4 world_position = vec4(WORLD_FROM_OBJECT * Position, 1.0);\n"
+			"	gl_Position = CLIP_FROM_WORLD * world_position;\n"
+			"	position = LIGHT_FROM_WORLD * world_position;\n"
+			"	normal = LIGHT_FROM_WORLD_NORMAL * (WORLD_FROM_NORMAL * Normal);\n"
+			"	color = Color;\n"
+			"	texCoord = TexCoord;\n"
+			"}\n"
+		);
+	}
+
+	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
+	program = gl_compile_program(
+		//vertex shader:
+		vertex_shader
 	,
 		//fragment shader:
-		"#version 330\n"
+		std::string("#version 330\n")
+		+ UniformBlocks::FrameGLSL +
 		"uniform sampler2D TEX;\n"
-		"uniform int LIGHT_TYPE;\n"
-		"uniform vec3 LIGHT_LOCATION;\n"
-		"uniform vec3 LIGHT_DIRECTION;\n"
-		"uniform vec3 LIGHT_ENERGY;\n"
-		"uniform float LIGHT_CUTOFF;\n"
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
@@ -131,26 +158,23 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	Color_vec4 = glGetAttribLocation(program, "Color");
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
 
-	//look up the locations of uniforms:
-	CLIP_FROM_OBJECT_mat4 = glGetUniformLocation(program, "CLIP_FROM_OBJECT");
-	LIGHT_FROM_OBJECT_mat4x3 = glGetUniformLocation(program, "LIGHT_FROM_OBJECT");
-	LIGHT_FROM_NORMAL_mat3 = glGetUniformLocation(program, "LIGHT_FROM_NORMAL");
-
-	LIGHT_TYPE_int = glGetUniformLocation(program, "LIGHT_TYPE");
-	LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
-	LIGHT_DIRECTION_vec3 = glGetUniformLocation(program, "LIGHT_DIRECTION");
-	LIGHT_ENERGY_vec3 = glGetUniformLocation(program, "LIGHT_ENERGY");
-	LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
-
+	//attach uniform blocks to their binding points:
+	UniformBlocks::bind_blocks(program);
 
+	//look up the locations of uniforms:
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
+	GLuint INSTANCES_samplerBuffer = glGetUniformLocation(program, "INSTANCES");
 
 	//set TEX to always refer to texture binding zero:
 	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
 
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
+	if (INSTANCES_samplerBuffer != -1U) {
+		glUniform1i(INSTANCES_samplerBuffer, Scene::InstanceTextureUnit);
+	}
 
 	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+	gl_state.invalidate(); //(program was bound directly)
 }
 
 LitColorTextureProgram::~LitColorTextureProgram() {
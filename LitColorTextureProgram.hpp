@@ -5,8 +5,11 @@
 #include "Scene.hpp"
 
 //Shader program that draws transformed, lit, textured vertices tinted with vertex colors:
+// the 'Instanced' variant reads per-instance matrices from Scene's instance buffer instead of the Object block's *_FROM_OBJECT matrices
+// (both variants use the same attribute locations, so a vertex array object made for one works with the other)
 struct LitColorTextureProgram {
-	LitColorTextureProgram();
+	enum Variant { Single, Instanced };
+	LitColorTextureProgram(Variant variant = Single);
 	~LitColorTextureProgram();
 
 	GLuint program = 0;
@@ -17,24 +20,20 @@ struct LitColorTextureProgram {
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
 
-	//Uniform (per-invocation variable) locations:
-	GLuint CLIP_FROM_OBJECT_mat4 = -1U;
-	GLuint LIGHT_FROM_OBJECT_mat4x3 = -1U;
-	GLuint LIGHT_FROM_NORMAL_mat3 = -1U;
-
-	//lighting:
-	GLuint LIGHT_TYPE_int = -1U;
-	GLuint LIGHT_LOCATION_vec3 = -1U;
-	GLuint LIGHT_DIRECTION_vec3 = -1U;
-	GLuint LIGHT_ENERGY_vec3 = -1U;
-	GLuint LIGHT_CUTOFF_float = -1U;
-	
+	//Uniforms:
+	//Object block - CLIP_FROM_OBJECT, LIGHT_FROM_OBJECT, LIGHT_FROM_NORMAL (Instanced: INSTANCE_BASE)
+	//Frame block - LIGHT_* (Instanced: CLIP_FROM_WORLD, LIGHT_FROM_WORLD, LIGHT_FROM_WORLD_NORMAL)
+	// (see UniformBlocks.hpp; Scene::draw() provides both)
+
 	//Textures:
 	//TEXTURE0 - texture that is accessed by TexCoord
+	//(Instanced variant) TEXTURE0 + Scene::InstanceTextureUnit - instance buffer
 };
 
 extern Load< LitColorTextureProgram > lit_color_texture_program;
+extern Load< LitColorTextureProgram > lit_color_texture_program_instanced;
 
 //For convenient scene-graph setup, copy this object:
 // NOTE: by default, has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
+// NOTE: has instanced_program set to lit_color_texture_program_instanced, so Scene::draw() can instance repeated meshes.
 extern Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
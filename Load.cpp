@@ -1,20 +1,46 @@
 #include "Load.hpp"
+#include "Profiler.hpp"
+#include "WorkerPool.hpp"
 
-#include <array>
-#include <list>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
 #include <cassert>
 
 namespace {
-	std::array< std::list< std::function< void() > >, MaxLoadTag > &get_load_lists() {
-		static std::array< std::list< std::function< void() > >, MaxLoadTag > load_lists;
-		return load_lists;
+	struct Step {
+		LoadTag tag; //MaxLoadTag for stepped loads (which aren't ordered by tag)
+		std::vector< LoadBase const * > after, gl_after;
+		std::function< void() > cpu, gl;
+	};
+	std::vector< Step > &get_load_steps() {
+		static std::vector< Step > load_steps;
+		return load_steps;
+	}
+
+	uint32_t add_step(LoadBase *load, Step &&step) {
+		auto &load_steps = get_load_steps();
+		uint32_t index = uint32_t(load_steps.size());
+		load_steps.emplace_back(std::move(step));
+		if (load) {
+			assert(load->step == -1U && "Each load should only add one step.");
+			load->step = index;
+		}
+		return index;
 	}
 }
 
-void add_load_function(LoadTag tag, std::function< void() > const &fn) {
-	auto &load_lists = get_load_lists();
-	assert(tag < load_lists.size());
-	load_lists[tag].emplace_back(fn);
+void add_load_function(LoadTag tag, std::function< void() > const &fn, LoadBase *load, std::vector< LoadBase const * > const &after) {
+	assert(tag < MaxLoadTag);
+	add_step(load, Step{tag, after, {}, {}, fn});
+}
+
+void add_load_steps(LoadBase *load,
+	std::vector< LoadBase const * > const &after, std::function< void() > const &cpu,
+	std::vector< LoadBase const * > const &gl_after, std::function< void() > const &gl) {
+	add_step(load, Step{MaxLoadTag, after, gl_after, cpu, gl});
 }
 
 void call_load_functions() {
@@ -22,11 +48,131 @@ void call_load_functions() {
 	assert(!has_been_called && "call_load_functions should only be called *once*");
 	has_been_called = true;
 
-	auto &load_lists = get_load_lists();
-	for (auto &fn_list : load_lists) {
-		while (!fn_list.empty()) {
-			(*fn_list.begin())(); //call first function in the list
-			fn_list.pop_front(); //remove from list
+	PROFILE_SCOPE("call_load_functions");
+	auto &load_steps = get_load_steps();
+	uint32_t count = uint32_t(load_steps.size());
+
+	//dependencies, as step indices:
+	// (resolved here, since loads in other files may not have been constructed when a load named them)
+	std::vector< std::vector< uint32_t > > cpu_waits(count), gl_waits(count);
+	auto resolve = [&](std::vector< LoadBase const * > const &loads, std::vector< uint32_t > *into) {
+		for (LoadBase const *load : loads) {
+			if (!load || load->step >= count) {
+				throw std::runtime_error("Load depends on something that was never added to the load list.");
+			}
+			into->emplace_back(load->step);
+		}
+	};
+	for (uint32_t i = 0; i < count; ++i) {
+		resolve(load_steps[i].after, &cpu_waits[i]);
+		resolve(load_steps[i].after, &gl_waits[i]);
+		resolve(load_steps[i].gl_after, &gl_waits[i]);
+	}
+
+	{ //tagged functions run one after another, in tag order (and, within a tag, in the order they were added):
+		std::vector< uint32_t > tagged;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (load_steps[i].tag < MaxLoadTag) tagged.emplace_back(i);
+		}
+		std::stable_sort(tagged.begin(), tagged.end(), [&](uint32_t a, uint32_t b) {
+			return load_steps[a].tag < load_steps[b].tag;
+		});
+		for (uint32_t t = 1; t < tagged.size(); ++t) {
+			gl_waits[tagged[t]].emplace_back(tagged[t-1]);
+		}
+	}
+
+	enum State : uint8_t { Waiting, Reading, Read, Done };
+	std::vector< State > states(count, Waiting);
+	uint32_t done = 0;
+
+	auto finished = [&](std::vector< uint32_t > const &waits) {
+		for (uint32_t w : waits) {
+			if (states[w] != Done) return false;
+		}
+		return true;
+	};
+
+	//'cpu' steps report back here:
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector< uint32_t > read; //(guarded by mutex) steps whose 'cpu' function has returned
+	std::exception_ptr error; //(guarded by mutex) first exception thrown by a 'cpu' function
+	uint32_t reading = 0; //'cpu' steps in flight (only touched by this thread)
+
+	//wait for at least one 'cpu' step to report back, and mark the ones that have as Read:
+	auto collect = [&]() {
+		std::unique_lock< std::mutex > lock(mutex);
+		wake.wait(lock, [&](){ return !read.empty(); });
+		for (uint32_t i : read) {
+			assert(states[i] == Reading);
+			states[i] = Read;
+			reading -= 1;
+		}
+		read.clear();
+		return error;
+	};
+
+	//if anything fails, let the steps still in flight finish before throwing (they refer to locals above):
+	auto fail = [&](std::exception_ptr failure) {
+		while (reading > 0) collect();
+		std::rethrow_exception(failure);
+	};
+
+	while (done < count) {
+		//start every 'cpu' step whose dependencies have finished:
+		for (uint32_t i = 0; i < count; ++i) {
+			if (states[i] != Waiting || !finished(cpu_waits[i])) continue;
+			if (!load_steps[i].cpu) {
+				states[i] = Read;
+				continue;
+			}
+			states[i] = Reading;
+			reading += 1;
+			//(with no worker threads, this runs before run() returns -- so 'mutex' must not be held here)
+			WorkerPool::get().run([&,i](){
+				std::exception_ptr failure;
+				try {
+					PROFILE_SCOPE("load (cpu)");
+					load_steps[i].cpu();
+				} catch (...) {
+					failure = std::current_exception();
+				}
+				std::unique_lock< std::mutex > lock(mutex);
+				if (failure && !error) error = failure;
+				read.emplace_back(i);
+				wake.notify_one();
+			});
 		}
+
+		//run the first 'gl' step that is ready:
+		// (just one, so that the 'cpu' steps it unblocks start before the next 'gl' step)
+		uint32_t ready = count;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (states[i] == Read && finished(gl_waits[i])) {
+				ready = i;
+				break;
+			}
+		}
+		if (ready < count) {
+			try {
+				PROFILE_SCOPE("load function");
+				if (load_steps[ready].gl) load_steps[ready].gl();
+			} catch (...) {
+				fail(std::current_exception());
+			}
+			states[ready] = Done;
+			done += 1;
+			continue;
+		}
+
+		//nothing to do on this thread until a 'cpu' step finishes:
+		if (reading == 0) {
+			throw std::runtime_error("Load dependencies form a cycle (" + std::to_string(count - done) + " loads can never start).");
+		}
+		PROFILE_SCOPE("wait for loads");
+		if (std::exception_ptr failure = collect()) fail(failure);
 	}
+
+	load_steps.clear();
 }
@@ -20,10 +20,26 @@
  * These functions are grouped by 'tags', which allow some sequencing of calls.
  * (particularly, this is useful for loading large data blobs [e.g. Meshes] before looking up individual elements within them.)
  *
+ * Loads that do real work off the OpenGL thread can instead be split into steps with explicit dependencies:
+ *
+ * Load< MeshBuffer > level_meshes(LoadSteps< MeshBuffer >{
+ *     .cpu = []() { return MeshBuffer::read(data_path("level.pnct")); }, //on a WorkerPool thread
+ *     .gl_after = { &lit_color_texture_program },
+ *     .gl = [](MeshBuffer &meshes) { meshes.upload(); }, //on the main thread
+ * });
+ *
+ * A 'cpu' step runs on a WorkerPool thread as soon as every load in its 'after' list has finished,
+ * so reading and parsing files overlaps; it must not make OpenGL calls. The 'gl' step then runs on the
+ * main thread once everything in 'after' and 'gl_after' has finished.
+ *
+ * Tagged loads still run on the main thread one after another, in tag order; steps are only ordered by their lists.
+ * (so a tagged load that uses a stepped load should be tagged later *and* list it -- see Load's 'after' parameter.)
+ *
  */
 
 #include <functional>
 #include <stdexcept>
+#include <vector>
 #include <cstdint>
 
 enum LoadTag : uint32_t {
@@ -33,29 +49,70 @@ enum LoadTag : uint32_t {
 	MaxLoadTag //<-- just used to track # of load tags
 };
 
+//Every Load< T > is a LoadBase, so loads can name each other as dependencies:
+struct LoadBase {
+	LoadBase() = default;
+	LoadBase(LoadBase const &) = delete;
+	LoadBase &operator=(LoadBase const &) = delete;
+
+	uint32_t step = -1U; //index in the internal list of loading steps
+};
+
 //Add a function to an internal list of loading functions:
 // (only call *before* "call_load_functions()")
-void add_load_function(LoadTag tag, std::function< void() > const &fn);
+// 'load' (if given) is the LoadBase that other loads use to wait for this function; 'after' are loads to wait for.
+void add_load_function(LoadTag tag, std::function< void() > const &fn,
+	LoadBase *load = nullptr, std::vector< LoadBase const * > const &after = {});
 
-//Call all loading functions:
-// (loading functions may throw exceptions if they fail.)
+//Add a loading function in two steps (see LoadSteps below):
+// (either function may be empty)
+void add_load_steps(LoadBase *load,
+	std::vector< LoadBase const * > const &after, std::function< void() > const &cpu,
+	std::vector< LoadBase const * > const &gl_after, std::function< void() > const &gl);
+
+//Call all loading functions (running 'cpu' steps on WorkerPool::get()):
+// (loading functions may throw exceptions if they fail -- the first exception is re-thrown here.)
 // (only call *once*)
 void call_load_functions();
 
+template< typename T >
+struct LoadSteps {
+	std::vector< LoadBase const * > after = {}; //loads that must finish before 'cpu' starts
+	std::function< T *() > cpu = {}; //read and parse (on a WorkerPool thread -- no OpenGL calls!)
+	std::vector< LoadBase const * > gl_after = {}; //loads that (also) must finish before 'gl' starts
+	std::function< void(T &) > gl = {}; //(optional) create buffers, textures, and VAOs (on the main thread)
+};
+
 
 //work-around for MSVC not accepting this as a lambda:
 template< typename T >
 T const *new_T() { return new T; }
 
 template< typename T >
-struct Load {
+struct Load : LoadBase {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
-	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
+	// ('after' lists stepped loads that load_fn uses)
+	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >, std::vector< LoadBase const * > const &after = {}) : value(nullptr) {
 		add_load_function(tag, [this,load_fn](){
 			this->value = load_fn();
 			if (!(this->value)) {
 				throw std::runtime_error("Loading failed.");
 			}
+		}, this, after);
+	}
+
+	//...or adds the passed steps:
+	Load(LoadSteps< T > const &steps) : value(nullptr) {
+		if (!steps.cpu) throw std::runtime_error("LoadSteps needs a 'cpu' function.");
+		//(the result waits in 'loaded' between steps; 'value' is only set once the load has finished)
+		add_load_steps(this, steps.after, [this,cpu=steps.cpu](){
+			this->loaded = cpu();
+			if (!(this->loaded)) {
+				throw std::runtime_error("Loading failed.");
+			}
+		}, steps.gl_after, [this,gl=steps.gl](){
+			if (gl) gl(*this->loaded);
+			this->value = this->loaded;
 		});
 	}
 
@@ -66,16 +123,17 @@ struct Load {
 	T const *operator->() { return value; }
 
 	T const *value;
+	T *loaded = nullptr;
 };
 
 
 //Specialization:
 //Load< void > just calls a function:
 template< >
-struct Load< void > {
+struct Load< void > : LoadBase {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
-	Load( LoadTag tag, const std::function< void() > &load_fn) {
-		add_load_function(tag, load_fn);
+	Load( LoadTag tag, const std::function< void() > &load_fn, std::vector< LoadBase const * > const &after = {}) {
+		add_load_function(tag, load_fn, this, after);
 	}
 };
 
@@ -152,6 +152,7 @@ if (maek.OS === 'windows') {
 const game_names = [
 	maek.CPP('PlayMode.cpp'),
 	maek.CPP('main.cpp'),
+	maek.CPP('InputLog.cpp'),
 	maek.CPP('LitColorTextureProgram.cpp'),
 	//maek.CPP('ColorTextureProgram.cpp'),  //not used right now, but you might want it
 	maek.CPP('Sound.cpp'),
@@ -165,8 +166,22 @@ const common_names = [
 	maek.CPP('PathFont-font.cpp'),
 	maek.CPP('DrawLines.cpp'),
 	maek.CPP('ColorProgram.cpp'),
+	maek.CPP('UniformBlocks.cpp'),
+	maek.CPP('GLState.cpp'),
 	maek.CPP('Scene.cpp'),
+	maek.CPP('TransformKernels.cpp'),
+	maek.CPP('WorkerPool.cpp'),
+	maek.CPP('Profiler.cpp'),
+	maek.CPP('TraceWriter.cpp'),
+	maek.CPP('Frustum.cpp'),
+	maek.CPP('BVH.cpp'),
 	maek.CPP('Mesh.cpp'),
+	maek.CPP('StaticBatches.cpp'),
+	maek.CPP('OcclusionQueries.cpp'),
+	maek.CPP('RayCaster.cpp'),
+	maek.CPP('SpatialGrid.cpp'),
+	maek.CPP('Agents.cpp'),
+	maek.CPP('NavMesh.cpp'),
 	maek.CPP('load_save_png.cpp'),
 	maek.CPP('gl_compile_program.cpp'),
 	maek.CPP('Mode.cpp'),
@@ -186,6 +201,10 @@ const show_scene_names = [
 	maek.CPP('ShowSceneMode.cpp')
 ];
 
+const scene_bench_names = [
+	maek.CPP('scene-bench.cpp')
+];
+
 const freetype_test_names = [
 	maek.CPP('freetype-test.cpp')
 ];
@@ -197,11 +216,12 @@ const freetype_test_names = [
 const game_exe = maek.LINK([...game_names, ...common_names], 'dist/game');
 const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
+const scene_bench_exe = maek.LINK([...scene_bench_names, ...common_names], 'scenes/scene-bench');
 
 const freetype_test_exe = maek.LINK([...freetype_test_names], 'freetype-test');
 
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, freetype_test_exe, ...copies];
+maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, scene_bench_exe, freetype_test_exe, ...copies];
 
 //Note that tasks that produce ':abstract targets' are never cached.
 // This is similar to how .PHONY targets behave in make.
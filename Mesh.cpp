@@ -1,5 +1,7 @@
 #include "Mesh.hpp"
 #include "read_write_chunk.hpp"
+#include "Profiler.hpp"
+#include "GLState.hpp"
 
 #include <glm/glm.hpp>
 
@@ -12,31 +14,33 @@
 #include <cstddef>
 
 MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
+	read_file(filename);
+	upload();
+}
+
+MeshBuffer *MeshBuffer::read(std::string const &filename) {
+	MeshBuffer *ret = new MeshBuffer();
+	try {
+		ret->read_file(filename);
+	} catch (...) {
+		delete ret;
+		throw;
+	}
+	return ret;
+}
+
+void MeshBuffer::read_file(std::string const &filename) {
+	PROFILE_SCOPE("MeshBuffer::read");
 
 	std::ifstream file(filename, std::ios::binary);
 
 	GLuint total = 0;
 
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-		glm::vec2 TexCoord;
-	};
-	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-	std::vector< Vertex > data;
-
-	//read + upload data chunk:
+	//read data chunk:
 	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
-		read_chunk(file, "pnct", &data);
+		read_chunk(file, "pnct", &vertices);
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		total = GLuint(data.size()); //store total for later checks on index
+		total = GLuint(vertices.size()); //store total for later checks on index
 
 		//store attrib locations:
 		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
@@ -73,8 +77,8 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 			mesh.start = entry.vertex_begin;
 			mesh.count = entry.vertex_end - entry.vertex_begin;
 			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
-				mesh.min = glm::min(mesh.min, data[v].Position);
-				mesh.max = glm::max(mesh.max, data[v].Position);
+				mesh.min = glm::min(mesh.min, vertices[v].Position);
+				mesh.max = glm::max(mesh.max, vertices[v].Position);
 			}
 			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
 			if (!inserted) {
@@ -98,6 +102,30 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	*/
 }
 
+MeshBuffer::MeshBuffer(std::vector< Vertex > &&vertices_, std::map< std::string, Mesh > &&meshes_) : vertices(std::move(vertices_)), meshes(std::move(meshes_)) {
+	for (auto const &[name, mesh] : meshes) {
+		if (!(mesh.start <= vertices.size() && mesh.count <= vertices.size() - mesh.start)) {
+			throw std::runtime_error("mesh '" + name + "' has out-of-range vertex start/count");
+		}
+	}
+
+	Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
+	Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
+	Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
+	TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+
+	upload();
+}
+
+void MeshBuffer::upload() {
+	PROFILE_SCOPE("MeshBuffer::upload");
+	if (buffer == 0) glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	gl_state.invalidate(); //(buffer was bound directly)
+}
+
 const Mesh &MeshBuffer::lookup(std::string const &name) const {
 	auto f = meshes.find(name);
 	if (f == meshes.end()) {
@@ -129,6 +157,7 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	bind_attribute("TexCoord", TexCoord);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
+	gl_state.invalidate(); //(vao and buffer were bound directly)
 
 	//Check that all active attributes were bound:
 	GLint active = 0;
@@ -14,6 +14,7 @@
 #include <map>
 #include <limits>
 #include <string>
+#include <vector>
 
 
 struct Mesh {
@@ -30,10 +31,28 @@ struct Mesh {
 };
 
 struct MeshBuffer {
+	//Vertex format of buffers loaded from '.pnct' files:
+	struct Vertex {
+		glm::vec3 Position;
+		glm::vec3 Normal;
+		glm::u8vec4 Color;
+		glm::vec2 TexCoord;
+	};
+	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+
 	//construct from a file:
 	// note: will throw if file fails to read.
 	MeshBuffer(std::string const &filename);
 
+	//...or in two steps, so the file can be read off the OpenGL thread (e.g., in a LoadSteps 'cpu' step):
+	// read() parses the file without any OpenGL calls, then upload() (on the OpenGL thread) creates 'buffer':
+	static MeshBuffer *read(std::string const &filename);
+	void upload();
+
+	//construct from vertices made some other way (e.g., by StaticBatches):
+	// note: will throw if a mesh refers to vertices outside 'vertices'.
+	MeshBuffer(std::vector< Vertex > &&vertices, std::map< std::string, Mesh > &&meshes);
+
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
 	const Mesh &lookup(std::string const &name) const;
@@ -45,8 +64,14 @@ struct MeshBuffer {
 	//This is the OpenGL vertex buffer object containing the mesh data:
 	GLuint buffer = 0;
 
+	//...and a copy of its contents, for code that processes meshes on the CPU:
+	std::vector< Vertex > vertices;
+
 	//-- internals ---
 
+	MeshBuffer() = default; //(used by read())
+	void read_file(std::string const &filename);
+
 	//used by the lookup() function:
 	std::map< std::string, Mesh > meshes;
 
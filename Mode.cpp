@@ -2,6 +2,8 @@
 
 std::shared_ptr< Mode > Mode::current;
 
+bool Mode::deterministic = false;
+
 SDL_Window *Mode::window = NULL;
 
 void Mode::set_current(std::shared_ptr< Mode > const &new_current) {
@@ -20,11 +20,25 @@ struct Mode : std::enable_shared_from_this< Mode > {
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//(optional) fixed-timestep updates:
+	// when fixed_timestep > 0, the main loop accumulates real time and calls update(fixed_timestep) once per whole step
+	// (so zero or more times per frame, at most max_steps_per_frame -- any further backlog is dropped);
+	// 'interpolation' is then set, before draw, to how far real time has gotten past the last update, in steps ([0,1]),
+	// so draw can blend between the last two updates (see Scene::interpolate_transforms)
+	float fixed_timestep = 0.0f;
+	uint32_t max_steps_per_frame = 8;
+	float interpolation = 1.0f; //(always 1 without fixed_timestep)
+
 	//Mode::current is the Mode to which events are dispatched.
 	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
 	static std::shared_ptr< Mode > current;
 	static void set_current(std::shared_ptr< Mode > const &);
 
+	//Mode::deterministic is set while a session is being recorded or replayed (see InputLog):
+	// modes should then make update() depend only on events and elapsed time -- e.g., wait for background work
+	// that would otherwise be polled, so its results arrive on the same frame in the replay as in the recording
+	static bool deterministic;
+
 	//Mode::window is the (global) SDL window:
 	static SDL_Window *window;
 };
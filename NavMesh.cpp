@@ -0,0 +1,562 @@
+#include "NavMesh.hpp"
+
+#include "WorkerPool.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <string>
+
+//world-space triangles of the drawables a NavMesh is built from:
+static std::vector< glm::vec3 > scene_triangles(Scene const &scene, MeshBuffer const &meshes, GLuint vao,
+	std::function< bool(Scene::Drawable const &) > const &include) {
+	std::vector< glm::vec3 > triangles;
+	for (Scene::Drawable const &drawable : scene.drawables) {
+		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+		if (pipeline.vao != vao || pipeline.type != GL_TRIANGLES) continue;
+		if (include && !include(drawable)) continue;
+		if (size_t(pipeline.start) + pipeline.count > meshes.vertices.size()) {
+			throw std::runtime_error("Drawable's vertex range is outside the mesh buffer.");
+		}
+		glm::mat4x3 world_from_local = drawable.transform->make_world_from_local();
+		for (GLuint v = 0; v < pipeline.count - pipeline.count % 3; ++v) {
+			triangles.emplace_back(world_from_local * glm::vec4(meshes.vertices[pipeline.start + v].Position, 1.0f));
+		}
+	}
+	return triangles;
+}
+
+NavMesh::NavMesh(Scene const &scene, MeshBuffer const &meshes, GLuint vao,
+	std::function< bool(Scene::Drawable const &) > const &include, Params const &params_)
+	: NavMesh(scene_triangles(scene, meshes, vao, include), params_) {
+}
+
+NavMesh::NavMesh(std::vector< glm::vec3 > const &triangles, Params const &params_) : params(params_) {
+	if (!(params.cell_size > 0.0f)) {
+		throw std::runtime_error("NavMesh cell size must be positive (got " + std::to_string(params.cell_size) + ").");
+	}
+	if (triangles.size() % 3 != 0) {
+		throw std::runtime_error("NavMesh triangle list has " + std::to_string(triangles.size()) + " points (not a multiple of three).");
+	}
+	build(triangles);
+}
+
+//separating axis test of triangle abc against the box center +/- half:
+static bool triangle_overlaps_box(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 const &center, glm::vec3 const &half) {
+	a -= center; b -= center; c -= center;
+
+	//box faces:
+	for (uint32_t k = 0; k < 3; ++k) {
+		if (std::min({a[k], b[k], c[k]}) > half[k] || std::max({a[k], b[k], c[k]}) < -half[k]) return false;
+	}
+
+	auto separated = [&](glm::vec3 const &axis) {
+		float pa = glm::dot(a, axis), pb = glm::dot(b, axis), pc = glm::dot(c, axis);
+		float r = glm::dot(half, glm::abs(axis));
+		return std::min({pa, pb, pc}) > r || std::max({pa, pb, pc}) < -r;
+	};
+
+	//triangle plane:
+	if (separated(glm::cross(b - a, c - a))) return false;
+
+	//edges crossed with box axes:
+	glm::vec3 const edges[3] = { b - a, c - b, a - c };
+	for (glm::vec3 const &e : edges) {
+		if (separated(glm::vec3(0.0f, -e.z, e.y))) return false;
+		if (separated(glm::vec3(e.z, 0.0f, -e.x))) return false;
+		if (separated(glm::vec3(-e.y, e.x, 0.0f))) return false;
+	}
+	return true;
+}
+
+void NavMesh::build(std::vector< glm::vec3 > const &triangles) {
+	PROFILE_SCOPE("NavMesh::build");
+	float const cs = params.cell_size;
+	float const cos_max_slope = std::cos(glm::radians(params.max_slope_degrees));
+	size_t const count = triangles.size() / 3;
+
+	//which triangles are floors:
+	std::vector< uint8_t > floor(count, 0);
+	glm::vec2 min = glm::vec2( std::numeric_limits< float >::infinity());
+	glm::vec2 max = glm::vec2(-std::numeric_limits< float >::infinity());
+	for (size_t t = 0; t < count; ++t) {
+		glm::vec3 const &a = triangles[3*t+0], &b = triangles[3*t+1], &c = triangles[3*t+2];
+		glm::vec3 n = glm::cross(b - a, c - a);
+		float length = glm::length(n);
+		if (!(length > 0.0f) || n.z < cos_max_slope * length) continue;
+		floor[t] = 1;
+		min = glm::min(min, glm::min(glm::vec2(a), glm::min(glm::vec2(b), glm::vec2(c))));
+		max = glm::max(max, glm::max(glm::vec2(a), glm::max(glm::vec2(b), glm::vec2(c))));
+	}
+	if (!(min.x <= max.x)) return; //no floors, so nowhere to walk
+
+	//grid over the floors (with a border of empty cells):
+	origin = min - glm::vec2(cs);
+	glm::vec2 extent = glm::ceil((max - min) / cs) + glm::vec2(2.0f);
+	if (!(extent.x * extent.y <= float(1 << 24))) {
+		throw std::runtime_error("NavMesh grid would have " + std::to_string(extent.x) + "x" + std::to_string(extent.y)
+			+ " cells; use a larger cell size.");
+	}
+	size = glm::ivec2(extent);
+	uint32_t const cells = uint32_t(size.x) * uint32_t(size.y);
+
+	//range of cells whose centers might be inside points' xy bounds:
+	auto cell_range = [&](glm::vec2 lo, glm::vec2 hi, glm::ivec2 *first, glm::ivec2 *last) {
+		*first = glm::max(glm::ivec2(0), glm::ivec2(glm::floor((lo - origin) / cs)));
+		*last = glm::min(size - glm::ivec2(1), glm::ivec2(glm::floor((hi - origin) / cs)));
+	};
+	auto center_of = [&](int32_t x, int32_t y) {
+		return origin + (glm::vec2(float(x), float(y)) + glm::vec2(0.5f)) * cs;
+	};
+
+	//floor height -- highest floor triangle over each cell's center:
+	cell_height.assign(cells, -std::numeric_limits< float >::infinity());
+	for (size_t t = 0; t < count; ++t) {
+		if (!floor[t]) continue;
+		glm::vec3 const &a = triangles[3*t+0], &b = triangles[3*t+1], &c = triangles[3*t+2];
+		glm::ivec2 first, last;
+		cell_range(glm::min(glm::vec2(a), glm::min(glm::vec2(b), glm::vec2(c))), glm::max(glm::vec2(a), glm::max(glm::vec2(b), glm::vec2(c))), &first, &last);
+		//barycentric coordinates (in xy) of cell centers:
+		float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+		if (area == 0.0f) continue;
+		for (int32_t y = first.y; y <= last.y; ++y) {
+			for (int32_t x = first.x; x <= last.x; ++x) {
+				glm::vec2 p = center_of(x, y);
+				float wb = ((p.x - a.x) * (c.y - a.y) - (c.x - a.x) * (p.y - a.y)) / area;
+				float wc = ((b.x - a.x) * (p.y - a.y) - (p.x - a.x) * (b.y - a.y)) / area;
+				float wa = 1.0f - wb - wc;
+				if (wa < -1e-4f || wb < -1e-4f || wc < -1e-4f) continue;
+				float &h = cell_height[cell_index(glm::ivec2(x, y))];
+				h = std::max(h, wa * a.z + wb * b.z + wc * c.z);
+			}
+		}
+	}
+
+	//blocked cells -- any triangle between climbable height and head height:
+	std::vector< uint8_t > open(cells);
+	for (uint32_t i = 0; i < cells; ++i) {
+		open[i] = (cell_height[i] > -std::numeric_limits< float >::infinity());
+	}
+	float const low = params.max_climb, high = std::max(params.max_climb, params.agent_height);
+	glm::vec3 const half = glm::vec3(0.5f * cs, 0.5f * cs, 0.5f * (high - low));
+	for (size_t t = 0; t < count; ++t) {
+		glm::vec3 const &a = triangles[3*t+0], &b = triangles[3*t+1], &c = triangles[3*t+2];
+		float z_min = std::min({a.z, b.z, c.z}), z_max = std::max({a.z, b.z, c.z});
+		glm::ivec2 first, last;
+		cell_range(glm::min(glm::vec2(a), glm::min(glm::vec2(b), glm::vec2(c))) - glm::vec2(0.5f * cs),
+			glm::max(glm::vec2(a), glm::max(glm::vec2(b), glm::vec2(c))) + glm::vec2(0.5f * cs), &first, &last);
+		for (int32_t y = first.y; y <= last.y; ++y) {
+			for (int32_t x = first.x; x <= last.x; ++x) {
+				uint32_t i = cell_index(glm::ivec2(x, y));
+				if (!open[i]) continue;
+				float h = cell_height[i];
+				if (z_max < h + low || z_min > h + high) continue;
+				if (triangle_overlaps_box(a, b, c, glm::vec3(center_of(x, y), h + 0.5f * (low + high)), half)) open[i] = 0;
+			}
+		}
+	}
+
+	//keep 'agent_radius' away from anything not open (or a drop of more than max_climb):
+	std::vector< uint8_t > walkable = open;
+	if (params.agent_radius > 0.0f) {
+		float r = params.agent_radius / cs;
+		int32_t reach = int32_t(std::ceil(r));
+		std::vector< glm::ivec2 > offsets;
+		for (int32_t dy = -reach; dy <= reach; ++dy) {
+			for (int32_t dx = -reach; dx <= reach; ++dx) {
+				if ((dx != 0 || dy != 0) && float(dx * dx + dy * dy) <= r * r) offsets.emplace_back(dx, dy);
+			}
+		}
+		for (int32_t y = 0; y < size.y; ++y) {
+			for (int32_t x = 0; x < size.x; ++x) {
+				uint32_t i = cell_index(glm::ivec2(x, y));
+				if (!open[i]) continue;
+				for (glm::ivec2 const &o : offsets) {
+					glm::ivec2 n = glm::ivec2(x, y) + o;
+					if (n.x < 0 || n.y < 0 || n.x >= size.x || n.y >= size.y || !open[cell_index(n)]
+					 || std::abs(cell_height[cell_index(n)] - cell_height[i]) > params.max_climb) {
+						walkable[i] = 0;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	//merge walkable cells into rectangles (greedily: run along x, then extend the run in y):
+	// (size is capped so that A*'s distance estimates stay reasonable)
+	constexpr int32_t MaxSpan = 64;
+	cell_poly.assign(cells, -1U);
+	polys.clear();
+	for (int32_t y = 0; y < size.y; ++y) {
+		for (int32_t x = 0; x < size.x; ++x) {
+			uint32_t i = cell_index(glm::ivec2(x, y));
+			if (!walkable[i] || cell_poly[i] != -1U) continue;
+			float z = cell_height[i];
+			auto joins = [&](int32_t cx, int32_t cy) {
+				uint32_t c = cell_index(glm::ivec2(cx, cy));
+				return walkable[c] && cell_poly[c] == -1U && std::abs(cell_height[c] - z) <= params.max_climb;
+			};
+			int32_t x1 = x + 1;
+			while (x1 < size.x && x1 - x < MaxSpan && joins(x1, y)) ++x1;
+			int32_t y1 = y + 1;
+			while (y1 < size.y && y1 - y < MaxSpan) {
+				bool row = true;
+				for (int32_t cx = x; cx < x1 && row; ++cx) row = joins(cx, y1);
+				if (!row) break;
+				++y1;
+			}
+
+			uint32_t p = uint32_t(polys.size());
+			polys.emplace_back(Poly{glm::ivec2(x, y), glm::ivec2(x1, y1), z, 0, 0});
+			for (int32_t cy = y; cy < y1; ++cy) {
+				for (int32_t cx = x; cx < x1; ++cx) {
+					cell_poly[cell_index(glm::ivec2(cx, cy))] = p;
+				}
+			}
+		}
+	}
+
+	//portals -- runs of border cells whose neighbors across the border are in the same rectangle:
+	links.clear();
+	for (uint32_t p = 0; p < polys.size(); ++p) {
+		Poly &poly = polys[p];
+		poly.link_begin = uint32_t(links.size());
+
+		//side: (inside cell, outside cell) pairs along one edge, walked in increasing x or y:
+		auto side = [&](glm::ivec2 start, glm::ivec2 step, glm::ivec2 out, int32_t length, bool flip) {
+			uint32_t run_poly = -1U;
+			int32_t run_start = 0;
+			auto finish = [&](int32_t end) {
+				if (run_poly == -1U) return;
+				//portal along the shared edge, from cell run_start to cell end:
+				glm::vec2 edge = origin + glm::vec2(start + glm::max(out, glm::ivec2(0))) * cs;
+				glm::vec2 along = glm::vec2(step) * cs;
+				glm::vec2 a = edge + along * float(run_start), b = edge + along * float(end);
+				links.emplace_back(Link{run_poly, flip ? b : a, flip ? a : b});
+				run_poly = -1U;
+			};
+			for (int32_t k = 0; k < length; ++k) {
+				glm::ivec2 in = start + step * k, o = in + out;
+				uint32_t q = -1U;
+				if (o.x >= 0 && o.y >= 0 && o.x < size.x && o.y < size.y) {
+					uint32_t oi = cell_index(o);
+					if (cell_poly[oi] != -1U && std::abs(cell_height[oi] - cell_height[cell_index(in)]) <= params.max_climb) q = cell_poly[oi];
+				}
+				if (q != run_poly) {
+					finish(k);
+					if (q != -1U) { run_poly = q; run_start = k; }
+				}
+			}
+			finish(length);
+		};
+		glm::ivec2 extent = poly.max - poly.min;
+		//(portal ends are ordered so that 'left' is on the left when leaving the rectangle)
+		side(glm::ivec2(poly.max.x - 1, poly.min.y), glm::ivec2(0, 1), glm::ivec2( 1, 0), extent.y, false); //+x
+		side(glm::ivec2(poly.min.x, poly.min.y), glm::ivec2(0, 1), glm::ivec2(-1, 0), extent.y, true); //-x
+		side(glm::ivec2(poly.min.x, poly.max.y - 1), glm::ivec2(1, 0), glm::ivec2(0, 1), extent.x, true); //+y
+		side(glm::ivec2(poly.min.x, poly.min.y), glm::ivec2(1, 0), glm::ivec2(0, -1), extent.x, false); //-y
+
+		poly.link_end = uint32_t(links.size());
+	}
+}
+
+float NavMesh::height_at(glm::vec2 const &point, uint32_t poly) const {
+	Poly const &p = polys[poly];
+	glm::ivec2 cell = glm::clamp(cell_of(point), p.min, p.max - glm::ivec2(1));
+	return cell_height[cell_index(cell)];
+}
+
+bool NavMesh::locate(glm::vec3 const &point, uint32_t *poly_, glm::vec3 *on_mesh_) const {
+	if (polys.empty()) return false;
+	glm::vec2 p = glm::vec2(point);
+	glm::ivec2 cell = cell_of(p);
+
+	//nearest walkable cell within snap_distance:
+	float const cs = params.cell_size;
+	int32_t reach = int32_t(std::min(std::ceil(snap_distance / cs), float(std::max(size.x, size.y))));
+	float best = snap_distance * snap_distance;
+	uint32_t best_cell = -1U;
+	glm::vec2 best_point = p;
+	glm::ivec2 first = glm::max(glm::ivec2(0), cell - glm::ivec2(reach));
+	glm::ivec2 last = glm::min(size - glm::ivec2(1), cell + glm::ivec2(reach));
+	for (int32_t y = first.y; y <= last.y; ++y) {
+		for (int32_t x = first.x; x <= last.x; ++x) {
+			uint32_t i = cell_index(glm::ivec2(x, y));
+			if (cell_poly[i] == -1U) continue;
+			glm::vec2 lo = origin + glm::vec2(float(x), float(y)) * cs;
+			glm::vec2 closest = glm::clamp(p, lo, lo + glm::vec2(cs));
+			glm::vec2 d = closest - p;
+			//(floors within climbing distance of the point's height count as level with it)
+			float dz = std::max(0.0f, std::abs(cell_height[i] - point.z) - params.max_climb);
+			float distance2 = glm::dot(d, d) + dz * dz;
+			if (distance2 <= best) {
+				best = distance2;
+				best_cell = i;
+				best_point = closest;
+				if (distance2 == 0.0f) break;
+			}
+		}
+		if (best == 0.0f && best_cell != -1U) break;
+	}
+	if (best_cell == -1U) return false;
+
+	if (poly_) *poly_ = cell_poly[best_cell];
+	if (on_mesh_) *on_mesh_ = glm::vec3(best_point, cell_height[best_cell]);
+	return true;
+}
+
+bool NavMesh::find_corridor(uint32_t from_poly, glm::vec2 const &from, uint32_t to_poly, glm::vec2 const &to, std::vector< uint32_t > *corridor) const {
+	assert(corridor);
+	corridor->clear();
+	if (from_poly == to_poly) return true;
+
+	uint64_t key = (uint64_t(from_poly) << 32) | uint64_t(to_poly);
+	{ //cached?
+		std::unique_lock< std::mutex > lock(cache_mutex);
+		auto found = cache_index.find(key);
+		if (found != cache_index.end()) {
+			cache.splice(cache.begin(), cache, found->second);
+			*corridor = found->second->second;
+			cache_hits += 1;
+			return true;
+		}
+	}
+
+	//A*, where a rectangle is entered at the point of its portal closest to where the previous one was entered:
+	searches += 1;
+	struct Node {
+		float g;
+		glm::vec2 entry;
+		uint32_t from_link; //link used to get here (-1U for the start)
+		uint32_t from_poly;
+		bool closed;
+	};
+	std::unordered_map< uint32_t, Node > nodes;
+	using Open = std::pair< float, uint32_t >; //(estimated total, poly)
+	std::priority_queue< Open, std::vector< Open >, std::greater< Open > > open;
+
+	nodes.emplace(from_poly, Node{0.0f, from, -1U, -1U, false});
+	open.emplace(glm::length(to - from), from_poly);
+	uint32_t expanded = 0;
+	bool found = false;
+	while (!open.empty()) {
+		auto [estimate, poly] = open.top();
+		open.pop();
+		Node &node = nodes[poly];
+		if (node.closed) continue;
+		if (poly == to_poly) { found = true; break; }
+		node.closed = true;
+		if (++expanded > max_search_nodes) break;
+
+		Node const current = node; //('nodes' may rehash below)
+		Poly const &p = polys[poly];
+		for (uint32_t l = p.link_begin; l < p.link_end; ++l) {
+			Link const &link = links[l];
+			glm::vec2 along = link.left - link.right;
+			float t = glm::clamp(glm::dot(current.entry - link.right, along) / glm::dot(along, along), 0.0f, 1.0f);
+			glm::vec2 entry = link.right + t * along;
+			float g = current.g + glm::length(entry - current.entry);
+
+			auto [at, inserted] = nodes.try_emplace(link.poly, Node{g, entry, l, poly, false});
+			if (!inserted) {
+				if (at->second.closed || g >= at->second.g) continue;
+				at->second = Node{g, entry, l, poly, false};
+			}
+			open.emplace(g + glm::length(to - entry), link.poly);
+		}
+	}
+	nodes_expanded += expanded;
+	if (!found) return false;
+
+	for (uint32_t poly = to_poly; poly != from_poly; ) {
+		Node const &node = nodes[poly];
+		corridor->emplace_back(node.from_link);
+		poly = node.from_poly;
+	}
+	std::reverse(corridor->begin(), corridor->end());
+
+	{ //remember it:
+		std::unique_lock< std::mutex > lock(cache_mutex);
+		if (cache_capacity > 0 && cache_index.find(key) == cache_index.end()) {
+			cache.emplace_front(key, *corridor);
+			cache_index[key] = cache.begin();
+			while (cache.size() > cache_capacity) {
+				cache_index.erase(cache.back().first);
+				cache.pop_back();
+			}
+		}
+	}
+	return true;
+}
+
+void NavMesh::clear_cache() const {
+	std::unique_lock< std::mutex > lock(cache_mutex);
+	cache.clear();
+	cache_index.clear();
+}
+
+void NavMesh::smooth(glm::vec3 const &from, glm::vec3 const &to, std::vector< uint32_t > const &corridor, std::vector< glm::vec3 > *path) const {
+	assert(path);
+	path->clear();
+	path->emplace_back(from);
+
+	//portals as (left, right) pairs, starting and ending with the endpoints:
+	std::vector< std::pair< glm::vec2, glm::vec2 > > portals;
+	std::vector< uint32_t > portal_poly; //rectangle just past each portal
+	portals.reserve(corridor.size() + 2);
+	portals.emplace_back(glm::vec2(from), glm::vec2(from));
+	portal_poly.emplace_back(corridor.empty() ? -1U : links[corridor[0]].poly);
+	for (uint32_t l : corridor) {
+		portals.emplace_back(links[l].left, links[l].right);
+		portal_poly.emplace_back(links[l].poly);
+	}
+	portals.emplace_back(glm::vec2(to), glm::vec2(to));
+	portal_poly.emplace_back(-1U);
+
+	//(> 0 when b is to the left of a)
+	auto cross = [](glm::vec2 const &a, glm::vec2 const &b) { return a.x * b.y - a.y * b.x; };
+	auto add = [&](glm::vec2 const &point, uint32_t poly) {
+		if (glm::vec2(path->back()) == point) return;
+		path->emplace_back(point, poly == -1U ? to.z : height_at(point, poly));
+	};
+
+	//the "simple stupid funnel algorithm":
+	glm::vec2 apex = glm::vec2(from), left = apex, right = apex;
+	uint32_t apex_index = 0, left_index = 0, right_index = 0;
+	for (uint32_t i = 1; i < portals.size(); ++i) {
+		glm::vec2 const &l = portals[i].first, &r = portals[i].second;
+
+		//tighten the right side?
+		if (cross(right - apex, r - apex) >= 0.0f) {
+			if (apex == right || cross(left - apex, r - apex) < 0.0f) {
+				right = r;
+				right_index = i;
+			} else {
+				//right crossed over left, so left is a corner:
+				add(left, portal_poly[left_index]);
+				apex = left;
+				apex_index = left_index;
+				left = right = apex;
+				left_index = right_index = apex_index;
+				i = apex_index;
+				continue;
+			}
+		}
+
+		//tighten the left side?
+		if (cross(left - apex, l - apex) <= 0.0f) {
+			if (apex == left || cross(right - apex, l - apex) > 0.0f) {
+				left = l;
+				left_index = i;
+			} else {
+				//left crossed over right, so right is a corner:
+				add(right, portal_poly[right_index]);
+				apex = right;
+				apex_index = right_index;
+				left = right = apex;
+				left_index = right_index = apex_index;
+				i = apex_index;
+				continue;
+			}
+		}
+	}
+	if (glm::vec2(path->back()) == glm::vec2(to)) path->back() = to;
+	else path->emplace_back(to);
+}
+
+bool NavMesh::find_path(glm::vec3 const &from, glm::vec3 const &to, std::vector< glm::vec3 > *path) const {
+	PROFILE_SCOPE("NavMesh::find_path");
+	assert(path);
+	path->clear();
+
+	uint32_t from_poly, to_poly;
+	glm::vec3 start, goal;
+	if (!locate(from, &from_poly, &start) || !locate(to, &to_poly, &goal)) return false;
+
+	std::vector< uint32_t > corridor;
+	if (!find_corridor(from_poly, glm::vec2(start), to_poly, glm::vec2(goal), &corridor)) return false;
+
+	smooth(start, goal, corridor, path);
+	return true;
+}
+
+//----------------------------
+//asynchronous queries:
+
+NavMesh::Requests::Requests(NavMesh const &navmesh_) : navmesh(navmesh_) {
+}
+
+NavMesh::Requests::~Requests() {
+	std::unique_lock< std::mutex > lock(mutex);
+	quit = true;
+	queue.clear();
+	idle.wait(lock, [this]() { return !running; });
+}
+
+uint32_t NavMesh::Requests::request(glm::vec3 const &from, glm::vec3 const &to) {
+	bool start = false;
+	uint32_t ticket;
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		ticket = next_ticket++;
+		if (next_ticket == 0) next_ticket = 1;
+		queue.emplace_back(Query{ticket, from, to});
+		results[ticket] = Result();
+		if (!running) {
+			running = true;
+			start = true;
+		}
+	}
+	//one job at a time works through the queue:
+	if (start) WorkerPool::get().run([this]() { drain(); });
+	return ticket;
+}
+
+void NavMesh::Requests::drain() {
+	std::unique_lock< std::mutex > lock(mutex);
+	while (!queue.empty() && !quit) {
+		Query query = queue.front();
+		queue.pop_front();
+		lock.unlock();
+
+		Result result;
+		try {
+			result.status = (navmesh.find_path(query.from, query.to, &result.path) ? Found : NotFound);
+		} catch (...) {
+			result.status = NotFound;
+			result.path.clear();
+		}
+
+		lock.lock();
+		auto found = results.find(query.ticket);
+		if (found != results.end()) found->second = std::move(result);
+	}
+	running = false;
+	idle.notify_all();
+}
+
+NavMesh::Requests::Status NavMesh::Requests::take(uint32_t ticket, std::vector< glm::vec3 > *path) {
+	assert(path);
+	std::unique_lock< std::mutex > lock(mutex);
+	auto found = results.find(ticket);
+	if (found == results.end()) return NotFound;
+	Status status = found->second.status;
+	if (status == Pending) return Pending;
+	*path = std::move(found->second.path);
+	results.erase(found);
+	return status;
+}
+
+void NavMesh::Requests::wait() {
+	std::unique_lock< std::mutex > lock(mutex);
+	idle.wait(lock, [this]() { return !running; });
+}
+
+size_t NavMesh::Requests::outstanding() {
+	std::unique_lock< std::mutex > lock(mutex);
+	return results.size();
+}
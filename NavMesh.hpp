@@ -0,0 +1,174 @@
+#pragma once
+
+/*
+ * NavMesh is a navigation mesh -- the places an agent can stand, as convex polygons joined by portals --
+ * built from scene triangles, with A* path queries:
+ *
+ * NavMesh::Params params; //cell size, agent size, ...
+ * NavMesh navmesh(scene, *meshes, meshes_vao, StaticBatches::except_under({"Player", "Enemy"}), params);
+ * std::vector< glm::vec3 > path;
+ * if (navmesh.find_path(from, to, &path)) { ... walk from path[0] to path.back() ... }
+ *
+ * //or, without stalling the caller:
+ * NavMesh::Requests requests(navmesh);
+ * uint32_t ticket = requests.request(from, to);
+ * //...later (e.g., next frame):
+ * if (requests.take(ticket, &path) == NavMesh::Requests::Found) { ... }
+ *
+ * Building works on a grid of cells (a voxel-style pass, in the spirit of Recast):
+ *  - gently sloped, upward-facing triangles are floors; each cell's floor is the highest floor over its center;
+ *  - cells where any triangle comes between 'max_climb' and 'agent_height' above the floor are blocked;
+ *  - cells within 'agent_radius' of a blocked or floorless cell -- or of a step too high to climb -- are removed,
+ *    so paths keep clear of walls and ledges;
+ *  - the remaining cells are merged into rectangles, and neighboring rectangles whose floors are within
+ *    'max_climb' of each other are joined by portals along their shared edges.
+ * (So: one walkable layer -- no bridges over walkways -- and the z axis is up.)
+ *
+ * Queries run A* over rectangles, then pull the path tight through the portals with the "funnel" algorithm.
+ * Corridors (the rectangles a path crosses) are kept in a least-recently-used cache shared by all queries,
+ * keyed by start and goal rectangle, so agents re-walking the same routes skip the search.
+ *
+ * A built NavMesh is read-only (apart from the cache, which has its own lock), so queries may run on any thread.
+ *
+ */
+
+#include "Scene.hpp"
+#include "Mesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+struct NavMesh {
+	struct Params {
+		float cell_size = 0.25f; //grid resolution (smaller is more accurate but slower to build)
+		float agent_radius = 0.4f; //paths stay at least this far from walls
+		float agent_height = 1.8f; //ceilings lower than this block
+		float max_climb = 0.3f; //steps up to this high can be walked over
+		float max_slope_degrees = 45.0f; //steeper triangles aren't floors
+	};
+
+	//build from the triangles of drawables that 'include' accepts and that draw GL_TRIANGLES from 'meshes' through 'vao':
+	// (positions are read from the scene's transforms at construction time; throws if the grid would be huge)
+	NavMesh(Scene const &scene, MeshBuffer const &meshes, GLuint vao,
+		std::function< bool(Scene::Drawable const &) > const &include, Params const &params);
+
+	//build from world-space triangles (three points per triangle):
+	NavMesh(std::vector< glm::vec3 > const &triangles, Params const &params);
+
+	//--- queries ---
+
+	//path from 'from' to 'to' along the mesh, including both (snapped onto the mesh) -- false if there isn't one:
+	// (points farther than 'snap_distance' from the mesh have no path)
+	bool find_path(glm::vec3 const &from, glm::vec3 const &to, std::vector< glm::vec3 > *path) const;
+
+	//rectangle nearest 'point' (within 'snap_distance'; height differences up to max_climb are ignored), and the nearest point on it -- false if none:
+	bool locate(glm::vec3 const &point, uint32_t *poly, glm::vec3 *on_mesh) const;
+
+	float snap_distance = 2.0f;
+	uint32_t max_search_nodes = 16384; //A* gives up (no path) after expanding this many rectangles
+
+	//corridors kept in the cache:
+	size_t cache_capacity = 256;
+	void clear_cache() const;
+
+	//running statistics (reset whenever you like):
+	mutable std::atomic< uint32_t > searches{0}, cache_hits{0}, nodes_expanded{0};
+
+	//--- asynchronous queries ---
+
+	//Requests runs path queries on a WorkerPool thread, one after another:
+	// (with no worker threads, request() finds the path before returning)
+	struct Requests {
+		Requests(NavMesh const &navmesh);
+		~Requests(); //waits for the query in progress (if any); queued ones are dropped
+
+		Requests(Requests const &) = delete;
+		Requests &operator=(Requests const &) = delete;
+
+		//queue a query; returns a ticket for take():
+		uint32_t request(glm::vec3 const &from, glm::vec3 const &to);
+
+		enum Status : uint8_t {
+			Pending, //not done yet
+			Found, //done; 'path' holds the path
+			NotFound, //done, no path (or unknown ticket)
+		};
+		//check on a query -- once it's done, its result is handed over and the ticket is forgotten:
+		Status take(uint32_t ticket, std::vector< glm::vec3 > *path);
+
+		//queries not yet taken:
+		size_t outstanding();
+
+		//block until every query requested so far is done (e.g., so results don't depend on timing):
+		void wait();
+
+		//--- internals ---
+		NavMesh const &navmesh;
+		struct Query {
+			uint32_t ticket;
+			glm::vec3 from, to;
+		};
+		struct Result {
+			Status status = Pending;
+			std::vector< glm::vec3 > path;
+		};
+		std::mutex mutex;
+		std::condition_variable idle;
+		std::deque< Query > queue;
+		std::unordered_map< uint32_t, Result > results;
+		uint32_t next_ticket = 1;
+		bool running = false; //a job is draining 'queue'
+		bool quit = false;
+		void drain();
+	};
+
+	//--- internals ---
+
+	Params params;
+
+	//grid:
+	glm::vec2 origin = glm::vec2(0.0f); //corner of cell (0,0)
+	glm::ivec2 size = glm::ivec2(0); //cells in x and y
+	std::vector< float > cell_height; //floor height per cell (-infinity if none)
+	std::vector< uint32_t > cell_poly; //rectangle per cell (-1U if not walkable)
+
+	//rectangles of cells [min, max):
+	struct Poly {
+		glm::ivec2 min, max;
+		float z; //floor height (of first cell)
+		uint32_t link_begin, link_end; //range of 'links'
+	};
+	std::vector< Poly > polys;
+
+	//portals, grouped by the rectangle they leave:
+	struct Link {
+		uint32_t poly; //rectangle on the other side
+		glm::vec2 right, left; //ends of the portal, as seen leaving
+	};
+	std::vector< Link > links;
+
+	uint32_t cell_index(glm::ivec2 const &cell) const { return uint32_t(cell.y) * uint32_t(size.x) + uint32_t(cell.x); }
+	glm::ivec2 cell_of(glm::vec2 const &point) const { return glm::ivec2(glm::floor((point - origin) / params.cell_size)); }
+	float height_at(glm::vec2 const &point, uint32_t poly) const;
+
+	void build(std::vector< glm::vec3 > const &triangles);
+
+	//A* over rectangles: links crossed from 'from_poly' to 'to_poly' (cached):
+	bool find_corridor(uint32_t from_poly, glm::vec2 const &from, uint32_t to_poly, glm::vec2 const &to, std::vector< uint32_t > *corridor) const;
+	//funnel algorithm: shortest path through the corridor's portals:
+	void smooth(glm::vec3 const &from, glm::vec3 const &to, std::vector< uint32_t > const &corridor, std::vector< glm::vec3 > *path) const;
+
+	//least-recently-used corridors, keyed by (from_poly << 32 | to_poly):
+	mutable std::mutex cache_mutex;
+	mutable std::list< std::pair< uint64_t, std::vector< uint32_t > > > cache; //most recently used first
+	mutable std::unordered_map< uint64_t, decltype(cache)::iterator > cache_index;
+};
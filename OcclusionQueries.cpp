@@ -0,0 +1,212 @@
+#include "OcclusionQueries.hpp"
+
+#include "ColorProgram.hpp"
+#include "UniformBlocks.hpp"
+#include "GLState.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+
+OcclusionQueries::OcclusionQueries() {
+	glGenBuffers(1, &vertex_buffer);
+
+	//boxes are drawn with color_program; only its Position attribute is fed from a buffer:
+	// (Color uses the default generic attribute value, which is fine since color writes are off)
+	glGenVertexArrays(1, &vertex_buffer_for_color_program);
+	glBindVertexArray(vertex_buffer_for_color_program);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glVertexAttribPointer(color_program->Position_vec4, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLbyte *)0);
+	glEnableVertexAttribArray(color_program->Position_vec4);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	gl_state.invalidate(); //(vao and buffer were bound directly)
+
+	GL_ERRORS();
+}
+
+OcclusionQueries::~OcclusionQueries() {
+	for (Batch &batch : batches) {
+		if (!batch.pool.empty()) glDeleteQueries(GLsizei(batch.pool.size()), batch.pool.data());
+	}
+	glDeleteVertexArrays(1, &vertex_buffer_for_color_program);
+	glDeleteBuffers(1, &vertex_buffer);
+	gl_state.invalidate(); //(in case either was bound)
+}
+
+uint32_t OcclusionQueries::track(Scene::Transform const *transform, glm::vec3 const &min, glm::vec3 const &max, bool fraction) {
+	assert(transform);
+	uint32_t id = 0;
+	while (id < objects.size() && objects[id].transform != nullptr) ++id;
+	if (id == objects.size()) objects.emplace_back();
+
+	Object &object = objects[id];
+	object.transform = transform;
+	object.min = glm::min(min, max);
+	object.max = glm::max(min, max);
+	object.fraction = fraction;
+	object.visible_fraction = 0.0f;
+	object.result_frame = -1U;
+	return id;
+}
+
+void OcclusionQueries::untrack(uint32_t id) {
+	assert(id < objects.size() && objects[id].transform != nullptr);
+	objects[id].transform = nullptr;
+	objects[id].generation += 1;
+}
+
+void OcclusionQueries::collect(Batch &batch) {
+	assert(batch.pending);
+
+	//don't wait on the GPU -- if anything is outstanding, try again next frame:
+	for (Issued const &issued : batch.issued) {
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(issued.visible_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available && issued.total_query) {
+			glGetQueryObjectuiv(issued.total_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		}
+		if (!available) return;
+	}
+
+	for (Issued const &issued : batch.issued) {
+		Object &object = objects[issued.object];
+		if (object.generation != issued.generation) continue; //untracked since
+		if (object.result_frame != -1U && object.result_frame > batch.frame) continue; //already have something newer
+
+		GLuint visible = 0;
+		glGetQueryObjectuiv(issued.visible_query, GL_QUERY_RESULT, &visible);
+		if (issued.total_query) {
+			GLuint total = 0;
+			glGetQueryObjectuiv(issued.total_query, GL_QUERY_RESULT, &total);
+			object.visible_fraction = (total ? std::min(1.0f, float(visible) / float(total)) : 0.0f);
+		} else {
+			object.visible_fraction = (visible ? 1.0f : 0.0f);
+		}
+		object.result_frame = batch.frame;
+	}
+	batch.pending = false;
+}
+
+void OcclusionQueries::run(glm::mat4 const &clip_from_world, glm::vec3 const &eye) {
+	frame += 1;
+
+	for (Batch &batch : batches) {
+		if (batch.pending) collect(batch);
+	}
+
+	Batch &batch = batches[frame % Batches];
+	//the GPU is more than Batches frames behind -- skip measuring this frame rather than stall:
+	if (batch.pending) return;
+
+	//build box triangles (front faces wind counter-clockwise, seen from outside):
+	static constexpr uint8_t Faces[6][4] = {
+		{0,4,6,2}, //-x
+		{1,3,7,5}, //+x
+		{0,1,5,4}, //-y
+		{2,6,7,3}, //+y
+		{0,2,3,1}, //-z
+		{4,5,7,6}, //+z
+	};
+	vertices.clear();
+	batch.issued.clear();
+	for (uint32_t id = 0; id < objects.size(); ++id) {
+		Object &object = objects[id];
+		if (!object.transform) continue;
+
+		//when the eye is inside the box, the object counts as visible (its front faces aren't in view):
+		glm::vec3 local_eye = object.transform->make_local_from_world() * glm::vec4(eye, 1.0f);
+		if (object.min.x <= local_eye.x && local_eye.x <= object.max.x
+		 && object.min.y <= local_eye.y && local_eye.y <= object.max.y
+		 && object.min.z <= local_eye.z && local_eye.z <= object.max.z) {
+			object.visible_fraction = 1.0f;
+			object.result_frame = frame;
+			continue;
+		}
+
+		glm::mat4x3 world_from_local = object.transform->make_world_from_local();
+		glm::vec3 corners[8];
+		for (uint32_t c = 0; c < 8; ++c) {
+			corners[c] = world_from_local * glm::vec4(
+				(c & 1 ? object.max.x : object.min.x),
+				(c & 2 ? object.max.y : object.min.y),
+				(c & 4 ? object.max.z : object.min.z),
+				1.0f
+			);
+		}
+		//(a mirroring transform turns the box inside out)
+		bool flip = glm::determinant(glm::mat3(world_from_local)) < 0.0f;
+		for (auto const &face : Faces) {
+			uint8_t a = face[0], b = face[flip ? 3 : 1], c = face[2], d = face[flip ? 1 : 3];
+			vertices.insert(vertices.end(), { corners[a], corners[b], corners[c], corners[a], corners[c], corners[d] });
+		}
+
+		batch.issued.emplace_back(Issued{id, object.generation, 0, 0});
+	}
+	if (batch.issued.empty()) return;
+
+	//make sure there are enough query objects:
+	uint32_t needed = 0;
+	for (Issued const &issued : batch.issued) {
+		needed += (objects[issued.object].fraction ? 2 : 1);
+	}
+	if (batch.pool.size() < needed) {
+		size_t old_size = batch.pool.size();
+		batch.pool.resize(needed);
+		glGenQueries(GLsizei(needed - old_size), batch.pool.data() + old_size);
+	}
+	{
+		uint32_t next = 0;
+		for (Issued &issued : batch.issued) {
+			issued.visible_query = batch.pool[next++];
+			if (objects[issued.object].fraction) issued.total_query = batch.pool[next++];
+		}
+	}
+
+	//upload boxes:
+	gl_state.bind_array_buffer(vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]), vertices.data(), GL_STREAM_DRAW); //(orphans last frame's data)
+
+	gl_state.use_program(color_program->program);
+	UniformBlocks::Object block;
+	block.set(clip_from_world);
+	UniformBlocks::bind_object(UniformBlocks::stream_objects(&block, sizeof(block)));
+	gl_state.bind_vertex_array(vertex_buffer_for_color_program);
+
+	//count samples without touching the framebuffer:
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	gl_state.enable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+
+	//samples in front of the scene:
+	// (LEQUAL, so box faces that coincide with the depth buffer still count)
+	glDepthFunc(GL_LEQUAL);
+	for (uint32_t i = 0; i < batch.issued.size(); ++i) {
+		Issued const &issued = batch.issued[i];
+		GLenum target = (issued.total_query ? GL_SAMPLES_PASSED : GL_ANY_SAMPLES_PASSED);
+		glBeginQuery(target, issued.visible_query);
+		glDrawArrays(GL_TRIANGLES, GLint(i * 36), 36);
+		glEndQuery(target);
+	}
+
+	//...and all samples the boxes cover, for fractions:
+	glDepthFunc(GL_ALWAYS);
+	for (uint32_t i = 0; i < batch.issued.size(); ++i) {
+		Issued const &issued = batch.issued[i];
+		if (!issued.total_query) continue;
+		glBeginQuery(GL_SAMPLES_PASSED, issued.total_query);
+		glDrawArrays(GL_TRIANGLES, GLint(i * 36), 36);
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+
+	glDepthFunc(GL_LESS);
+	glDisable(GL_CULL_FACE);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	batch.pending = true;
+	batch.frame = frame;
+
+	GL_ERRORS();
+}
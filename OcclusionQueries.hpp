@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+ * OcclusionQueries measures how much of each of a set of tracked objects is visible,
+ * using GPU occlusion queries instead of reading back the depth buffer:
+ *
+ * OcclusionQueries occlusion;
+ * uint32_t id = occlusion.track(enemy, box_min, box_max);
+ *
+ * //each frame, after drawing the scene (so its depth is in the depth buffer):
+ * occlusion.run(clip_from_world, eye);
+ * float fraction = occlusion.visible_fraction(id);
+ *
+ * run() draws each object's (local-space) bounding box with color and depth writes off,
+ * counting samples that pass the depth test (and, for fractions, samples the box covers at all).
+ * Results are collected in later calls to run(), once the GPU has them -- run() never waits --
+ * so values lag the current frame by a frame or two (see 'latency').
+ *
+ */
+
+#include "Scene.hpp"
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+struct OcclusionQueries {
+	OcclusionQueries();
+	~OcclusionQueries();
+
+	//copying would share query objects:
+	OcclusionQueries(OcclusionQueries const &) = delete;
+	OcclusionQueries &operator=(OcclusionQueries const &) = delete;
+
+	//start tracking the box [min,max] in 'transform's local space; returns an id for the other functions:
+	// fraction: measure the visible fraction of the box (two GL_SAMPLES_PASSED queries)
+	//  instead of only whether any of it is visible (one GL_ANY_SAMPLES_PASSED query)
+	uint32_t track(Scene::Transform const *transform, glm::vec3 const &min, glm::vec3 const &max, bool fraction = true);
+	//stop tracking (the id may be re-used by later track() calls):
+	void untrack(uint32_t id);
+
+	//collect finished results and issue queries for this frame:
+	// call with the depth buffer holding the scene and depth testing enabled;
+	// changes glDepthFunc (leaves it at the default, GL_LESS)
+	void run(glm::mat4 const &clip_from_world, glm::vec3 const &eye);
+
+	//most recent result for a tracked object:
+	// fraction of its box's front faces that passed the depth test (0 or 1 when not tracked with 'fraction'),
+	// 0 until the first result arrives; 1 whenever 'eye' is inside the box
+	float visible_fraction(uint32_t id) const { return objects[id].visible_fraction; }
+	bool visible(uint32_t id) const { return objects[id].visible_fraction > 0.0f; }
+	//how many run() calls ago the queries behind that result were issued (-1U if none have finished):
+	uint32_t latency(uint32_t id) const { return objects[id].result_frame == -1U ? -1U : frame - objects[id].result_frame; }
+
+	//--- internals ---
+
+	struct Object {
+		Scene::Transform const *transform = nullptr; //nullptr => slot is free
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		bool fraction = true;
+		uint32_t generation = 0; //incremented by untrack() so results for a previous occupant are ignored
+		float visible_fraction = 0.0f;
+		uint32_t result_frame = -1U; //'frame' when the queries for visible_fraction were issued
+	};
+	std::vector< Object > objects;
+
+	//queries issued in one run() call:
+	struct Issued {
+		uint32_t object;
+		uint32_t generation;
+		GLuint visible_query; //samples passing the depth test (GL_ANY_SAMPLES_PASSED or GL_SAMPLES_PASSED)
+		GLuint total_query; //samples covered by the box with no depth test (GL_SAMPLES_PASSED), or 0
+	};
+	struct Batch {
+		bool pending = false; //issued queries haven't all been collected yet
+		uint32_t frame = 0; //run() call that issued them
+		std::vector< Issued > issued;
+		std::vector< GLuint > pool; //query objects owned by this batch (reused every time it is issued)
+	};
+	//a few frames' worth of queries can be in flight; when all are pending, run() skips issuing:
+	enum : uint32_t { Batches = 3 };
+	Batch batches[Batches];
+	uint32_t frame = 0; //count of run() calls
+
+	std::vector< glm::vec3 > vertices; //box triangles for this frame's queries
+	GLuint vertex_buffer = 0;
+	GLuint vertex_buffer_for_color_program = 0;
+
+	void collect(Batch &batch); //read results if they are all available
+};
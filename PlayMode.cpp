@@ -3,58 +3,143 @@
 #include "LitColorTextureProgram.hpp"
 
 #include "DrawLines.hpp"
+#include "GLState.hpp"
 #include "Mesh.hpp"
+#include "StaticBatches.hpp"
+#include "RayCaster.hpp"
+#include "Profiler.hpp"
 #include "Load.hpp"
 #include "gl_errors.hpp"
 #include "data_path.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <limits>
 #include <random>
 
 GLuint zoo_meshes_for_lit_color_texture_program = 0;
-Load< MeshBuffer > zoo_meshes(LoadTagDefault, []() -> MeshBuffer const * {
-	MeshBuffer const *ret = new MeshBuffer(data_path("zoo_nolink.pnct"));
-	zoo_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
-	return ret;
+//the .pnct and .scene files are read at the same time (on worker threads), then the mesh upload,
+// the drawables and static batches that need it, and the navigation mesh follow in order:
+
+Load< MeshBuffer > zoo_meshes(LoadSteps< MeshBuffer >{
+	.cpu = []() {
+		return MeshBuffer::read(data_path("zoo_nolink.pnct"));
+	},
+	.gl_after = { &lit_color_texture_program },
+	.gl = [](MeshBuffer &meshes) {
+		meshes.upload();
+		zoo_meshes_for_lit_color_texture_program = meshes.make_vao_for_program(lit_color_texture_program->program);
+	},
 });
 
-Load< Scene > zoo_scene(LoadTagDefault, []() -> Scene const * {
-	return new Scene(data_path("zoo_nolink.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
-		Mesh const &mesh = zoo_meshes->lookup(mesh_name);
-
-		scene.drawables.emplace_back(transform);
-		Scene::Drawable &drawable = scene.drawables.back();
-
-		drawable.pipeline = lit_color_texture_program_pipeline;
-
-		drawable.pipeline.vao = zoo_meshes_for_lit_color_texture_program;
-		drawable.pipeline.type = mesh.type;
-		drawable.pipeline.start = mesh.start;
-		drawable.pipeline.count = mesh.count;
+//mesh names of zoo_scene's drawables, kept from reading the file until the meshes are loaded:
+static std::vector< std::string > zoo_scene_mesh_names;
+
+Load< Scene > zoo_scene(LoadSteps< Scene >{
+	.cpu = []() {
+		return new Scene(data_path("zoo_nolink.scene"), [](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+			scene.drawables.emplace_back(transform);
+			zoo_scene_mesh_names.emplace_back(mesh_name);
+		});
+	},
+	.gl_after = { &zoo_meshes, &lit_color_texture_program },
+	.gl = [](Scene &scene) {
+		assert(zoo_scene_mesh_names.size() == scene.drawables.size());
+		for (uint32_t i = 0; i < scene.drawables.size(); ++i) {
+			Mesh const &mesh = zoo_meshes->lookup(zoo_scene_mesh_names[i]);
+			Scene::Drawable &drawable = scene.drawables[i];
+
+			drawable.pipeline = lit_color_texture_program_pipeline;
+
+			drawable.pipeline.vao = zoo_meshes_for_lit_color_texture_program;
+			drawable.pipeline.type = mesh.type;
+			drawable.pipeline.start = mesh.start;
+			drawable.pipeline.count = mesh.count;
+
+			drawable.min = mesh.min;
+			drawable.max = mesh.max;
+		}
+		zoo_scene_mesh_names.clear();
+
+		//bake everything that never moves into a few world-space batches:
+		// (the batches are never freed, same as the loaded scene they belong to)
+		StaticBatches *batches = new StaticBatches(scene, *zoo_meshes, zoo_meshes_for_lit_color_texture_program,
+			StaticBatches::except_under({"Player", "Enemy", "Final_Deer"}));
+		std::cout << "Baked " << batches->baked << " static drawables into " << batches->batches << " batches"
+			<< " (" << batches->draws_before << " -> " << batches->draws_after << " draws)." << std::endl;
+	},
+});
 
-	});
+//walkable areas of the zoo (built on a worker thread once the scene -- and its static batches -- are loaded):
+Load< NavMesh > zoo_navmesh(LoadSteps< NavMesh >{
+	.after = { &zoo_scene, &zoo_meshes },
+	.cpu = []() {
+		NavMesh::Params params;
+		NavMesh *ret = new NavMesh(*zoo_scene, *zoo_meshes, zoo_meshes_for_lit_color_texture_program,
+			StaticBatches::except_under({"Player", "Enemy", "Final_Deer"}), params);
+		std::cout << "Built navigation mesh: " << ret->polys.size() << " regions, " << ret->links.size() << " portals"
+			<< " (" << ret->size.x << "x" << ret->size.y << " cells)." << std::endl;
+		return ret;
+	},
 });
 
+//bounding box, in 'root's local space, of the drawables attached to 'root' or its descendants:
+// (a unit box around the origin if there are none)
+static void local_bounds(Scene const &scene, Scene::Transform const *root, glm::vec3 *min_, glm::vec3 *max_) {
+	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+	glm::mat4x3 root_from_world = root->make_local_from_world();
+	for (Scene::Drawable const &drawable : scene.drawables) {
+		if (!(drawable.min.x <= drawable.max.x)) continue;
+		Scene::Transform const *t = drawable.transform;
+		while (t && t != root) t = t->parent;
+		if (!t) continue;
+		glm::mat4x3 root_from_local = root_from_world * glm::mat4(drawable.transform->make_world_from_local());
+		for (uint32_t c = 0; c < 8; ++c) {
+			glm::vec3 corner = root_from_local * glm::vec4(
+				(c & 1 ? drawable.max.x : drawable.min.x),
+				(c & 2 ? drawable.max.y : drawable.min.y),
+				(c & 4 ? drawable.max.z : drawable.min.z),
+				1.0f
+			);
+			min = glm::min(min, corner);
+			max = glm::max(max, corner);
+		}
+	}
+	if (!(min.x <= max.x)) {
+		min = glm::vec3(-0.5f);
+		max = glm::vec3( 0.5f);
+	}
+	*min_ = min;
+	*max_ = max;
+}
 
 PlayMode::PlayMode() : scene(*zoo_scene) {
 	//get pointers to transforms for convenience:
-	for (auto &transform : scene.transforms) {
-		if (transform.name == "Player") player = &transform;
-		if (transform.name == "Enemy") enemy = &transform;
-		if (transform.name == "Final_Deer") final_deer = &transform;
-		if (transform.name == "Final_Deer Leg") {
-			final_deer_leg = &transform;
-			transform.scale = glm::vec3(0.0f); // set invisible initially
-		}
-	}
+	player = scene.find("Player");
+	enemy = scene.find("Enemy");
+	final_deer = scene.find("Final_Deer");
+	final_deer_leg = scene.find("Final_Deer Leg");
 	if (player == nullptr) throw std::runtime_error("Player not found.");
 	if (enemy == nullptr) throw std::runtime_error("enemy not found.");
 	if (final_deer == nullptr) throw std::runtime_error("final_deer not found.");
 	if (final_deer_leg == nullptr) throw std::runtime_error("final_deer_leg not found.");
+	final_deer_leg->scale = glm::vec3(0.0f); // set invisible initially
 
 	player_base_rotation = player->rotation;
 
+	//simulate at a steady 60Hz; draw() blends between steps:
+	fixed_timestep = 1.0f / 60.0f;
+
+	//set up light type and direction for lit_color_texture_program:
+	// TODO: consider using the Light(s) in the scene to do this
+	scene.frame_light.type = Scene::FrameLight::Hemisphere;
+	scene.frame_light.direction = glm::vec3(0.0f, 0.0f,-1.0f);
+	scene.frame_light.energy = glm::vec3(1.0f, 1.0f, 0.95f);
+
 	//get pointer to camera for convenience:
 	if (scene.cameras.size() != 1) throw std::runtime_error("Expecting scene to have exactly one camera, but it has " + std::to_string(scene.cameras.size()));
 	camera = &scene.cameras.front();
@@ -67,19 +152,117 @@ PlayMode::PlayMode() : scene(*zoo_scene) {
 	cam->set_max_distance_from_camera_center(5.f);
 	// cam->set_pitch_range(-(float)M_PI, 0.f); //default
 
-	enemy_base_rotation = enemy->rotation;
-
-	// build a simple square/loop around the enemy's start position:
-	glm::vec3 e0 = enemy->position;
-	float R = 6.0f; // patrol radius
-	enemy_waypoints = {
-		e0 + glm::vec3( 0.0f,  R, 0.0f),
-		e0 + glm::vec3( R,  0.0f, 0.0f),
-		e0 + glm::vec3( 0.0f, -R, 0.0f),
-		e0 + glm::vec3(-R,  0.0f, 0.0f)
-	};
-	enemy_wp_idx = 0;
-	enemy_wait_timer = 0.0f;
+	{ //measure the enemy's on-screen visibility with occlusion queries against its (local-space) bounding box:
+		glm::vec3 min, max;
+		local_bounds(scene, enemy, &min, &max);
+		enemy_occlusion = occlusion.track(enemy, min, max);
+	}
+
+	{ //enemies' line of sight is tested against the zoo's triangles:
+		line_of_sight = std::make_unique< RayCaster >(scene, *zoo_meshes, zoo_meshes_for_lit_color_texture_program);
+
+		//sight lines end at the middle of the player's bounding box (not its origin, which may be on the ground):
+		glm::vec3 min, max;
+		local_bounds(scene, player, &min, &max);
+		player_center = 0.5f * (min + max);
+
+		agents.line_of_sight = line_of_sight.get();
+		agents.line_of_sight_ignore = [this](uint32_t d) {
+			return d < line_of_sight_ignored.size() && line_of_sight_ignored[d];
+		};
+	}
+
+	{ //the enemy walks a simple square loop around its start position:
+		Agents::Params params;
+		params.speed = 6.0f;
+		params.wait_at_point = 0.4f;
+		params.reach_epsilon = 0.15f;
+		params.view_distance = 10.0f;
+		params.fov_degrees = 70.0f;
+		params.grace = 0.15f;
+
+		//(sees from the middle of its bounding box)
+		glm::vec3 min, max;
+		local_bounds(scene, enemy, &min, &max);
+		params.eye = 0.5f * (min + max);
+
+		glm::vec3 e0 = enemy->position;
+		float R = 6.0f; // patrol radius
+		std::vector< glm::vec3 > stops = {
+			e0 + glm::vec3( 0.0f,  R, 0.0f),
+			e0 + glm::vec3( R,  0.0f, 0.0f),
+			e0 + glm::vec3( 0.0f, -R, 0.0f),
+			e0 + glm::vec3(-R,  0.0f, 0.0f)
+		};
+		enemy_agent = agents.add(enemy, params, stops);
+		patrols.emplace_back(Patrol{enemy_agent, stops, {}, {}});
+	}
+
+	{ //ask for paths around obstacles between patrol stops (answered on a worker thread):
+		path_requests = std::make_unique< NavMesh::Requests >(*zoo_navmesh);
+		for (Patrol &patrol : patrols) {
+			//(stops are in the agent's parent space; paths are in world space)
+			Scene::Transform const *parent = agents.transforms[patrol.agent]->parent;
+			glm::mat4x3 world_from_parent = (parent ? parent->make_world_from_local() : glm::mat4x3(1.0f));
+			for (uint32_t k = 0; k < patrol.stops.size(); ++k) {
+				glm::vec3 from = world_from_parent * glm::vec4(patrol.stops[k], 1.0f);
+				glm::vec3 to = world_from_parent * glm::vec4(patrol.stops[(k + 1) % patrol.stops.size()], 1.0f);
+				patrol.tickets.emplace_back(path_requests->request(from, to));
+			}
+			patrol.legs.resize(patrol.stops.size());
+		}
+	}
+
+	//agents and the player don't block the agents' view:
+	line_of_sight_ignored.assign(scene.drawables.size(), 0);
+	for (uint32_t d = 0; d < scene.drawables.size(); ++d) {
+		for (Scene::Transform const *at = scene.drawables[d].transform; at; at = at->parent) {
+			if (at == player || std::find(agents.transforms.begin(), agents.transforms.end(), at) != agents.transforms.end()) {
+				line_of_sight_ignored[d] = 1;
+			}
+		}
+	}
+}
+
+void PlayMode::update_patrols() {
+	//(paths arrive whenever the worker gets to them, which would differ between a recording and its replay)
+	if (Mode::deterministic && path_requests) path_requests->wait();
+
+	for (Patrol &patrol : patrols) {
+		if (patrol.tickets.empty()) continue;
+
+		bool waiting = false;
+		for (uint32_t k = 0; k < patrol.tickets.size(); ++k) {
+			if (patrol.tickets[k] == 0) continue;
+			NavMesh::Requests::Status status = path_requests->take(patrol.tickets[k], &patrol.legs[k]);
+			if (status == NavMesh::Requests::Pending) {
+				waiting = true;
+				continue;
+			}
+			patrol.tickets[k] = 0;
+			if (status == NavMesh::Requests::NotFound) patrol.legs[k].clear(); //(walk this leg straight)
+		}
+		if (waiting) continue;
+
+		//every leg is answered -- join them into one looping route that pauses only at stops:
+		Scene::Transform const *parent = agents.transforms[patrol.agent]->parent;
+		glm::mat4x3 parent_from_world = (parent ? parent->make_local_from_world() : glm::mat4x3(1.0f));
+		std::vector< glm::vec3 > route;
+		std::vector< float > pauses;
+		for (uint32_t k = 0; k < patrol.stops.size(); ++k) {
+			//(a leg starts at its stop, moved onto the navigation mesh, and ends at the next one)
+			std::vector< glm::vec3 > const &leg = patrol.legs[k];
+			route.emplace_back(leg.empty() ? patrol.stops[k] : glm::vec3(parent_from_world * glm::vec4(leg[0], 1.0f)));
+			pauses.emplace_back(agents.wait_at_point[patrol.agent]);
+			for (uint32_t c = 1; c + 1 < leg.size(); ++c) {
+				route.emplace_back(parent_from_world * glm::vec4(leg[c], 1.0f));
+				pauses.emplace_back(0.0f);
+			}
+		}
+		agents.set_route(patrol.agent, route, pauses);
+		patrol.tickets.clear();
+		patrol.legs.clear();
+	}
 }
 
 void PlayMode::trigger_game_over() {
@@ -95,6 +278,7 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 
 	if (evt.type == SDL_EVENT_KEY_DOWN) {
 		if (evt.key.key == SDLK_ESCAPE) {
+			mouse_look = false;
 			SDL_SetWindowRelativeMouseMode(Mode::window, false);
 			return true;
 		} else if (evt.key.key == SDLK_A) {
@@ -129,7 +313,8 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 			return true;
 		}
 	} else if (evt.type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
-		if (SDL_GetWindowRelativeMouseMode(Mode::window) == false) {
+		if (!mouse_look) {
+			mouse_look = true;
 			SDL_SetWindowRelativeMouseMode(Mode::window, true);
 			return true;
 		}
@@ -151,7 +336,7 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
         return true;
     	}
 	}else if (evt.type == SDL_EVENT_MOUSE_MOTION) {
-		if (SDL_GetWindowRelativeMouseMode(Mode::window) == true) {
+		if (mouse_look) {
 			glm::vec2 motion = glm::vec2(
 				evt.motion.xrel / float(window_size.y),
 				-evt.motion.yrel / float(window_size.y)
@@ -166,6 +351,11 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 }
 
 void PlayMode::update(float elapsed) {
+	PROFILE_SCOPE("PlayMode::update");
+
+	//(so draw can interpolate from here to wherever this step leaves things)
+	scene.save_previous_transforms();
+
 	// --- Camera zoom tween ---
 		if (game_over) {
 		// Optional: keep camera/UI effects, but block gameplay logic
@@ -192,9 +382,13 @@ void PlayMode::update(float elapsed) {
 		player->position += move.x * frame_right + move.y * frame_forward;
 	}
 
+	//world matrices are read below (agents, and where the player is), so bring them up to date with the move:
+	scene.update_world_matrices();
+
 	// --- Stalk bar charge/decay (depends on enemy on-screen visibility) ---
 	if (stalking && enemy_visible) {
-		stalk_charge += stalk_charge_rate * elapsed;
+		//(charges faster the more of the enemy is in view)
+		stalk_charge += stalk_charge_rate * enemy_visibility * elapsed;
 		if (stalk_charge > 1.0f) stalk_charge = 1.0f;
 	} else {
 		stalk_charge -= stalk_decay_rate * elapsed;
@@ -219,123 +413,10 @@ void PlayMode::update(float elapsed) {
 		}
 	}
 
-	// --- Enemy sensing: FOV + distance (+ optional LOS hook) ---
-	being_watched = false;
-	if (enemy && player) {
-		glm::mat4x3 e_world = enemy->make_world_from_local();
-		glm::vec3 e_pos     = e_world[3];
-		glm::vec3 e_forward = -glm::vec3(e_world[1]); // -Y is "forward"
-
-		glm::vec3 to_player3 = player->position - e_pos;
-		float dist = glm::length(to_player3);
-
-		if (dist > 0.0001f && dist <= enemy_view_distance) {
-			glm::vec3 dir = to_player3 / dist;
-			float cos_half_fov = std::cos(glm::radians(enemy_fov_deg * 0.5f));
-			float cos_theta    = glm::dot(glm::normalize(e_forward), dir);
-
-			bool in_fov = (cos_theta > cos_half_fov) && (glm::dot(e_forward, to_player3) > 0.0f);
-
-			// LOS hook (currently always unblocked):
-			auto occluded_enemy_to_player = [&]()->bool {
-				// TODO: implement a real ray/occlusion test if desired
-				return false;
-			};
-			bool blocked = occluded_enemy_to_player();
-
-			if (in_fov && !blocked) being_watched = true;
-		}
-	}
-
-	// --- Latch logic (sticky "seeing" state with grace timeout) ---
-	if (being_watched) {
-		watched_latched = true;
-		watched_grace_timer = watched_grace;
-		watched_accum += elapsed;
-		if (watched_accum >= watch_to_gameover) {
-			trigger_game_over();
-		}else {
-			// continuous requirement: reset if not watched this frame
-			watched_accum = 0.0f;
-		}
-	} else if (watched_latched) {
-		bool out_of_range = true;
-		bool blocked_now  = false;
-
-		if (enemy && player) {
-			glm::mat4x3 e_world = enemy->make_world_from_local();
-			glm::vec3 e_pos     = e_world[3];
-			float dist = glm::length(player->position - e_pos);
-			out_of_range = !(dist <= enemy_view_distance);
-
-			auto occluded_enemy_to_player = [&]()->bool { return false; };
-			blocked_now = occluded_enemy_to_player();
-		}
-
-		if (out_of_range || blocked_now) {
-			watched_grace_timer -= elapsed;
-			if (watched_grace_timer <= 0.0f) watched_latched = false;
-		} else {
-			// still good; refresh
-			watched_grace_timer = watched_grace;
-		}
-	}
-
-	// --- Enemy behavior: Stand-and-watch vs Patrol ---
-	if (enemy) {
-		// Compute planar vector to player for turning:
-		glm::vec2 to_player_xy(0.0f);
-		float to_player_dist = 0.0f;
-		if (player) {
-			glm::vec3 v = player->position - enemy->position;
-			to_player_xy = glm::vec2(v.x, v.y);
-			to_player_dist = glm::length(to_player_xy);
-		}
-
-		if (watched_latched) {
-			// STAND STILL, ONLY ROTATE to face player while latched
-			if (to_player_dist > 1e-4f) {
-				glm::vec2 dir = to_player_xy / to_player_dist;
-				float yaw = std::atan2(dir.x, dir.y); // +Y forward
-				glm::quat target_rot =
-					glm::angleAxis(yaw, glm::vec3(0.0f, 0.0f, 1.0f)) * enemy_base_rotation;
-
-				float turn_speed = 8.0f; // tweak feel
-				enemy->rotation = glm::slerp(enemy->rotation, target_rot,
-				                             1.0f - std::exp(-turn_speed * elapsed));
-			}
-			// NO translation here -> feet frozen
-
-		} else if (!enemy_waypoints.empty()) {
-			// PATROL: waypoint walking (original logic)
-			if (enemy_wait_timer > 0.0f) {
-				enemy_wait_timer = std::max(0.0f, enemy_wait_timer - elapsed);
-			} else {
-				glm::vec3 target = enemy_waypoints[enemy_wp_idx];
-				glm::vec2 to = glm::vec2(target.x - enemy->position.x,
-				                         target.y - enemy->position.y);
-				float dist = glm::length(to);
-
-				if (dist <= enemy_reach_epsilon) {
-					enemy_wp_idx = (enemy_wp_idx + 1) % enemy_waypoints.size();
-					enemy_wait_timer = enemy_wait_at_point;
-				} else if (dist > 0.0f) {
-					glm::vec2 dir = to / dist;
-					float step = enemy_speed * elapsed;
-					if (step > dist) step = dist;
-
-					enemy->position.x += dir.x * step;
-					enemy->position.y += dir.y * step;
-
-					float yaw = std::atan2(dir.x, dir.y);
-					glm::quat target_rot =
-						glm::angleAxis(yaw, glm::vec3(0.0f, 0.0f, 1.0f)) * enemy_base_rotation;
-					enemy->rotation = glm::slerp(enemy->rotation, target_rot,
-					                             1.0f - std::exp(-elapsed * 8.0f));
-				}
-			}
-		}
-	}
+	// --- Enemies: patrol, and watch for the player (stand and stare while they can see them) ---
+	update_patrols();
+	agents.update(elapsed, player->make_world_from_local() * glm::vec4(player_center, 1.0f));
+	being_watched = (agents.watching_count > 0);
 
 	// --- Audio listener follow player ---
 	{
@@ -350,79 +431,37 @@ void PlayMode::update(float elapsed) {
 }
 
 void PlayMode::draw(glm::uvec2 const &drawable_size) {
+	PROFILE_SCOPE("PlayMode::draw");
+
+	//show transforms partway between the last two updates:
+	scene.interpolate_transforms(interpolation);
+
 	//update camera aspect ratio for drawable:
 	camera->aspect = float(drawable_size.x) / float(drawable_size.y);
 
-	//set up light type and position for lit_color_texture_program:
-	// TODO: consider using the Light(s) in the scene to do this
-	glUseProgram(lit_color_texture_program->program);
-	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
-	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
-	glUseProgram(0);
+	//camera matrix for this frame (used for the scene and for projecting the enemy's position):
+	glm::mat4 clip_from_world = camera->make_projection() * glm::mat4(camera->transform->make_local_from_world());
 
 	if (focus_mode) {
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // stark white background for high contrast
+		gl_state.clear_color(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)); // stark white background for high contrast
 	} else {
-		glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+		gl_state.clear_color(glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
 	}
 	glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glEnable(GL_DEPTH_TEST);
+	gl_state.enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS); //this is the default depth comparison function, but FYI you can change it.
 
-	scene.draw(*camera);
-	enemy_visible = true; // default
+	scene.draw(clip_from_world);
+
+	//measure enemy visibility against the scene's depth (results arrive a frame or two later, without stalling):
+	occlusion.run(clip_from_world, camera->transform->make_world_from_local()[3]);
+	enemy_visibility = occlusion.visible_fraction(enemy_occlusion);
+	enemy_visible = (enemy_visibility > 0.0f);
 
-	
-	if (enemy) {
-		// Project enemy position to screen:
-		glm::mat4 clip_from_world = camera->make_projection() * glm::mat4(camera->transform->make_local_from_world());
-		glm::mat4x3 world_from_enemy = enemy->make_world_from_local();
-		glm::vec3 e_world = world_from_enemy[3];
-
-		glm::vec4 clip = clip_from_world * glm::vec4(e_world, 1.0f);
-		if (clip.w > 0.0f) {
-			glm::vec3 ndc = glm::vec3(clip) / clip.w; // [-1,1]
-			// Window coords (pixels):
-			float sx = (ndc.x * 0.5f + 0.5f) * drawable_size.x;
-			float sy = (ndc.y * 0.5f + 0.5f) * drawable_size.y;
-			float enemy_depth = ndc.z * 0.5f + 0.5f; // [0,1]
-
-			// Sample a small box around the enemy (e.g., ~20px radius):
-			const int radius = 20;
-			const int step   = 10;  // stride between samples
-			const float eps  = 1e-3f;
-
-			int total = 0;
-			int occluded = 0;
-
-			for (int dy = -radius; dy <= radius; dy += step) {
-				for (int dx = -radius; dx <= radius; dx += step) {
-					int px = int(sx) + dx;
-					int py = int(sy) + dy;
-					if (px < 0 || py < 0 || px >= int(drawable_size.x) || py >= int(drawable_size.y)) continue;
-
-					float depth_sample = 1.0f;
-					glReadPixels(px, py, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth_sample);
-
-					// If the sample depth is *in front of* the enemy (smaller), that point is blocked:
-					if (depth_sample + eps < enemy_depth) occluded++;
-					total++;
-				}
-			}
-			// "Fully blocked" ≈ all tested points occluded:
-			if (total > 0 && occluded == total) enemy_visible = false;
-		} else {
-			// behind camera
-			enemy_visible = false;
-		}
-	}
 	if (focus_mode && enemy && enemy_visible) {
 		// project enemy world position to clip space:
-		glm::mat4 clip_from_world = camera->make_projection() * glm::mat4(camera->transform->make_local_from_world());
-
 		glm::mat4x3 world_from_enemy = enemy->make_world_from_local();
 		glm::vec3 e_world = world_from_enemy[3];           // translation column
 		glm::vec4 e_clip  = clip_from_world * glm::vec4(e_world, 1.0f);
@@ -430,7 +469,9 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 		if (e_clip.w > 0.0f) {
 			glm::vec3 e_ndc = glm::vec3(e_clip) / e_clip.w; // [-1,1] range
 			// set up 2D line drawer (same as your text HUD uses)
-			glDisable(GL_DEPTH_TEST);
+			// (HUD blocks all draw without depth testing -- it is re-enabled at the start of the next frame,
+			//  so only the first of these gl_state.disable calls reaches OpenGL)
+			gl_state.disable(GL_DEPTH_TEST);
 			float aspect = float(drawable_size.x) / float(drawable_size.y);
 			DrawLines lines(glm::mat4(
 				1.0f / aspect, 0.0f, 0.0f, 0.0f,
@@ -458,11 +499,10 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 				glm::vec3(0.0f, H, 0.0f),
 				col
 			);
-			glEnable(GL_DEPTH_TEST);
 		}
 	}
 	if (focus_mode && enemy) {
-		glDisable(GL_DEPTH_TEST);
+		gl_state.disable(GL_DEPTH_TEST);
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
 		DrawLines lines(glm::mat4(
 			1.0f / aspect, 0.0f, 0.0f, 0.0f,
@@ -513,12 +553,10 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 			glm::vec3(0.0f, H, 0.0f),
 			outline
 		);
-
-		glEnable(GL_DEPTH_TEST);
 	}
 	
 	if (being_watched) {
-		glDisable(GL_DEPTH_TEST);
+		gl_state.disable(GL_DEPTH_TEST);
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
 		DrawLines lines(glm::mat4(
 			1.0f / aspect, 0.0f, 0.0f, 0.0f,
@@ -535,11 +573,10 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 			glm::vec3(0.0f, H, 0.0f),         // y step
 			warn
 		);
-		glEnable(GL_DEPTH_TEST);
 	}
 	
 	if (game_over) {
-		glDisable(GL_DEPTH_TEST);
+		gl_state.disable(GL_DEPTH_TEST);
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
 		DrawLines lines(glm::mat4(
 			1.0f / aspect, 0.0f, 0.0f, 0.0f,
@@ -555,10 +592,9 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 			glm::vec3(0.0f, H, 0.0f),
 			color
 		);
-		glEnable(GL_DEPTH_TEST);
 	}
 	{ //use DrawLines to overlay some text:
-		glDisable(GL_DEPTH_TEST);
+		gl_state.disable(GL_DEPTH_TEST);
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
 		DrawLines lines(glm::mat4(
 			1.0f / aspect, 0.0f, 0.0f, 0.0f,
@@ -578,5 +614,7 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
 			glm::u8vec4(0xff, 0xff, 0xff, 0x00));
 	}
+
+	scene.restore_transforms();
 	GL_ERRORS();
 }
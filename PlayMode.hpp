@@ -3,11 +3,16 @@
 #include "Scene.hpp"
 #include "Sound.hpp"
 #include "Camera.hpp"
+#include "OcclusionQueries.hpp"
+#include "RayCaster.hpp"
+#include "Agents.hpp"
+#include "NavMesh.hpp"
 
 #include <glm/glm.hpp>
 
 #include <vector>
 #include <deque>
+#include <memory>
 
 struct PlayMode : Mode {
 	PlayMode();
@@ -26,6 +31,11 @@ struct PlayMode : Mode {
 		uint8_t pressed = 0;
 	} left, right, down, up;
 
+	//mouse look is on once a click has asked for relative mouse mode (and off again after escape):
+	// (input is gated on this rather than on the window's current mode, so replayed input behaves as recorded
+	//  even if the replay's window doesn't grant relative mode)
+	bool mouse_look = false;
+
 	//local copy of the game scene (so code can change it during gameplay):
 	Scene scene;
 
@@ -50,24 +60,30 @@ struct PlayMode : Mode {
 	float stalk_decay_rate = 0.025f;    // drains when not holding
 	bool  stalking = false;           // true while RMB is held
 	bool enemy_visible = true; // updated in draw(), used in next update()
-	// --- enemy patrol ---
-	std::vector<glm::vec3> enemy_waypoints;
-	size_t enemy_wp_idx = 0;
-	float enemy_speed = 6.0f;           // units/sec
-	float enemy_wait_timer = 0.0f;      // seconds left to wait at a waypoint
-	float enemy_wait_at_point = 0.4f;   // pause duration
-	float enemy_reach_epsilon = 0.15f;  // how close counts as "arrived"
-	glm::quat enemy_base_rotation;      // remember original facing
-	// Enemy vision
-	bool  being_watched = false;   // updated in update(), read in draw()
-	bool  watched_latched = false;
-	float enemy_view_distance = 10.0f;  // max detection range (units)
-	float enemy_fov_deg = 70.0f;        // vision cone (full angle)
-	float watched_grace = 0.15f;      // seconds
-	float watched_grace_timer = 0.0f; // countdown
+	float enemy_visibility = 1.0f; // fraction of the enemy's bounding box in view (updated with enemy_visible)
+	OcclusionQueries occlusion;        // measures enemy_visibility
+	uint32_t enemy_occlusion = -1U;    // enemy's id in 'occlusion'
+	// --- enemies (patrol, and watch for the player) ---
+	Agents agents;
+	uint32_t enemy_agent = -1U;       // enemy's index in 'agents'
+	bool  being_watched = false;      // updated in update(), read in draw()
+	std::unique_ptr< RayCaster > line_of_sight;     // scene triangles, for agents' line-of-sight tests
+	std::vector< uint8_t > line_of_sight_ignored;   // per drawable: part of an agent or the player?
+	glm::vec3 player_center = glm::vec3(0.0f);      // (player-local) what the agents look at
+	// patrol routes follow the navigation mesh (agents walk straight between stops until paths arrive):
+	struct Patrol {
+		uint32_t agent;                          // index in 'agents'
+		std::vector< glm::vec3 > stops;          // visited in a loop, pausing at each
+		std::vector< uint32_t > tickets;         // path request per leg (stops[k] -> stops[k+1]); 0 once answered
+		std::vector< std::vector< glm::vec3 > > legs;
+	};
+	std::vector< Patrol > patrols;
+	std::unique_ptr< NavMesh::Requests > path_requests;
+	void update_patrols();                   // hands finished paths to 'agents'
 	//game over set
-	float watched_accum = 0.0f;          // continuous time (seconds) currently being watched
-	float watch_to_gameover = 5.0f;      // threshold (seconds)
+	// TODO: nothing calls trigger_game_over() yet; ending the game once agents.longest_watch reaches
+	//  watch_to_gameover is a gameplay change of its own (it's on the backlog), not part of the agent update
+	float watch_to_gameover = 5.0f;      // threshold (seconds) of continuous watching by any agent
 	bool  game_over = false;             // simple game-over latch
 
 	void trigger_game_over();            // declare handler
@@ -0,0 +1,299 @@
+#include "Profiler.hpp"
+
+#include "DrawLines.hpp"
+#include "GLState.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+Profiler &Profiler::get() {
+	static Profiler *profiler = new Profiler(); //(intentionally never deleted -- see header)
+	return *profiler;
+}
+
+Profiler::Profiler() : epoch(std::chrono::steady_clock::now()) {
+}
+
+//--- CPU scopes ---
+
+Profiler::Ring &Profiler::ring() {
+	static thread_local Ring *mine = nullptr;
+	if (!mine) {
+		Profiler &profiler = get();
+		std::unique_lock< std::mutex > lock(profiler.rings_mutex);
+		profiler.rings.emplace_back(std::make_unique< Ring >());
+		mine = profiler.rings.back().get();
+		mine->lane = uint32_t(profiler.rings.size() - 1);
+	}
+	return *mine;
+}
+
+void Profiler::name_thread(char const *name) {
+	ring().name.store(name, std::memory_order_relaxed);
+}
+
+void Profiler::Ring::push(Entry const &entry) {
+	uint64_t w = written.load(std::memory_order_relaxed);
+	if (w - read.load(std::memory_order_acquire) >= Capacity) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	entries[w % Capacity] = entry;
+	written.store(w + 1, std::memory_order_release);
+}
+
+void Profiler::next_frame() {
+	frame.begin = frame.end;
+	frame.end = now();
+	frame.scopes.clear();
+	frame.counters.clear();
+	frame.dropped = 0;
+
+	{ //drain every thread's ring:
+		std::unique_lock< std::mutex > lock(rings_mutex);
+		lanes.resize(rings.size());
+		for (auto const &ring : rings) {
+			uint64_t w = ring->written.load(std::memory_order_acquire);
+			uint64_t r = ring->read.load(std::memory_order_relaxed);
+			for (; r < w; ++r) {
+				Ring::Entry const &entry = ring->entries[r % Ring::Capacity];
+				if (entry.depth == Ring::CounterDepth) {
+					frame.counters.emplace_back(Counter{entry.name, entry.begin, entry.value, ring->lane});
+				} else {
+					frame.scopes.emplace_back(Scope{entry.name, entry.begin, entry.end, entry.depth, ring->lane});
+				}
+			}
+			ring->read.store(w, std::memory_order_release);
+			frame.dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+
+			char const *name = ring->name.load(std::memory_order_relaxed);
+			lanes[ring->lane].name = (name ? name : "thread");
+		}
+	}
+	std::sort(frame.scopes.begin(), frame.scopes.end(), [](Scope const &a, Scope const &b) {
+		if (a.lane != b.lane) return a.lane < b.lane;
+		return a.begin < b.begin;
+	});
+
+	cpu_history.emplace_back(float(frame.end - frame.begin) * 1e-6f);
+	if (cpu_history.size() > History) cpu_history.erase(cpu_history.begin());
+
+	//--- GPU scopes ---
+
+	assert(gpu_depth == 0 && "GPU scopes should not span frames");
+	frame.gpu_new = false;
+	if (gpu_recording && !gpu_frames[gpu_frame].scopes.empty()) {
+		gpu_frames[gpu_frame].pending = true;
+		//(the GL clock runs on its own -- sample both clocks together to line GPU scopes up with CPU ones)
+		GLint64 gpu_now = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+		frame.gpu_to_cpu = int64_t(now()) - int64_t(gpu_now);
+	}
+	gpu_frame = (gpu_frame + 1) % GPUFrames;
+
+	//collect oldest to newest, so 'frame' ends up with the newest results:
+	for (uint32_t k = 0; k < GPUFrames; ++k) {
+		GPUFrame &slot = gpu_frames[(gpu_frame + k) % GPUFrames];
+		if (slot.pending && collect(slot)) {
+			gpu_history.emplace_back(float(frame.gpu_end - frame.gpu_begin) * 1e-6f);
+			if (gpu_history.size() > History) gpu_history.erase(gpu_history.begin());
+		}
+	}
+
+	//the GPU is a whole ring of frames behind -- skip GPU scopes for this frame rather than stall:
+	GPUFrame &next = gpu_frames[gpu_frame];
+	gpu_recording = !next.pending;
+	if (gpu_recording) {
+		next.scopes.clear();
+		next.used = 0;
+	}
+}
+
+//--- GPU scopes ---
+
+uint32_t Profiler::begin_gpu_scope(char const *name) {
+	if (!gpu_recording) return -1U;
+	GPUFrame &slot = gpu_frames[gpu_frame];
+	if (slot.scopes.size() >= MaxGPUScopes) return -1U;
+
+	if (slot.used + 2 > slot.pool.size()) {
+		size_t old_size = slot.pool.size();
+		slot.pool.resize(std::max< size_t >(16, old_size * 2));
+		glGenQueries(GLsizei(slot.pool.size() - old_size), slot.pool.data() + old_size);
+	}
+	GPUScope scope;
+	scope.name = name;
+	scope.depth = gpu_depth++;
+	scope.begin_query = slot.pool[slot.used++];
+	scope.end_query = slot.pool[slot.used++];
+	glQueryCounter(scope.begin_query, GL_TIMESTAMP);
+	slot.scopes.emplace_back(scope);
+	return uint32_t(slot.scopes.size() - 1);
+}
+
+void Profiler::end_gpu_scope(uint32_t index) {
+	if (index == -1U) return;
+	assert(gpu_recording && index < gpu_frames[gpu_frame].scopes.size());
+	gpu_depth -= 1;
+	glQueryCounter(gpu_frames[gpu_frame].scopes[index].end_query, GL_TIMESTAMP);
+}
+
+bool Profiler::collect(GPUFrame &slot) {
+	assert(slot.pending);
+
+	//don't wait on the GPU -- if anything is outstanding, try again next frame:
+	for (GPUScope const &scope : slot.scopes) {
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(scope.end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return false;
+	}
+
+	frame.gpu_scopes.clear();
+	frame.gpu_begin = -1ULL;
+	frame.gpu_end = 0;
+	for (GPUScope const &scope : slot.scopes) {
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(scope.begin_query, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(scope.end_query, GL_QUERY_RESULT, &end);
+		frame.gpu_scopes.emplace_back(Scope{scope.name, begin, std::max(begin, end), scope.depth, GPULane});
+		frame.gpu_begin = std::min(frame.gpu_begin, uint64_t(begin));
+		frame.gpu_end = std::max(frame.gpu_end, uint64_t(end));
+	}
+	if (frame.gpu_scopes.empty()) frame.gpu_begin = 0;
+	frame.gpu_new = true;
+	slot.pending = false;
+	GL_ERRORS();
+	return true;
+}
+
+//--- overlay ---
+
+void Profiler::draw_overlay(glm::uvec2 const &drawable_size) const {
+	if (drawable_size.x == 0 || drawable_size.y == 0) return;
+	gl_state.disable(GL_DEPTH_TEST);
+
+	//draw in pixels, origin at the lower left:
+	DrawLines lines(glm::mat4(
+		2.0f / float(drawable_size.x), 0.0f, 0.0f, 0.0f,
+		0.0f, 2.0f / float(drawable_size.y), 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		-1.0f, -1.0f, 0.0f, 1.0f
+	));
+
+	constexpr float Margin = 10.0f;
+	constexpr float Text = 11.0f; //text height
+	constexpr float Row = 14.0f; //height of one nesting level of bars
+	constexpr float LabelWidth = 90.0f; //lane names, left of the bars
+	float const left = Margin;
+	float const width = std::min(float(drawable_size.x) - 2.0f * Margin, 900.0f);
+	float const bars_left = left + LabelWidth;
+	float const bars_width = std::max(1.0f, width - LabelWidth);
+	float y = float(drawable_size.y) - Margin; //top of the next row
+
+	glm::u8vec4 const white(0xff, 0xff, 0xff, 0xff);
+	glm::u8vec4 const gray(0x80, 0x80, 0x80, 0xff);
+	glm::u8vec4 const green(0x40, 0xff, 0x60, 0xff);
+
+	auto text = [&](std::string const &str, float x, float baseline, glm::u8vec4 const &color) {
+		lines.draw_text(str, glm::vec3(x, baseline, 0.0f), glm::vec3(Text, 0.0f, 0.0f), glm::vec3(0.0f, Text, 0.0f), color);
+	};
+	auto box = [&](float x0, float y0, float x1, float y1, glm::u8vec4 const &color) {
+		lines.draw(glm::vec3(x0, y0, 0.0f), glm::vec3(x1, y0, 0.0f), color);
+		lines.draw(glm::vec3(x1, y0, 0.0f), glm::vec3(x1, y1, 0.0f), color);
+		lines.draw(glm::vec3(x1, y1, 0.0f), glm::vec3(x0, y1, 0.0f), color);
+		lines.draw(glm::vec3(x0, y1, 0.0f), glm::vec3(x0, y0, 0.0f), color);
+	};
+	//a stable, fairly bright color per scope name:
+	auto color_of = [](char const *name) {
+		uint32_t hash = 2166136261u;
+		for (char const *c = name; *c; ++c) hash = (hash ^ uint8_t(*c)) * 16777619u;
+		return glm::u8vec4(0x60 + (hash & 0x9f), 0x60 + ((hash >> 8) & 0x9f), 0x60 + ((hash >> 16) & 0x9f), 0xff);
+	};
+
+	float frame_ms = float(frame.end - frame.begin) * 1e-6f;
+	{ //summary line:
+		char buffer[128];
+		std::snprintf(buffer, sizeof(buffer), "frame %.2f ms   gpu %.2f ms   scopes %u   dropped %u",
+			frame_ms, float(frame.gpu_end - frame.gpu_begin) * 1e-6f, uint32_t(frame.scopes.size()), frame.dropped);
+		y -= Text;
+		text(buffer, left, y, white);
+		y -= 0.5f * Text;
+
+		//latest value of each counter:
+		std::string values;
+		for (uint32_t c = 0; c < frame.counters.size(); ++c) {
+			bool later = false;
+			for (uint32_t d = c + 1; d < frame.counters.size(); ++d) {
+				if (frame.counters[d].name == frame.counters[c].name) later = true;
+			}
+			if (later) continue;
+			std::snprintf(buffer, sizeof(buffer), "%s%s %g", (values.empty() ? "" : "   "), frame.counters[c].name, frame.counters[c].value);
+			values += buffer;
+		}
+		if (!values.empty()) {
+			y -= Text;
+			text(values, left, y, gray);
+			y -= 0.5f * Text;
+		}
+	}
+
+	//one lane of bars, with time 'origin' at the left edge and the frame's length across:
+	uint64_t span = std::max< uint64_t >(1, frame.end - frame.begin);
+	auto lane = [&](char const *name, std::vector< Scope > const &scopes, uint32_t lane_index, uint64_t origin) {
+		uint32_t depths = 0;
+		for (Scope const &scope : scopes) {
+			if (scope.lane == lane_index) depths = std::max(depths, scope.depth + 1);
+		}
+		if (depths == 0) return;
+
+		text(name, left, y - Text, gray);
+		for (Scope const &scope : scopes) {
+			if (scope.lane != lane_index) continue;
+			//(scopes that started before the frame are clipped to its start)
+			float t0 = float(int64_t(scope.begin - origin)) / float(span);
+			float t1 = float(int64_t(scope.end - origin)) / float(span);
+			t0 = std::clamp(t0, 0.0f, 1.0f);
+			t1 = std::clamp(t1, t0, 1.0f);
+			float x0 = bars_left + t0 * bars_width;
+			float x1 = std::max(x0 + 1.0f, bars_left + t1 * bars_width);
+			float top = y - float(scope.depth) * Row;
+			float bottom = top - Row + 2.0f;
+			glm::u8vec4 color = color_of(scope.name);
+			box(x0, bottom, x1, top, color);
+			//(names go inside bars wide enough to hold them)
+			std::string label = scope.name;
+			if (x1 - x0 > float(label.size()) * 0.6f * Text + 4.0f) text(label, x0 + 2.0f, bottom + 2.0f, color);
+		}
+		y -= float(depths) * Row + 0.5f * Row;
+	};
+	for (uint32_t l = 0; l < lanes.size(); ++l) {
+		lane(lanes[l].name, frame.scopes, l, frame.begin);
+	}
+	lane("GPU", frame.gpu_scopes, GPULane, frame.gpu_begin);
+
+	{ //frame time graph (0 to 33ms, with a line at 16.7ms):
+		constexpr float Height = 80.0f;
+		constexpr float MaxMs = 1000.0f / 30.0f;
+		float bottom = y - Height;
+		box(bars_left, bottom, bars_left + bars_width, y, gray);
+		lines.draw(glm::vec3(bars_left, bottom + 0.5f * Height, 0.0f), glm::vec3(bars_left + bars_width, bottom + 0.5f * Height, 0.0f), gray);
+		text("33ms", left, y - Text, gray);
+		text("17ms", left, bottom + 0.5f * Height - 0.5f * Text, gray);
+		text("cpu", left, bottom + 2.0f * Text, white);
+		text("gpu", left, bottom + 0.5f * Text, green);
+
+		auto graph = [&](std::vector< float > const &history, glm::u8vec4 const &color) {
+			for (uint32_t i = 1; i < history.size(); ++i) {
+				//(newest at the right edge)
+				float x0 = bars_left + bars_width * float(History - history.size() + i - 1) / float(History - 1);
+				float x1 = bars_left + bars_width * float(History - history.size() + i) / float(History - 1);
+				float y0 = bottom + Height * std::min(1.0f, history[i - 1] / MaxMs);
+				float y1 = bottom + Height * std::min(1.0f, history[i] / MaxMs);
+				lines.draw(glm::vec3(x0, y0, 0.0f), glm::vec3(x1, y1, 0.0f), color);
+			}
+		};
+		graph(cpu_history, white);
+		graph(gpu_history, green);
+	}
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+/*
+ * Profiler records where frames go -- nested, named CPU scopes on every thread, and GPU scopes on the GL thread --
+ * and shows the most recent frame as an overlay:
+ *
+ * void Scene::draw(...) {
+ *     PROFILE_SCOPE("Scene::draw"); //CPU time until the end of the enclosing block
+ *     PROFILE_GPU_SCOPE("Scene::draw"); //GPU time of the GL commands issued until the end of the block
+ *     ...
+ * }
+ *
+ * //once per frame (main loops do this after swapping buffers):
+ * Profiler::get().next_frame();
+ * //...and, to show the overlay, after drawing:
+ * Profiler::get().draw_overlay(drawable_size);
+ *
+ * //values worth watching over time (from any thread):
+ * PROFILE_COUNTER("draw calls", counters.draws);
+ *
+ * Scope and counter names must be string literals (or otherwise live forever) -- only the pointer is kept.
+ *
+ * Each thread writes finished scopes into a ring buffer of its own, with no locks; next_frame() (on the main thread)
+ * drains every ring into 'frame', the timeline of the frame that just ended. When a ring is full, scopes are dropped
+ * (and counted) rather than blocking the thread that ran them.
+ *
+ * GPU scopes are timestamp queries (glQueryCounter(GL_TIMESTAMP) at each end, so they can nest -- GL_TIME_ELAPSED
+ * queries can't). Results are read back a few frames later, once available, without waiting on the GPU;
+ * frames whose queries are still in flight when their slot is needed again are skipped.
+ *
+ * Compile with PROFILER_ENABLED=0 to remove all scopes (the overlay then stays empty).
+ *
+ */
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct Profiler {
+	//the profiler every scope records into (created on first use, and never destroyed -- so threads
+	// still running during shutdown can keep recording):
+	static Profiler &get();
+
+	Profiler();
+
+	Profiler(Profiler const &) = delete;
+	Profiler &operator=(Profiler const &) = delete;
+
+	//nanoseconds since the profiler started:
+	uint64_t now() const {
+		return uint64_t(std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - epoch).count());
+	}
+
+	//label the calling thread in the overlay (name must live forever):
+	static void name_thread(char const *name);
+
+	//finish the current frame: collect CPU scopes and any GPU results that have arrived (call on the GL thread):
+	void next_frame();
+
+	//draw 'frame' as bars (one lane per thread, plus one for the GPU) and a graph of recent frame times:
+	void draw_overlay(glm::uvec2 const &drawable_size) const;
+	bool show_overlay = false; //(main.cpp toggles this with F3)
+
+	//--- results ---
+
+	struct Scope {
+		char const *name;
+		uint64_t begin, end; //nanoseconds; CPU scopes use now(), GPU scopes use GL timestamps
+		uint32_t depth; //nesting level (0 = outermost)
+		uint32_t lane; //thread index into 'lanes' (or GPULane)
+	};
+	enum : uint32_t { GPULane = -1U };
+
+	struct Counter {
+		char const *name;
+		uint64_t time; //now() when recorded
+		double value;
+		uint32_t lane;
+	};
+
+	struct Frame {
+		uint64_t begin = 0, end = 0; //now() at the previous and current next_frame()
+		std::vector< Scope > scopes; //CPU scopes that ended during the frame
+		std::vector< Counter > counters; //counter values recorded during the frame
+		//GPU scopes of an earlier frame (the most recent one whose results are in):
+		std::vector< Scope > gpu_scopes;
+		uint64_t gpu_begin = 0, gpu_end = 0; //earliest and latest GPU timestamps in gpu_scopes
+		bool gpu_new = false; //gpu_scopes arrived during this next_frame()
+		int64_t gpu_to_cpu = 0; //add to a GPU timestamp to get (roughly) the now() it happened at
+		uint32_t dropped = 0; //CPU scopes and counters lost to full rings since the last frame
+	};
+	Frame frame; //the last finished frame
+
+	//recent frame times (milliseconds; newest last):
+	enum : uint32_t { History = 240 };
+	std::vector< float > cpu_history, gpu_history;
+
+	struct Lane {
+		char const *name;
+	};
+	std::vector< Lane > lanes; //per thread that has recorded a scope (in order of first scope)
+
+	//--- internals ---
+
+	std::chrono::steady_clock::time_point epoch;
+
+	//per-thread ring of finished scopes and counter values (single writer: the thread; single reader: next_frame()):
+	struct Ring {
+		enum : uint32_t { Capacity = 4096 };
+		enum : uint32_t { CounterDepth = -1U }; //'depth' of counter entries
+		struct Entry {
+			char const *name;
+			uint64_t begin; //(for counters: time recorded)
+			union {
+				uint64_t end; //scopes
+				double value; //counters
+			};
+			uint32_t depth;
+		};
+		Entry entries[Capacity];
+		std::atomic< uint64_t > written{0}; //entries ever pushed (by the thread)
+		std::atomic< uint64_t > read{0}; //entries ever popped (by next_frame)
+		std::atomic< uint32_t > dropped{0};
+		std::atomic< char const * > name{nullptr};
+		uint32_t lane = 0;
+		uint32_t depth = 0; //(only touched by the thread)
+
+		void push(Entry const &entry);
+	};
+	//(rings outlive their threads, so a thread that exits leaves its last scopes to be collected)
+	std::mutex rings_mutex; //(only held when a thread records its first scope, and by next_frame)
+	std::vector< std::unique_ptr< Ring > > rings;
+	static Ring &ring(); //calling thread's ring
+
+	//GPU timestamp queries, in flight for a few frames:
+	struct GPUScope {
+		char const *name;
+		uint32_t depth;
+		GLuint begin_query, end_query;
+	};
+	struct GPUFrame {
+		bool pending = false;
+		std::vector< GPUScope > scopes;
+		std::vector< GLuint > pool; //query objects owned by this slot
+		uint32_t used = 0; //queries of 'pool' used this frame
+	};
+	enum : uint32_t { GPUFrames = 4 };
+	enum : uint32_t { MaxGPUScopes = 1024 }; //per frame (further scopes are skipped)
+	GPUFrame gpu_frames[GPUFrames];
+	uint32_t gpu_frame = 0; //slot being recorded
+	bool gpu_recording = true; //false when this frame's slot was still pending (so GPU scopes are skipped)
+	uint32_t gpu_depth = 0;
+
+	uint32_t begin_gpu_scope(char const *name); //returns index in the slot's scopes (or -1U if skipped)
+	void end_gpu_scope(uint32_t index);
+	bool collect(GPUFrame &slot); //read results if they are all available
+
+	//RAII helpers behind the macros:
+	struct CPUTimer {
+		CPUTimer(char const *name_) : name(name_), ring(Profiler::ring()), begin(Profiler::get().now()) { ring.depth += 1; }
+		~CPUTimer() {
+			ring.depth -= 1;
+			ring.push(Ring::Entry{name, begin, Profiler::get().now(), ring.depth});
+		}
+		char const *name;
+		Ring &ring;
+		uint64_t begin;
+	};
+	static void counter(char const *name, double value) {
+		Ring::Entry entry;
+		entry.name = name;
+		entry.begin = Profiler::get().now();
+		entry.value = value;
+		entry.depth = Ring::CounterDepth;
+		Profiler::ring().push(entry);
+	}
+	struct GPUTimer {
+		GPUTimer(char const *name) : index(Profiler::get().begin_gpu_scope(name)) { }
+		~GPUTimer() { Profiler::get().end_gpu_scope(index); }
+		uint32_t index;
+	};
+};
+
+#define PROFILER_CONCAT2(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT2(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) Profiler::CPUTimer PROFILER_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) Profiler::GPUTimer PROFILER_CONCAT(profile_gpu_scope_, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::counter(name, double(value))
+#else
+#define PROFILE_SCOPE(name) do { } while (0)
+#define PROFILE_GPU_SCOPE(name) do { } while (0)
+#define PROFILE_COUNTER(name, value) do { } while (0)
+#endif
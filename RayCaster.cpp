@@ -0,0 +1,268 @@
+#include "RayCaster.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAYCASTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+//four rays, structure-of-arrays:
+struct alignas(16) Packet {
+	float ox[4], oy[4], oz[4]; //origins
+	float dx[4], dy[4], dz[4]; //directions
+	float ix[4], iy[4], iz[4]; //1 / direction (infinite for zero components)
+	float t_min[4], t_max[4];
+};
+
+//lane i of 'packet' set from a ray:
+static void set_lane(Packet &packet, uint32_t i, glm::vec3 const &from, glm::vec3 const &dir, float t_min, float t_max) {
+	packet.ox[i] = from.x; packet.oy[i] = from.y; packet.oz[i] = from.z;
+	packet.dx[i] = dir.x; packet.dy[i] = dir.y; packet.dz[i] = dir.z;
+	packet.ix[i] = 1.0f / dir.x; packet.iy[i] = 1.0f / dir.y; packet.iz[i] = 1.0f / dir.z;
+	packet.t_min[i] = t_min; packet.t_max[i] = t_max;
+}
+
+//bit i set if ray i hits the box [min,max] within [t_min,t_max]:
+// (written so that NaNs -- from 0 * infinity on a slab boundary -- count as misses, as in BVH::for_each_on_ray)
+static uint32_t box_mask(Packet const &p, glm::vec3 const &min, glm::vec3 const &max) {
+#ifdef RAYCASTER_SSE
+	auto slab = [](__m128 o, __m128 inv, float lo, float hi, __m128 &t_near, __m128 &t_far) {
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(lo), o), inv);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hi), o), inv);
+		t_near = _mm_max_ps(t_near, _mm_min_ps(t0, t1));
+		t_far = _mm_min_ps(t_far, _mm_max_ps(t0, t1));
+	};
+	__m128 t_near = _mm_load_ps(p.t_min);
+	__m128 t_far = _mm_load_ps(p.t_max);
+	slab(_mm_load_ps(p.ox), _mm_load_ps(p.ix), min.x, max.x, t_near, t_far);
+	slab(_mm_load_ps(p.oy), _mm_load_ps(p.iy), min.y, max.y, t_near, t_far);
+	slab(_mm_load_ps(p.oz), _mm_load_ps(p.iz), min.z, max.z, t_near, t_far);
+	return uint32_t(_mm_movemask_ps(_mm_cmple_ps(t_near, t_far)));
+#else
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < 4; ++i) {
+		float t_near = p.t_min[i], t_far = p.t_max[i];
+		auto slab = [&](float o, float inv, float lo, float hi) {
+			float t0 = (lo - o) * inv, t1 = (hi - o) * inv;
+			t_near = std::max(t_near, std::min(t0, t1));
+			t_far = std::min(t_far, std::max(t0, t1));
+		};
+		slab(p.ox[i], p.ix[i], min.x, max.x);
+		slab(p.oy[i], p.iy[i], min.y, max.y);
+		slab(p.oz[i], p.iz[i], min.z, max.z);
+		if (t_near <= t_far) mask |= (1u << i);
+	}
+	return mask;
+#endif
+}
+
+//bit i set if ray i crosses the triangle (v0, v0 + e1, v0 + e2) within (t_min,t_max) (Moller-Trumbore):
+static uint32_t triangle_mask(Packet const &p, glm::vec3 const &v0, glm::vec3 const &e1, glm::vec3 const &e2) {
+	constexpr float DetEpsilon = 1e-12f; //(rays in the plane of the triangle miss)
+#ifdef RAYCASTER_SSE
+	__m128 dx = _mm_load_ps(p.dx), dy = _mm_load_ps(p.dy), dz = _mm_load_ps(p.dz);
+	__m128 e1x = _mm_set1_ps(e1.x), e1y = _mm_set1_ps(e1.y), e1z = _mm_set1_ps(e1.z);
+	__m128 e2x = _mm_set1_ps(e2.x), e2y = _mm_set1_ps(e2.y), e2z = _mm_set1_ps(e2.z);
+
+	//pvec = dir x e2:
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+	__m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	//s = from - v0:
+	__m128 sx = _mm_sub_ps(_mm_load_ps(p.ox), _mm_set1_ps(v0.x));
+	__m128 sy = _mm_sub_ps(_mm_load_ps(p.oy), _mm_set1_ps(v0.y));
+	__m128 sz = _mm_sub_ps(_mm_load_ps(p.oz), _mm_set1_ps(v0.z));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv_det);
+
+	//qvec = s x e1:
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 hit = _mm_cmpgt_ps(abs_det, _mm_set1_ps(DetEpsilon));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, _mm_load_ps(p.t_min)));
+	hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_load_ps(p.t_max)));
+	return uint32_t(_mm_movemask_ps(hit));
+#else
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < 4; ++i) {
+		glm::vec3 dir(p.dx[i], p.dy[i], p.dz[i]);
+		glm::vec3 pvec = glm::cross(dir, e2);
+		float det = glm::dot(e1, pvec);
+		if (!(std::abs(det) > DetEpsilon)) continue;
+		float inv_det = 1.0f / det;
+		glm::vec3 s = glm::vec3(p.ox[i], p.oy[i], p.oz[i]) - v0;
+		float u = glm::dot(s, pvec) * inv_det;
+		glm::vec3 qvec = glm::cross(s, e1);
+		float v = glm::dot(dir, qvec) * inv_det;
+		float t = glm::dot(e2, qvec) * inv_det;
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > p.t_min[i] && t < p.t_max[i]) mask |= (1u << i);
+	}
+	return mask;
+#endif
+}
+
+//visit the leaves of 'bvh' that rays in 'active' hit:
+// leaf(position, mask) is called for each position in bvh.order whose box rays 'mask' hit, and returns the rays it resolved;
+// returns the rays left unresolved (all of them if the budget ran out)
+template< typename F >
+static uint32_t traverse(BVH const &bvh, Packet const &packet, uint32_t active, uint32_t &budget, uint32_t &visited, F &&leaf) {
+	if (bvh.nodes.empty() || active == 0) return active;
+	uint32_t stack[64];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		if (budget == 0) return active;
+		--budget;
+		visited += 1;
+
+		BVH::Node const &node = bvh.nodes[stack[--top]];
+		uint32_t mask = box_mask(packet, node.min, node.max) & active;
+		if (mask == 0) continue;
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				uint32_t item = bvh.order[i];
+				uint32_t item_mask = (node.count == 1 ? mask : box_mask(packet, bvh.item_min[item], bvh.item_max[item]) & mask);
+				if (item_mask == 0) continue;
+				active &= ~leaf(i, item_mask);
+				if (active == 0) return 0;
+				mask &= active;
+				if (budget == 0) return active;
+			}
+		} else {
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+		}
+	}
+	return active;
+}
+
+RayCaster::RayCaster(Scene const &scene_, MeshBuffer const &buffer, GLuint vao_) : scene(scene_), vao(vao_) {
+	for (auto const &[name, mesh] : buffer.meshes) {
+		if (mesh.type != GL_TRIANGLES) continue;
+		if (mesh_index.count(std::make_pair(mesh.start, mesh.count))) continue; //(same vertices under another name)
+		if (!(mesh.start <= buffer.vertices.size() && mesh.count <= buffer.vertices.size() - mesh.start)) {
+			throw std::runtime_error("mesh '" + name + "' has out-of-range vertex start/count");
+		}
+
+		mesh_index.emplace(std::make_pair(mesh.start, mesh.count), uint32_t(meshes.size()));
+		meshes.emplace_back();
+		MeshTriangles &triangles = meshes.back();
+
+		uint32_t count = mesh.count / 3;
+		MeshBuffer::Vertex const *vertices = buffer.vertices.data() + mesh.start;
+		triangles.bvh.resize(count);
+		for (uint32_t t = 0; t < count; ++t) {
+			glm::vec3 const &a = vertices[3*t+0].Position;
+			glm::vec3 const &b = vertices[3*t+1].Position;
+			glm::vec3 const &c = vertices[3*t+2].Position;
+			triangles.bvh.set(t, glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)));
+		}
+		triangles.bvh.update();
+
+		//store triangles in leaf order, so each leaf's triangles are contiguous:
+		triangles.v0.reserve(triangles.bvh.order.size());
+		triangles.e1.reserve(triangles.bvh.order.size());
+		triangles.e2.reserve(triangles.bvh.order.size());
+		for (uint32_t t : triangles.bvh.order) {
+			glm::vec3 const &a = vertices[3*t+0].Position;
+			triangles.v0.emplace_back(a);
+			triangles.e1.emplace_back(vertices[3*t+1].Position - a);
+			triangles.e2.emplace_back(vertices[3*t+2].Position - a);
+		}
+	}
+}
+
+void RayCaster::update_drawable_mesh() const {
+	//(a linear pass, like the drawable_bvh update each query already does -- so replaced drawables and
+	//  reassigned pipelines are noticed even when the number of drawables stays the same)
+	bool resized = (drawable_mesh.size() != scene.drawables.size());
+	drawable_mesh.resize(scene.drawables.size());
+	for (uint32_t d = 0; d < scene.drawables.size(); ++d) {
+		Scene::Drawable::Pipeline const &pipeline = scene.drawables[d].pipeline;
+		DrawableMesh &entry = drawable_mesh[d];
+		if (!resized && entry.vao == pipeline.vao && entry.type == pipeline.type && entry.start == pipeline.start && entry.count == pipeline.count) continue;
+		entry.vao = pipeline.vao;
+		entry.type = pipeline.type;
+		entry.start = pipeline.start;
+		entry.count = pipeline.count;
+		entry.mesh = -1U;
+		if (pipeline.vao != vao || pipeline.type != GL_TRIANGLES) continue;
+		auto f = mesh_index.find(std::make_pair(pipeline.start, pipeline.count));
+		if (f != mesh_index.end()) entry.mesh = f->second;
+	}
+}
+
+void RayCaster::occluded(size_t count, Ray const *rays, uint8_t *results, Ignore const &ignore) const {
+	scene.update_drawable_bvh();
+	update_drawable_mesh();
+	BVH const &top = scene.drawable_bvh;
+
+	for (size_t begin = 0; begin < count; begin += 4) {
+		uint32_t lanes = uint32_t(std::min< size_t >(4, count - begin));
+		packets += 1;
+
+		//world-space packet (unused lanes repeat the first ray, but are never active):
+		Packet world;
+		for (uint32_t i = 0; i < 4; ++i) {
+			Ray const &ray = rays[begin + (i < lanes ? i : 0)];
+			set_lane(world, i, ray.from, ray.dir, end_epsilon * ray.t_max, (1.0f - end_epsilon) * ray.t_max);
+		}
+		uint32_t active = (1u << lanes) - 1;
+		uint32_t hits = 0;
+
+		uint32_t budget = node_budget;
+		uint32_t visited = 0;
+		uint32_t remaining = traverse(top, world, active, budget, visited, [&](uint32_t position, uint32_t mask) -> uint32_t {
+			uint32_t d = top.order[position];
+			uint32_t m = drawable_mesh[d].mesh;
+			if (m == -1U) return 0;
+			if (ignore && ignore(d)) return 0;
+			MeshTriangles const &triangles = meshes[m];
+
+			//rays in mesh-local space (t is unchanged, since the map is affine):
+			glm::mat4x3 const &local_from_world = scene.drawables[d].transform->make_local_from_world();
+			Packet local;
+			for (uint32_t i = 0; i < 4; ++i) {
+				glm::vec3 from = local_from_world * glm::vec4(world.ox[i], world.oy[i], world.oz[i], 1.0f);
+				glm::vec3 dir = local_from_world * glm::vec4(world.dx[i], world.dy[i], world.dz[i], 0.0f);
+				set_lane(local, i, from, dir, world.t_min[i], world.t_max[i]);
+			}
+
+			uint32_t local_hits = 0;
+			traverse(triangles.bvh, local, mask, budget, visited, [&](uint32_t t, uint32_t tri_mask) -> uint32_t {
+				triangles_tested += 1;
+				uint32_t hit = triangle_mask(local, triangles.v0[t], triangles.e1[t], triangles.e2[t]) & tri_mask;
+				local_hits |= hit;
+				return hit;
+			});
+			hits |= local_hits;
+			return local_hits;
+		});
+		nodes_visited += visited;
+
+		//out of budget -- report rays that weren't resolved as occluded:
+		if (budget == 0 && remaining != 0) {
+			budget_exceeded += 1;
+			hits |= remaining;
+		}
+
+		for (uint32_t i = 0; i < lanes; ++i) {
+			results[begin + i] = ((hits >> i) & 1) ? 1 : 0;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+/*
+ * RayCaster answers "is anything in the way?" queries against the triangles of a scene's meshes,
+ * on the CPU (e.g., for line-of-sight checks):
+ *
+ * RayCaster caster(scene, *meshes, meshes_vao);
+ * bool blocked = caster.occluded(from, to);
+ *
+ * //or many at once:
+ * caster.occluded(rays.size(), rays.data(), results.data());
+ *
+ * It keeps a triangle store for every GL_TRIANGLES mesh in 'meshes' (a BVH per mesh, in mesh-local space).
+ * Scene::drawable_bvh is the top level: drawables that draw one of those meshes through 'vao' are
+ * tested against its triangles (other drawables are ignored).
+ *
+ * Rays are traced in packets of four, sharing one traversal of both levels of BVH;
+ * with SSE, each box and triangle test handles all four rays at once.
+ *
+ */
+
+#include "Scene.hpp"
+#include "Mesh.hpp"
+#include "BVH.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+struct RayCaster {
+	//scene: where the drawables are (queries read it -- and update its drawable_bvh -- so it must outlive the caster)
+	//meshes, vao: triangles come from meshes in 'meshes', for drawables whose pipeline.vao is 'vao'
+	RayCaster(Scene const &scene, MeshBuffer const &meshes, GLuint vao);
+
+	//points from + t * dir for t in [0, t_max]:
+	struct Ray {
+		glm::vec3 from = glm::vec3(0.0f);
+		glm::vec3 dir = glm::vec3(0.0f, 0.0f, 1.0f);
+		float t_max = 1.0f;
+	};
+	//the segment from 'from' to 'to':
+	static Ray segment(glm::vec3 const &from, glm::vec3 const &to) {
+		Ray ray;
+		ray.from = from;
+		ray.dir = to - from;
+		ray.t_max = 1.0f;
+		return ray;
+	}
+
+	//(optional) return true to make a drawable (by index in scene.drawables) transparent to rays:
+	using Ignore = std::function< bool(uint32_t drawable) >;
+
+	//results[i] = 1 if any triangle crosses rays[i] (away from its very ends), 0 otherwise:
+	void occluded(size_t count, Ray const *rays, uint8_t *results, Ignore const &ignore = nullptr) const;
+	bool occluded(glm::vec3 const &from, glm::vec3 const &to, Ignore const &ignore = nullptr) const {
+		Ray ray = segment(from, to);
+		uint8_t result = 0;
+		occluded(1, &ray, &result, ignore);
+		return result != 0;
+	}
+
+	//bound the work per packet of (up to four) rays, in BVH nodes visited at both levels:
+	// rays still unresolved when the budget runs out are reported as occluded
+	uint32_t node_budget = 2048;
+
+	//fraction of each ray's length ignored at both ends (so geometry that an endpoint touches doesn't count):
+	float end_epsilon = 1e-3f;
+
+	//running statistics (reset whenever you like):
+	mutable uint32_t packets = 0, nodes_visited = 0, triangles_tested = 0, budget_exceeded = 0;
+
+	//--- internals ---
+
+	Scene const &scene;
+	GLuint vao;
+
+	//triangles of one mesh, in its BVH's leaf order:
+	struct MeshTriangles {
+		BVH bvh; //over triangles, in mesh-local space
+		std::vector< glm::vec3 > v0, e1, e2; //first vertex and the two edges from it, indexed like bvh.order
+	};
+	std::vector< MeshTriangles > meshes;
+	std::map< std::pair< GLuint, GLuint >, uint32_t > mesh_index; //(start, count) -> index in 'meshes'
+
+	//per scene.drawables entry, index in 'meshes' or -1U:
+	// (along with the pipeline fields it was looked up from -- entries whose pipeline changed are looked up again)
+	struct DrawableMesh {
+		GLuint vao = 0;
+		GLenum type = GL_TRIANGLES;
+		GLuint start = 0, count = 0;
+		uint32_t mesh = -1U;
+	};
+	mutable std::vector< DrawableMesh > drawable_mesh;
+	void update_drawable_mesh() const;
+};
@@ -1,15 +1,26 @@
 #include "Scene.hpp"
+#include "TransformKernels.hpp"
+#include "WorkerPool.hpp"
+#include "UniformBlocks.hpp"
+#include "GLState.hpp"
+#include "Load.hpp"
 
 #include "gl_errors.hpp"
 #include "read_write_chunk.hpp"
+#include "Profiler.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
 #include <fstream>
+#include <limits>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
 
 //-------------------------
 
-glm::mat4x3 Scene::Transform::make_parent_from_local() const {
+//builds the parent-from-local matrix for a translation, rotation, and scale:
+static glm::mat4x3 make_parent_from_local(glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
 	//compute:
 	//   translate   *   rotate    *   scale
 	// [ 1 0 0 p.x ]   [       0 ]   [ s.x 0 0 0 ]
@@ -26,6 +37,10 @@ glm::mat4x3 Scene::Transform::make_parent_from_local() const {
 	);
 }
 
+glm::mat4x3 Scene::Transform::make_parent_from_local() const {
+	return ::make_parent_from_local(position, rotation, scale);
+}
+
 glm::mat4x3 Scene::Transform::make_local_from_parent() const {
 	//compute:
 	//   1/scale       *    rot^-1   *  translate^-1
@@ -57,13 +72,19 @@ glm::mat4x3 Scene::Transform::make_local_from_parent() const {
 }
 
 glm::mat4x3 Scene::Transform::make_world_from_local() const {
-	if (!parent) {
-		return make_parent_from_local();
-	} else {
-		return parent->make_world_from_local() * glm::mat4(make_parent_from_local()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
-	}
+	return cache.world_from_local;
 }
 glm::mat4x3 Scene::Transform::make_local_from_world() const {
+	//invert the cached (affine) world matrix -- the inverse of the linear part, then the translation:
+	glm::mat3 linear = glm::mat3(cache.world_from_local);
+	float det = glm::determinant(linear);
+	if (det != 0.0f) {
+		glm::mat3 inv = glm::inverse(linear);
+		return glm::mat4x3(inv[0], inv[1], inv[2], inv * -cache.world_from_local[3]);
+	}
+
+	//degenerate (e.g., some scale is zero) -- compose the parent chain's inverses instead, since make_local_from_parent()
+	// keeps those finite (n.b. this uses current local values, not the ones the cache was computed from):
 	if (!parent) {
 		return make_local_from_parent();
 	} else {
@@ -80,6 +101,453 @@ glm::mat4 Scene::Camera::make_projection() const {
 //-------------------------
 
 
+void Scene::pack_transforms() const {
+	uint32_t count = uint32_t(transforms.size());
+
+	//number transforms in list order and note which ones belong to this scene:
+	std::vector< Transform const * > by_list;
+	by_list.reserve(count);
+	for (auto const &t : transforms) {
+		t.index = uint32_t(by_list.size());
+		by_list.emplace_back(&t);
+	}
+	auto list_index = [&](Transform const *t) -> uint32_t {
+		if (t && t->index < count && by_list[t->index] == t) return t->index;
+		return -1U;
+	};
+
+	//gather children of each transform (compressed: children of i are child_list[child_begin[i]..child_begin[i+1]]):
+	std::vector< uint32_t > child_begin(count + 1, 0);
+	for (auto const *t : by_list) {
+		uint32_t p = list_index(t->parent);
+		if (p != -1U) child_begin[p + 1] += 1;
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		child_begin[i + 1] += child_begin[i];
+	}
+	std::vector< uint32_t > child_list(child_begin[count]);
+	{
+		std::vector< uint32_t > fill(child_begin.begin(), child_begin.end() - 1);
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t p = list_index(by_list[i]->parent);
+			if (p != -1U) child_list[fill[p]++] = i;
+		}
+	}
+
+	//depth-first traversal from the roots gives parent-before-child order with contiguous subtrees:
+	streams.transform.clear();
+	streams.transform.reserve(count);
+	streams.parent.assign(count, -1U);
+	streams.subtree_end.assign(count, 0);
+
+	std::vector< uint32_t > order_of(count, -1U); //list index -> stream index
+	struct Visit {
+		uint32_t list_index;
+		uint32_t next_child;
+	};
+	std::vector< Visit > stack;
+	for (uint32_t r = 0; r < count; ++r) {
+		//transforms with no parent (or a parent from some other scene) are roots:
+		if (list_index(by_list[r]->parent) != -1U) continue;
+
+		stack.emplace_back(Visit{r, child_begin[r]});
+		order_of[r] = uint32_t(streams.transform.size());
+		streams.transform.emplace_back(const_cast< Transform * >(by_list[r]));
+		while (!stack.empty()) {
+			Visit &top = stack.back();
+			if (top.next_child < child_begin[top.list_index + 1]) {
+				uint32_t c = child_list[top.next_child++];
+				uint32_t parent_order = order_of[top.list_index];
+				order_of[c] = uint32_t(streams.transform.size());
+				streams.parent[order_of[c]] = parent_order;
+				streams.transform.emplace_back(const_cast< Transform * >(by_list[c]));
+				stack.emplace_back(Visit{c, child_begin[c]});
+			} else {
+				streams.subtree_end[order_of[top.list_index]] = uint32_t(streams.transform.size());
+				stack.pop_back();
+			}
+		}
+	}
+
+	if (streams.transform.size() != count) {
+		throw std::runtime_error("scene transform hierarchy contains a cycle.");
+	}
+
+	streams.external_roots.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		streams.transform[i]->index = i;
+		if (streams.parent[i] == -1U && streams.transform[i]->parent) streams.external_roots.emplace_back(i);
+	}
+
+	//(ranges for multi-threaded updates are split off when first needed, in update_world_matrices())
+	streams.chunks.clear();
+
+	//local values are copied in during update; mark everything as needing a recompute:
+	streams.position.assign(count, glm::vec3(std::numeric_limits< float >::quiet_NaN()));
+	streams.rotation.assign(count, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	streams.scale.assign(count, glm::vec3(1.0f));
+	streams.world_from_local.assign(count, glm::mat4x3(1.0f));
+	streams.dirty.assign(count, 1);
+
+	//force drawable -> transform mapping (and drawable bounds) to be rebuilt:
+	streams.drawable_transform.clear();
+	streams.drawable_bounds.clear();
+
+	streams.generation += 1;
+
+	//(transforms may have been removed, so the name index needs a rebuild as well)
+	name_index.transform_count = -1;
+}
+
+//do 'streams' hold exactly the transforms in 'transforms'?
+// (checked entry-by-entry rather than by count, so removing one transform and adding another is still noticed;
+//  a new transform's 'index' is -1U, even if it reuses a removed transform's address)
+static bool streams_match_transforms(Scene const &scene) {
+	uint32_t count = uint32_t(scene.streams.size());
+	if (count != scene.transforms.size()) return false;
+	for (auto const &t : scene.transforms) {
+		if (!(t.index < count && scene.streams.transform[t.index] == &t)) return false;
+	}
+	return true;
+}
+
+void Scene::update_world_matrices() const {
+	//(re-)pack if transforms were added or removed:
+	// (before anything in 'streams.transform' is dereferenced -- a removed transform's pointer would dangle)
+	if (!streams_match_transforms(*this)) {
+		pack_transforms();
+	}
+
+	uint32_t count = uint32_t(streams.size());
+	auto in_streams = [&](Transform const *t) {
+		return t->index < count && streams.transform[t->index] == t;
+	};
+
+	//Every pass below only looks at an entry and its ancestors, so it can run on any
+	// range of whole root subtrees independently -- which is how big scenes are split across threads.
+	// (small scenes never touch the pool at all)
+	bool parallel = false;
+	if (count >= parallel_min_transforms) {
+		uint32_t threads = WorkerPool::get().size() + 1;
+		if (streams.chunks.empty()) {
+			//split into ranges of whole root subtrees:
+			// (a few ranges per thread, so that uneven subtree sizes balance out)
+			uint32_t target = std::max(1024U, count / (4 * threads));
+			streams.chunks.emplace_back(0);
+			for (uint32_t i = 0; i < count; i = streams.subtree_end[i]) {
+				if (streams.subtree_end[i] - streams.chunks.back() >= target || streams.subtree_end[i] == count) {
+					streams.chunks.emplace_back(streams.subtree_end[i]);
+				}
+			}
+		}
+		parallel = (streams.chunks.size() > 2 && threads > 1);
+	}
+	auto for_each_range = [&](std::function< void(uint32_t, uint32_t) > const &fn) {
+		if (parallel) {
+			WorkerPool::get().parallel_for(uint32_t(streams.chunks.size() - 1), [&](uint32_t c) {
+				fn(streams.chunks[c], streams.chunks[c+1]);
+			});
+		} else {
+			fn(0, count);
+		}
+	};
+
+	//copy in local values, noting which entries changed:
+	std::atomic< bool > reparented(false);
+	for_each_range([&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			Transform const &t = *streams.transform[i];
+
+			//re-parenting changes the order (checked below):
+			uint32_t p = streams.parent[i];
+			if (p == -1U ? (t.parent && in_streams(t.parent)) : (t.parent != streams.transform[p])) {
+				reparented = true;
+				return;
+			}
+
+			uint8_t dirty = 0;
+			if (streams.position[i] != t.position) { streams.position[i] = t.position; dirty = 1; }
+			if (streams.rotation[i] != t.rotation) { streams.rotation[i] = t.rotation; dirty = 1; }
+			if (streams.scale[i] != t.scale) { streams.scale[i] = t.scale; dirty = 1; }
+			streams.dirty[i] |= dirty;
+		}
+	});
+
+	//...in which case, re-pack and start over:
+	if (reparented) {
+		pack_transforms();
+		update_world_matrices();
+		return;
+	}
+
+	//parents from outside this scene can't be tracked, so always recompute their children:
+	// (with those parents' world matrices as of their own scene's last update)
+	streams.external_parent_world.clear();
+	for (uint32_t i : streams.external_roots) {
+		streams.dirty[i] = 1;
+		streams.external_parent_world.emplace_back(streams.transform[i]->parent->make_world_from_local());
+	}
+
+	TransformKernels const &kernels = TransformKernels::get();
+	for_each_range([&](uint32_t range_begin, uint32_t range_end) {
+		//anything below a changed transform must be recomputed as well:
+		for (uint32_t i = range_begin; i < range_end; ++i) {
+			uint32_t p = streams.parent[i];
+			if (p != -1U) streams.dirty[i] |= streams.dirty[p];
+		}
+
+		//compute world matrices for each run of changed entries:
+		auto external_root = std::lower_bound(streams.external_roots.begin(), streams.external_roots.end(), range_begin);
+		for (uint32_t begin = range_begin; begin < range_end; ) {
+			if (!streams.dirty[begin]) {
+				begin += 1;
+				continue;
+			}
+			uint32_t end = begin + 1;
+			while (end < range_end && streams.dirty[end]) end += 1;
+
+			//local matrices:
+			kernels.trs_to_mat4x3(end - begin, &streams.position[begin], &streams.rotation[begin], &streams.scale[begin], &streams.world_from_local[begin]);
+
+			//roots attached to other scenes' transforms:
+			while (external_root != streams.external_roots.end() && *external_root < end) {
+				uint32_t i = *external_root;
+				streams.world_from_local[i] = streams.external_parent_world[external_root - streams.external_roots.begin()] * glm::mat4(streams.world_from_local[i]);
+				++external_root;
+			}
+
+			//world matrices, in parent-before-child order:
+			kernels.propagate(begin, end, streams.parent.data(), streams.world_from_local.data());
+
+			begin = end;
+		}
+
+		//update the per-transform caches of everything that was recomputed:
+		for (uint32_t i = range_begin; i < range_end; ++i) {
+			if (!streams.dirty[i]) continue;
+			streams.dirty[i] = 0;
+
+			Transform &t = *streams.transform[i];
+			t.cache.world_from_local = streams.world_from_local[i];
+			t.cache.version += 1;
+			if (t.cache.version == 0) t.cache.version = 1; //(0 is reserved for "never computed")
+		}
+	});
+}
+
+//-------------------------
+
+//FNV-1a, used for the open-addressing tables below:
+static uint64_t hash_name(std::string_view name) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (char c : name) {
+		hash = (hash ^ uint8_t(c)) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+std::string_view Scene::NameTable::intern(std::string_view name) {
+	if (name.empty()) return std::string_view();
+
+	std::unique_lock< std::mutex > lock(mutex);
+
+	//keep load factor under 1/2:
+	if ((count + 1) * 2 > slots.size()) {
+		std::vector< std::string_view > old;
+		old.swap(slots);
+		slots.assign(std::max< size_t >(64, old.size() * 2), std::string_view());
+		for (auto const &n : old) {
+			if (n.data() == nullptr) continue;
+			size_t i = hash_name(n) & (slots.size() - 1);
+			while (slots[i].data() != nullptr) i = (i + 1) & (slots.size() - 1);
+			slots[i] = n;
+		}
+	}
+
+	size_t i = hash_name(name) & (slots.size() - 1);
+	while (slots[i].data() != nullptr) {
+		if (slots[i] == name) return slots[i];
+		i = (i + 1) & (slots.size() - 1);
+	}
+
+	//new name -- store a copy unless it already lives in an adopted block:
+	bool stored = false;
+	for (auto const &block : adopted) {
+		if (name.data() >= block.data() && name.data() + name.size() <= block.data() + block.size()) {
+			stored = true;
+			break;
+		}
+	}
+	if (!stored) {
+		if (arena.empty() || arena.back().size() + name.size() > arena.back().capacity()) {
+			arena.emplace_back();
+			arena.back().reserve(std::max< size_t >(4096, name.size()));
+		}
+		std::vector< char > &block = arena.back();
+		block.insert(block.end(), name.begin(), name.end());
+		name = std::string_view(block.data() + block.size() - name.size(), name.size());
+	}
+	slots[i] = name;
+	count += 1;
+	return name;
+}
+
+std::vector< char > const &Scene::NameTable::adopt(std::vector< char > &&block) {
+	std::unique_lock< std::mutex > lock(mutex);
+	adopted.emplace_back(std::move(block));
+	return adopted.back();
+}
+
+void Scene::rebuild_name_index() const {
+	name_index.transform_count = transforms.size();
+
+	name_index.sorted.clear();
+	name_index.sorted.reserve(transforms.size());
+	for (auto const &t : transforms) {
+		if (t.name.empty()) continue;
+		name_index.sorted.emplace_back(t.name, const_cast< Transform * >(&t));
+	}
+	std::stable_sort(name_index.sorted.begin(), name_index.sorted.end(), [](auto const &a, auto const &b) {
+		return a.first < b.first;
+	});
+
+	size_t slot_count = 64;
+	while (slot_count < name_index.sorted.size() * 2) slot_count *= 2;
+	name_index.slots.assign(slot_count, -1U);
+	for (uint32_t s = 0; s < uint32_t(name_index.sorted.size()); ++s) {
+		if (s > 0 && name_index.sorted[s].first == name_index.sorted[s-1].first) continue; //(only first of each name)
+		size_t i = hash_name(name_index.sorted[s].first) & (slot_count - 1);
+		while (name_index.slots[i] != -1U) i = (i + 1) & (slot_count - 1);
+		name_index.slots[i] = s;
+	}
+}
+
+Scene::Transform const *Scene::find(std::string_view name) const {
+	if (name_index.transform_count != transforms.size()) rebuild_name_index();
+	if (name_index.slots.empty()) return nullptr;
+
+	size_t mask = name_index.slots.size() - 1;
+	for (size_t i = hash_name(name) & mask; name_index.slots[i] != -1U; i = (i + 1) & mask) {
+		auto const &entry = name_index.sorted[name_index.slots[i]];
+		if (entry.first != name) continue;
+		//transform was renamed since the index was built? rebuild and try again:
+		if (entry.second->name != name) {
+			rebuild_name_index();
+			return find(name);
+		}
+		return entry.second;
+	}
+	return nullptr;
+}
+
+Scene::Transform *Scene::find(std::string_view name) {
+	return const_cast< Transform * >(static_cast< Scene const & >(*this).find(name));
+}
+
+std::vector< Scene::Transform const * > Scene::find_all(std::string_view prefix) const {
+	if (name_index.transform_count != transforms.size()) rebuild_name_index();
+
+	std::vector< Transform const * > ret;
+	auto begin = std::lower_bound(name_index.sorted.begin(), name_index.sorted.end(), prefix, [](auto const &a, std::string_view b) {
+		return a.first < b;
+	});
+	for (auto entry = begin; entry != name_index.sorted.end() && entry->first.substr(0, prefix.size()) == prefix; ++entry) {
+		ret.emplace_back(entry->second);
+	}
+	return ret;
+}
+
+std::vector< Scene::Transform * > Scene::find_all(std::string_view prefix) {
+	std::vector< Transform * > ret;
+	for (Transform const *t : static_cast< Scene const & >(*this).find_all(prefix)) {
+		ret.emplace_back(const_cast< Transform * >(t));
+	}
+	return ret;
+}
+
+//-------------------------
+
+//add a uniform with 'size' values copied from 'data':
+static void add_uniform(Scene::Drawable::Pipeline::Uniforms *uniforms_, GLint location, Scene::Drawable::Pipeline::Uniforms::Type type, uint32_t size, void const *data) {
+	assert(uniforms_);
+	auto &uniforms = *uniforms_;
+	using Uniforms = Scene::Drawable::Pipeline::Uniforms;
+	if (uniforms.count == Uniforms::MaxUniforms || uniforms.used + size > Uniforms::MaxValues) {
+		throw std::runtime_error("Pipeline::Uniforms is full (" + std::to_string(Uniforms::MaxUniforms) + " uniforms, " + std::to_string(Uniforms::MaxValues) + " values).");
+	}
+	Uniforms::Entry &entry = uniforms.entries[uniforms.count];
+	entry.location = location;
+	entry.type = type;
+	entry.offset = uniforms.used;
+	std::memcpy(uniforms.values + uniforms.used, data, size * sizeof(float));
+	uniforms.count += 1;
+	uniforms.used += uint8_t(size);
+}
+
+void Scene::Drawable::Pipeline::Uniforms::set(GLint location, int32_t value) {
+	static_assert(sizeof(value) == sizeof(float), "ints are stored in float slots");
+	add_uniform(this, location, Int, 1, &value);
+}
+void Scene::Drawable::Pipeline::Uniforms::set(GLint location, float value) { add_uniform(this, location, Float, 1, &value); }
+void Scene::Drawable::Pipeline::Uniforms::set(GLint location, glm::vec2 const &value) { add_uniform(this, location, Vec2, 2, glm::value_ptr(value)); }
+void Scene::Drawable::Pipeline::Uniforms::set(GLint location, glm::vec3 const &value) { add_uniform(this, location, Vec3, 3, glm::value_ptr(value)); }
+void Scene::Drawable::Pipeline::Uniforms::set(GLint location, glm::vec4 const &value) { add_uniform(this, location, Vec4, 4, glm::value_ptr(value)); }
+void Scene::Drawable::Pipeline::Uniforms::set(GLint location, glm::mat3 const &value) { add_uniform(this, location, Mat3, 9, glm::value_ptr(value)); }
+void Scene::Drawable::Pipeline::Uniforms::set(GLint location, glm::mat4 const &value) { add_uniform(this, location, Mat4, 16, glm::value_ptr(value)); }
+
+void Scene::Drawable::Pipeline::Uniforms::apply() const {
+	for (uint32_t i = 0; i < count; ++i) {
+		Entry const &entry = entries[i];
+		float const *value = values + entry.offset;
+		switch (entry.type) {
+			case Int: {
+				int32_t v;
+				std::memcpy(&v, value, sizeof(v));
+				glUniform1i(entry.location, v);
+			} break;
+			case Float: glUniform1fv(entry.location, 1, value); break;
+			case Vec2: glUniform2fv(entry.location, 1, value); break;
+			case Vec3: glUniform3fv(entry.location, 1, value); break;
+			case Vec4: glUniform4fv(entry.location, 1, value); break;
+			case Mat3: glUniformMatrix3fv(entry.location, 1, GL_FALSE, value); break;
+			case Mat4: glUniformMatrix4fv(entry.location, 1, GL_FALSE, value); break;
+		}
+	}
+}
+
+//-------------------------
+
+//Instanced batches read per-instance matrices from a buffer texture; all scenes share one, created at load time:
+namespace {
+	struct InstanceBuffer {
+		InstanceBuffer() {
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_TEXTURE_BUFFER, buffer); //(creates the buffer object, so the texture can refer to it)
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+			glGenTextures(1, &texture);
+			gl_state.bind_texture(Scene::InstanceTextureUnit, GL_TEXTURE_BUFFER, texture);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+
+			GL_ERRORS();
+		}
+		~InstanceBuffer() {
+			glDeleteTextures(1, &texture);
+			glDeleteBuffers(1, &buffer);
+			gl_state.invalidate(); //(in case the texture was bound)
+		}
+
+		//copying would share the buffer and texture:
+		InstanceBuffer(InstanceBuffer const &) = delete;
+		InstanceBuffer &operator=(InstanceBuffer const &) = delete;
+
+		GLuint buffer = 0; //instance data, as GL_RGBA32F texels
+		GLuint texture = 0; //GL_TEXTURE_BUFFER reading 'buffer'
+	};
+}
+
+static Load< InstanceBuffer > instance_buffer(LoadTagEarly);
+
 void Scene::draw(Camera const &camera) const {
 	assert(camera.transform);
 	glm::mat4 clip_from_world = camera.make_projection() * glm::mat4(camera.transform->make_local_from_world());
@@ -87,13 +555,235 @@ void Scene::draw(Camera const &camera) const {
 	draw(clip_from_world, light_from_world);
 }
 
+//Stable least-significant-digit radix sort of queue entries by key, eight bits at a time:
+// (passes where every entry has the same digit are skipped -- common for the upper bits)
+static void radix_sort(std::vector< Scene::QueueEntry > *entries_, std::vector< Scene::QueueEntry > *scratch_) {
+	assert(entries_);
+	assert(scratch_);
+	auto &entries = *entries_;
+	auto &scratch = *scratch_;
+	scratch.resize(entries.size());
+
+	uint32_t counts[8][256] = {};
+	for (auto const &e : entries) {
+		for (uint32_t pass = 0; pass < 8; ++pass) {
+			counts[pass][(e.key >> (8 * pass)) & 0xff] += 1;
+		}
+	}
+
+	for (uint32_t pass = 0; pass < 8; ++pass) {
+		uint32_t shift = 8 * pass;
+		if (entries.empty() || counts[pass][(entries[0].key >> shift) & 0xff] == entries.size()) continue;
+
+		uint32_t offsets[256];
+		uint32_t total = 0;
+		for (uint32_t b = 0; b < 256; ++b) {
+			offsets[b] = total;
+			total += counts[pass][b];
+		}
+		for (auto const &e : entries) {
+			scratch[offsets[(e.key >> shift) & 0xff]++] = e;
+		}
+		entries.swap(scratch);
+	}
+}
+
+glm::mat4x3 const &Scene::drawable_world_from_local(size_t d) const {
+	//Look up (if needed) where each drawable's transform lives in the streams:
+	if (streams.drawable_transform.size() != drawables.size()) {
+		streams.drawable_transform.resize(drawables.size());
+		for (size_t i = 0; i < drawables.size(); ++i) {
+			streams.drawable_transform[i] = drawables[i].transform->index;
+		}
+	}
+
+	Drawable const &drawable = drawables[d];
+	assert(drawable.transform); //drawables *must* have a transform
+	uint32_t index = streams.drawable_transform[d];
+	if (!(index < streams.size() && streams.transform[index] == drawable.transform)) {
+		//drawable was re-targeted, or its transform isn't part of this scene:
+		index = drawable.transform->index;
+		if (!(index < streams.size() && streams.transform[index] == drawable.transform)) index = -1U;
+		streams.drawable_transform[d] = index;
+	}
+	if (index != -1U) return streams.world_from_local[index];
+	return drawable.transform->cache.world_from_local;
+}
+
+//do the transforms saved in 'history' still exist?
+// (save_previous_transforms() packs the streams, and any transform added since has index -1U or caused a re-pack,
+//  so checking the live list against the streams -- never dereferencing saved pointers -- is enough)
+static bool history_matches_transforms(Scene const &scene) {
+	return scene.history.transform.size() == scene.transforms.size()
+	    && scene.history.generation == scene.streams.generation
+	    && streams_match_transforms(scene);
+}
+
+void Scene::save_previous_transforms() {
+	restore_transforms(); //(in case interpolated values are still in place)
+
+	if (!streams_match_transforms(*this)) pack_transforms();
+	history.generation = streams.generation;
+	history.transform.clear();
+	history.position.clear();
+	history.rotation.clear();
+	history.scale.clear();
+	for (Transform &t : transforms) {
+		history.transform.emplace_back(&t);
+		history.position.emplace_back(t.position);
+		history.rotation.emplace_back(t.rotation);
+		history.scale.emplace_back(t.scale);
+	}
+}
+
+void Scene::interpolate_transforms(float alpha) {
+	restore_transforms();
+	//(nothing saved -- or transforms were added or removed since -- so there's nothing to blend with)
+	if (alpha >= 1.0f || !history_matches_transforms(*this)) {
+		update_world_matrices();
+		return;
+	}
+	alpha = std::max(0.0f, alpha);
+
+	for (uint32_t i = 0; i < history.transform.size(); ++i) {
+		Transform &t = *history.transform[i];
+		if (t.position == history.position[i] && t.rotation == history.rotation[i] && t.scale == history.scale[i]) continue;
+
+		history.blended.emplace_back(i);
+		history.current_position.emplace_back(t.position);
+		history.current_rotation.emplace_back(t.rotation);
+		history.current_scale.emplace_back(t.scale);
+
+		t.position = glm::mix(history.position[i], t.position, alpha);
+		t.rotation = glm::slerp(history.rotation[i], t.rotation, alpha);
+		t.scale = glm::mix(history.scale[i], t.scale, alpha);
+	}
+
+	update_world_matrices();
+}
+
+void Scene::restore_transforms() {
+	if (history.blended.empty()) return;
+
+	//transforms were added or removed while interpolated -- the saved ones may be gone, so forget them:
+	// (any that remain keep their interpolated values)
+	if (!history_matches_transforms(*this)) {
+		history = TransformHistory();
+		update_world_matrices();
+		return;
+	}
+
+	for (uint32_t b = 0; b < history.blended.size(); ++b) {
+		Transform &t = *history.transform[history.blended[b]];
+		t.position = history.current_position[b];
+		t.rotation = history.current_rotation[b];
+		t.scale = history.current_scale[b];
+	}
+	history.blended.clear();
+	history.current_position.clear();
+	history.current_rotation.clear();
+	history.current_scale.clear();
+
+	update_world_matrices();
+}
+
+void Scene::update_drawable_bvh() const {
+	update_world_matrices();
+
+	uint32_t count = uint32_t(drawables.size());
+	if (streams.drawable_bounds.size() != count) {
+		streams.drawable_bounds.assign(count, TransformStreams::DrawableBounds());
+	}
+	drawable_bvh.resize(count);
+	streams.unbounded_drawables.clear();
+
+	for (uint32_t d = 0; d < count; ++d) {
+		Drawable const &drawable = drawables[d];
+		if (BVH::empty(drawable.min, drawable.max)) {
+			streams.unbounded_drawables.emplace_back(d);
+			drawable_bvh.set(d, drawable.min, drawable.max);
+			continue;
+		}
+
+		//only recompute boxes of drawables that moved (or whose local box changed):
+		glm::mat4x3 const &world_from_local = drawable_world_from_local(d);
+		uint32_t version = drawable.transform->cache.version;
+		auto &bounds = streams.drawable_bounds[d];
+		if (bounds.world_version == version && version != 0 && bounds.min == drawable.min && bounds.max == drawable.max) continue;
+		bounds.world_version = version;
+		bounds.min = drawable.min;
+		bounds.max = drawable.max;
+
+		//center transforms as a point; extent by the absolute value of the linear part:
+		glm::vec3 center = 0.5f * (drawable.max + drawable.min);
+		glm::vec3 extent = 0.5f * (drawable.max - drawable.min);
+		glm::vec3 world_center = world_from_local * glm::vec4(center, 1.0f);
+		glm::vec3 world_extent =
+			  glm::abs(world_from_local[0]) * extent.x
+			+ glm::abs(world_from_local[1]) * extent.y
+			+ glm::abs(world_from_local[2]) * extent.z;
+		drawable_bvh.set(d, world_center - world_extent, world_center + world_extent);
+	}
+
+	drawable_bvh.update();
+}
+
 void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world) const {
+	PROFILE_SCOPE("Scene::draw");
+	PROFILE_GPU_SCOPE("Scene::draw");
+
+	//Bring all world matrices up to date at once:
+	update_world_matrices();
+
+	//Test drawables against the view frustum:
+	counters = DrawCounters();
+	drawable_visible.assign(drawables.size(), 1);
+	if (frustum_culling && !drawables.empty()) {
+		Frustum frustum = Frustum::from_clip(clip_from_world);
+		uint32_t visible = 0;
+		if (drawables.size() >= bvh_threshold) {
+			//walk the tree:
+			update_drawable_bvh();
+			drawable_visible.assign(drawables.size(), 0);
+			for (uint32_t d : streams.unbounded_drawables) {
+				drawable_visible[d] = 1;
+			}
+			visible = uint32_t(streams.unbounded_drawables.size());
+			uint32_t before = drawable_bvh.nodes_visited;
+			drawable_bvh.for_each_in_frustum(frustum, [&](uint32_t d) {
+				drawable_visible[d] = 1;
+				visible += 1;
+			});
+			counters.bvh_nodes = drawable_bvh.nodes_visited - before;
+		} else {
+			//test every drawable, in one batch:
+			drawable_boxes.resize(drawables.size());
+			for (size_t d = 0; d < drawables.size(); ++d) {
+				drawable_boxes.set(d, drawable_world_from_local(d), drawables[d].min, drawables[d].max);
+			}
+			visible = frustum.test(drawable_boxes, drawable_visible.data());
+		}
+		counters.tested = uint32_t(drawables.size());
+		counters.culled = counters.tested - visible;
+	}
 
-	//Iterate through all drawables, sending each one to OpenGL:
-	for (auto const &drawable : drawables) {
-		//Reference to drawable's pipeline for convenience:
+	//drawables that could be drawn by Pipeline::instanced_program:
+	auto can_instance = [&](Drawable::Pipeline const &pipeline) {
+		return instancing_threshold != -1U && pipeline.instanced_program != 0 && pipeline.uniforms.empty();
+	};
+
+	//Build a render queue of visible drawables, sorted to group drawables that share GL state:
+	// (key bits, high to low: program [8], vao [12], textures [20], depth -- or, for drawables that can be instanced, mesh -- [24];
+	//  names are truncated / hashed, so unrelated state can share a key -- which only costs grouping, since binds below check actual state)
+	render_queue.clear();
+	render_queue.reserve(drawables.size());
+	glm::vec4 clip_w = glm::vec4(clip_from_world[0][3], clip_from_world[1][3], clip_from_world[2][3], clip_from_world[3][3]);
+	for (size_t d = 0; d < drawables.size(); ++d) {
+		Drawable const &drawable = drawables[d];
 		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
 
+		//skip any drawables outside the view:
+		if (!drawable_visible[d]) continue;
 		//skip any drawables without a shader program set:
 		if (pipeline.program == 0) continue;
 		//skip any drawables that don't reference any vertex array:
@@ -101,66 +791,184 @@ void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from
 		//skip any drawables that don't contain any vertices:
 		if (pipeline.count == 0) continue;
 
+		uint32_t texture_hash = 0;
+		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+			texture_hash = texture_hash * 0x9e3779b1U + pipeline.textures[i].texture;
+		}
+		texture_hash ^= texture_hash >> 16;
 
-		//Set shader program:
-		glUseProgram(pipeline.program);
-
-		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+		uint32_t low_bits = 0;
+		if (can_instance(pipeline)) {
+			//group copies of the same mesh together, so they can be drawn in one call:
+			uint32_t mesh_hash = (pipeline.start * 0x9e3779b1U) ^ (pipeline.count * 0x85ebca6bU) ^ pipeline.type;
+			low_bits = mesh_hash ^ (mesh_hash >> 16);
+		} else {
+			//clip-space w of the object's origin is its distance in front of the camera;
+			// non-negative floats sort like their bit patterns, so (nearer first) the top bits make a depth key:
+			float w = glm::dot(clip_w, glm::vec4(drawable_world_from_local(d)[3], 1.0f));
+			uint32_t depth_bits = 0;
+			if (w > 0.0f) std::memcpy(&depth_bits, &w, sizeof(depth_bits));
+			low_bits = depth_bits >> 8;
+		}
 
-		//Configure program uniforms:
+		uint64_t key =
+			  (uint64_t(pipeline.program & 0xff) << 56)
+			| (uint64_t(pipeline.vao & 0xfff) << 44)
+			| (uint64_t(texture_hash & 0xfffff) << 24)
+			| uint64_t(low_bits & 0xffffff);
+		render_queue.emplace_back(QueueEntry{key, uint32_t(d)});
+	}
+	radix_sort(&render_queue, &render_queue_scratch);
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 world_from_object = drawable.transform->make_world_from_local();
+	//Split the queue into batches, gathering the matrices of each instanced batch into instance_data:
+	auto same_instance = [](Drawable::Pipeline const &a, Drawable::Pipeline const &b) {
+		if (a.program != b.program || a.instanced_program != b.instanced_program || a.vao != b.vao) return false;
+		if (a.type != b.type || a.start != b.start || a.count != b.count) return false;
+		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+			if (a.textures[i].texture != b.textures[i].texture || a.textures[i].target != b.textures[i].target) return false;
+		}
+		return true;
+	};
+	render_batches.clear();
+	instance_data.clear();
+	uint32_t objects = 0;
+	for (uint32_t begin = 0; begin < render_queue.size(); /* later */) {
+		Drawable::Pipeline const &pipeline = drawables[render_queue[begin].drawable].pipeline;
+		uint32_t end = begin + 1;
+		if (can_instance(pipeline)) {
+			while (end < render_queue.size()) {
+				Drawable::Pipeline const &next = drawables[render_queue[end].drawable].pipeline;
+				if (!can_instance(next) || !same_instance(pipeline, next)) break;
+				++end;
+			}
+		}
+		if (end - begin >= instancing_threshold && can_instance(pipeline)) {
+			render_batches.emplace_back(Batch{begin, end, uint32_t(instance_data.size() / InstanceTexels), objects});
+			objects += 1;
+			for (uint32_t q = begin; q < end; ++q) {
+				glm::mat4x3 const &world_from_object = drawable_world_from_local(render_queue[q].drawable);
+				glm::mat3 world_from_normal = glm::inverse(glm::transpose(glm::mat3(world_from_object)));
+				for (uint32_t r = 0; r < 3; ++r) {
+					instance_data.emplace_back(world_from_object[0][r], world_from_object[1][r], world_from_object[2][r], world_from_object[3][r]);
+				}
+				for (uint32_t r = 0; r < 3; ++r) {
+					instance_data.emplace_back(world_from_normal[0][r], world_from_normal[1][r], world_from_normal[2][r], 0.0f);
+				}
+			}
+		} else {
+			render_batches.emplace_back(Batch{begin, end, -1U, objects});
+			objects += end - begin;
+		}
+		begin = end;
+	}
 
-		//CLIP_FROM_OBJECT takes vertices from object space to clip space:
-		if (pipeline.CLIP_FROM_OBJECT_mat4 != -1U) {
-			glm::mat4 clip_from_object = clip_from_world * glm::mat4(world_from_object);
-			glUniformMatrix4fv(pipeline.CLIP_FROM_OBJECT_mat4, 1, GL_FALSE, glm::value_ptr(clip_from_object));
+	//Per-frame constants:
+	UniformBlocks::Frame frame;
+	frame.CLIP_FROM_WORLD = clip_from_world;
+	frame.set_light_from_world(light_from_world);
+	frame.LIGHT_TYPE = frame_light.type;
+	frame.LIGHT_LOCATION = frame_light.location;
+	frame.LIGHT_DIRECTION = frame_light.direction;
+	frame.LIGHT_ENERGY = frame_light.energy;
+	frame.LIGHT_CUTOFF = frame_light.cutoff;
+	UniformBlocks::set_frame(frame);
+
+	//Per-draw constants, streamed all at once (so each draw only binds its range):
+	uint32_t const stride = UniformBlocks::object_stride();
+	object_data.assign(size_t(objects) * stride, 0);
+	for (Batch const &batch : render_batches) {
+		if (batch.instance_base != -1U) {
+			UniformBlocks::Object object;
+			object.INSTANCE_BASE = int32_t(batch.instance_base);
+			std::memcpy(object_data.data() + size_t(batch.object) * stride, &object, sizeof(object));
+		} else {
+			for (uint32_t q = batch.begin; q < batch.end; ++q) {
+				UniformBlocks::Object object;
+				object.set(clip_from_world, light_from_world, drawable_world_from_local(render_queue[q].drawable));
+				std::memcpy(object_data.data() + size_t(batch.object + (q - batch.begin)) * stride, &object, sizeof(object));
+			}
 		}
+	}
+	GLintptr object_base = 0;
+	if (!object_data.empty()) {
+		object_base = UniformBlocks::stream_objects(object_data.data(), GLsizeiptr(object_data.size()));
+	}
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 light_from_object = light_from_world * glm::mat4(world_from_object);
+	//Upload this frame's instances (to fresh storage, so the driver needn't wait on draws from last frame):
+	if (!instance_data.empty()) {
+		glBindBuffer(GL_TEXTURE_BUFFER, instance_buffer->buffer);
+		glBufferData(GL_TEXTURE_BUFFER, instance_data.size() * sizeof(glm::vec4), instance_data.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
 
-		//CLIP_FROM_OBJECT takes vertices from object space to light space:
-		if (pipeline.LIGHT_FROM_OBJECT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.LIGHT_FROM_OBJECT_mat4x3, 1, GL_FALSE, glm::value_ptr(light_from_object));
-		}
+	//Send each batch to OpenGL, through gl_state (so only state that differs from the previous batch is set):
+	auto use_program = [&](GLuint program) {
+		if (gl_state.use_program(program)) counters.programs += 1;
+	};
 
-		//LIGHT_FROM_NORMAL takes normals from object space to light space:
-		if (pipeline.LIGHT_FROM_NORMAL_mat3 != -1U) {
-			glm::mat3 light_from_normal = glm::inverse(glm::transpose(glm::mat3(light_from_object)));
-			glUniformMatrix3fv(pipeline.LIGHT_FROM_NORMAL_mat3, 1, GL_FALSE, glm::value_ptr(light_from_normal));
-		}
+	auto bind_texture = [&](uint32_t i, GLenum target, GLuint texture) {
+		if (gl_state.bind_texture(i, target, texture)) counters.textures += 1;
+	};
 
-		//set any requested custom uniforms:
-		if (pipeline.set_uniforms) pipeline.set_uniforms();
+	auto set_state = [&](Drawable::Pipeline const &pipeline) {
+		//Set attribute sources:
+		if (gl_state.bind_vertex_array(pipeline.vao)) counters.vaos += 1;
 
-		//set up textures:
+		//set up textures (units with texture 0 get nothing bound to that target):
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
-			}
+			bind_texture(i, pipeline.textures[i].target, pipeline.textures[i].texture);
 		}
+	};
 
-		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+	for (Batch const &batch : render_batches) {
+		if (batch.instance_base != -1U) {
+			//Draw the whole batch with one instanced call:
+			Scene::Drawable::Pipeline const &pipeline = drawables[render_queue[batch.begin].drawable].pipeline;
 
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
-			}
+			use_program(pipeline.instanced_program);
+			UniformBlocks::bind_object(object_base + GLintptr(batch.object) * stride);
+
+			set_state(pipeline);
+			bind_texture(InstanceTextureUnit, GL_TEXTURE_BUFFER, instance_buffer->texture);
+
+			GLsizei instances = GLsizei(batch.end - batch.begin);
+			glDrawArraysInstanced(pipeline.type, pipeline.start, pipeline.count, instances);
+			counters.draws += 1;
+			if (pipeline.type == GL_TRIANGLES) counters.triangles += (pipeline.count / 3) * uint32_t(instances);
+			counters.instanced_draws += 1;
+			counters.instances += instances;
+			continue;
 		}
-		glActiveTexture(GL_TEXTURE0);
 
+		for (uint32_t q = batch.begin; q < batch.end; ++q) {
+			Drawable const &drawable = drawables[render_queue[q].drawable];
+			//Reference to drawable's pipeline for convenience:
+			Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+
+			//Set shader program:
+			use_program(pipeline.program);
+
+			//Point the Object uniform block at this drawable's constants:
+			UniformBlocks::bind_object(object_base + GLintptr(batch.object + (q - batch.begin)) * stride);
+
+			//set any requested custom uniforms:
+			if (!pipeline.uniforms.empty()) pipeline.uniforms.apply();
+
+			set_state(pipeline);
+
+			//draw the object:
+			glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+			counters.draws += 1;
+			if (pipeline.type == GL_TRIANGLES) counters.triangles += pipeline.count / 3;
+		}
 	}
 
-	glUseProgram(0);
-	glBindVertexArray(0);
+	//(bindings are left as they are -- code that draws next goes through gl_state as well -- but
+	// texture unit zero is made active again, since code that creates textures expects it)
+	gl_state.active_texture(0);
+
+	PROFILE_COUNTER("draw calls", counters.draws);
+	PROFILE_COUNTER("triangles", counters.triangles);
 
 	GL_ERRORS();
 }
@@ -168,11 +976,16 @@ void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from
 
 void Scene::load(std::string const &filename,
 	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+	PROFILE_SCOPE("Scene::load");
 
 	std::ifstream file(filename, std::ios::binary);
 
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
+	//names are kept (as one block) in the name table, so transform names can point right into them:
+	std::vector< char > const &str0 = [&]() -> std::vector< char > const & {
+		std::vector< char > block;
+		read_chunk(file, "str0", &block);
+		return names->adopt(std::move(block));
+	}();
 
 	struct HierarchyEntry {
 		uint32_t parent;
@@ -234,8 +1047,8 @@ void Scene::load(std::string const &filename,
 			t->parent = hierarchy_transforms[h.parent];
 		}
 
-		if (h.name_begin <= h.name_end && h.name_end <= names.size()) {
-			t->name = std::string(names.begin() + h.name_begin, names.begin() + h.name_end);
+		if (h.name_begin <= h.name_end && h.name_end <= str0.size()) {
+			t->name = names->intern(std::string_view(str0.data() + h.name_begin, h.name_end - h.name_begin));
 		} else {
 				throw std::runtime_error("scene file '" + filename + "' contains hierarchy entry with invalid name indices");
 		}
@@ -252,10 +1065,10 @@ void Scene::load(std::string const &filename,
 		if (m.transform >= hierarchy_transforms.size()) {
 			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid transform index (" + std::to_string(m.transform) + ")");
 		}
-		if (!(m.name_begin <= m.name_end && m.name_end <= names.size())) {
+		if (!(m.name_begin <= m.name_end && m.name_end <= str0.size())) {
 			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid name indices");
 		}
-		std::string name = std::string(names.begin() + m.name_begin, names.begin() + m.name_end);
+		std::string name = std::string(str0.begin() + m.name_begin, str0.begin() + m.name_end);
 
 		if (on_drawable) {
 			on_drawable(*this, hierarchy_transforms[m.transform], name);
@@ -302,14 +1115,14 @@ void Scene::load(std::string const &filename,
 	}
 
 	//load any extra that a subclass wants:
-	load_extra(file, names, hierarchy_transforms);
+	load_extra(file, str0, hierarchy_transforms);
 
 	if (file.peek() != EOF) {
 		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
 	}
 
-
-
+	//so loaded transforms report their world matrices right away:
+	update_world_matrices();
 }
 
 //-------------------------
@@ -327,51 +1140,102 @@ Scene &Scene::operator=(Scene const &other) {
 	return *this;
 }
 
-void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map_) {
-
-	std::unordered_map< Transform const *, Transform * > t2t_temp;
-	std::unordered_map< Transform const *, Transform * > &transform_to_transform = *(transform_map_ ? transform_map_ : &t2t_temp);
-
-	transform_to_transform.clear();
+void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map) {
+	if (&other == this) {
+		if (transform_map) {
+			transform_map->clear();
+			transform_map->insert(std::make_pair(nullptr, nullptr));
+			for (auto const &t : transforms) {
+				transform_map->insert(std::make_pair(&t, const_cast< Transform * >(&t)));
+			}
+		}
+		return;
+	}
 
-	//null transform maps to itself:
-	transform_to_transform.insert(std::make_pair(nullptr, nullptr));
+	//saved and interpolated state refers to transforms that are about to be replaced, so forget it:
+	// (copies of a scene don't copy saved state either)
+	history = TransformHistory();
+
+	//Fix up pointers through other's stream indices ('index') rather than a pointer->pointer map,
+	// so make sure other's streams describe its current hierarchy:
+	uint32_t count = uint32_t(other.transforms.size());
+	{
+		bool current = streams_match_transforms(other);
+		if (current) {
+			for (auto const &t : other.transforms) {
+				uint32_t p = other.streams.parent[t.index];
+				if (p == -1U ? (t.parent && t.parent->index < count && other.streams.transform[t.parent->index] == t.parent)
+				             : (t.parent != other.streams.transform[p])) { current = false; break; }
+			}
+		}
+		if (!current) other.pack_transforms();
+	}
 
-	//Copy transforms and store mapping:
+	//Copy streams in bulk (world matrices and all), then point them at this scene's transforms:
+	streams = other.streams;
+	parallel_min_transforms = other.parallel_min_transforms;
+	frustum_culling = other.frustum_culling;
+	bvh_threshold = other.bvh_threshold;
+	instancing_threshold = other.instancing_threshold;
+	frame_light = other.frame_light;
+	drawable_bvh = other.drawable_bvh;
+	drawable_bvh.rebuild.reset(); //(a background build in progress belongs to 'other')
+
+	//names are immutable once interned, so the table is shared rather than copied:
+	names = other.names;
+	name_index = NameIndex();
+
+	//Copy transforms (in list order), noting each new transform by index:
 	transforms.clear();
 	for (auto const &t : other.transforms) {
 		transforms.emplace_back();
-		transforms.back().name = t.name;
-		transforms.back().position = t.position;
-		transforms.back().rotation = t.rotation;
-		transforms.back().scale = t.scale;
-		transforms.back().parent = t.parent; //will update later
-
-		//store mapping between transforms old and new:
-		auto ret = transform_to_transform.insert(std::make_pair(&t, &transforms.back()));
-		assert(ret.second);
+		Transform &copy = transforms.back();
+		copy.name = t.name;
+		copy.position = t.position;
+		copy.rotation = t.rotation;
+		copy.scale = t.scale;
+		copy.parent = t.parent; //will update below (parents outside 'other' are kept as-is)
+		copy.cache = t.cache;
+		copy.index = t.index;
+		streams.transform[t.index] = &copy;
 	}
 
 	//update transform parents:
 	for (auto &t : transforms) {
-		t.parent = transform_to_transform.at(t.parent);
+		uint32_t p = streams.parent[t.index];
+		if (p != -1U) t.parent = streams.transform[p];
 	}
 
+	auto fixup = [&](Transform *t) -> Transform * {
+		if (t && t->index < count && other.streams.transform[t->index] == t) return streams.transform[t->index];
+		return t;
+	};
+
 	//copy other's drawables, updating transform pointers:
 	drawables = other.drawables;
 	for (auto &d : drawables) {
-		d.transform = transform_to_transform.at(d.transform);
+		d.transform = fixup(d.transform);
 	}
 
 	//copy other's cameras, updating transform pointers:
 	cameras = other.cameras;
 	for (auto &c : cameras) {
-		c.transform = transform_to_transform.at(c.transform);
+		c.transform = fixup(c.transform);
 	}
 
 	//copy other's lights, updating transform pointers:
 	lights = other.lights;
 	for (auto &l : lights) {
-		l.transform = transform_to_transform.at(l.transform);
+		l.transform = fixup(l.transform);
+	}
+
+	//only build the pointer->pointer map if someone asked for it:
+	if (transform_map) {
+		transform_map->clear();
+		transform_map->reserve(count + 1);
+		transform_map->insert(std::make_pair(nullptr, nullptr));
+		for (uint32_t i = 0; i < count; ++i) {
+			transform_map->insert(std::make_pair(other.streams.transform[i], streams.transform[i]));
+		}
 	}
 }
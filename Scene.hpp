@@ -11,21 +11,53 @@
  */
 
 #include "GL.hpp"
+#include "Frustum.hpp"
+#include "BVH.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
 #include <list>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
+#include <limits>
+#include <type_traits>
 
 struct Scene {
+	//Names are interned in a string table shared by a scene and its copies:
+	// (storage is append-only, so views returned by intern() stay valid as long as the table does)
+	struct NameTable {
+		//returns a view of the stored copy of 'name' (adding it if needed):
+		std::string_view intern(std::string_view name);
+
+		//store a whole block of characters (e.g., a scene file's "str0" chunk) without copying it:
+		// names inside the returned block can then be passed to intern() without being copied again
+		std::vector< char > const &adopt(std::vector< char > &&block);
+
+		size_t size() const { return count; }
+
+	private:
+		std::mutex mutex;
+		std::deque< std::vector< char > > adopted; //(deques, so references to blocks stay valid)
+		std::deque< std::vector< char > > arena; //copies of names; each block is filled without exceeding its capacity, so it never moves
+		std::vector< std::string_view > slots; //open addressing (linear probing); empty slots have data() == nullptr
+		size_t count = 0;
+	};
+	std::shared_ptr< NameTable > names = std::make_shared< NameTable >();
+
+	//shorthand for names->intern(name):
+	std::string_view intern(std::string_view name) { return names->intern(name); }
+
 	struct Transform {
 		//Transform names are useful for debugging and looking up locations in a loaded scene:
-		std::string name;
+		// (names point into a NameTable -- use Scene::intern() when naming transforms from strings that don't outlive the scene)
+		std::string_view name;
 
 		//The core function of a transform is to store a transformation in the world:
 		glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -39,10 +71,29 @@ struct Scene {
 		// ..relative to its parent:
 		glm::mat4x3 make_parent_from_local() const;
 		glm::mat4x3 make_local_from_parent() const;
-		// ..relative to the world:
+		// ..relative to the world, as of the last Scene::update_world_matrices() of the transform's scene:
+		// (these only read 'cache', so they are cheap and safe to call from any thread while the scene isn't being updated;
+		//  changes to position/rotation/scale/parent show up once the scene is updated again)
 		glm::mat4x3 make_world_from_local() const;
 		glm::mat4x3 make_local_from_world() const;
 
+		//World matrices are cached. Scene::update_world_matrices() notices which transforms changed and
+		// recomputes them (and their descendants) once, in one pass -- nothing is computed on access.
+		// (a transform that has never been updated reports an identity matrix and world_version() 0)
+		struct Cache {
+			uint32_t version = 0; //incremented whenever world_from_local changes (0 => never computed)
+			glm::mat4x3 world_from_local = glm::mat4x3(1.0f);
+		};
+		Cache cache;
+
+		//'world_version' changes whenever make_world_from_local() returns something new:
+		// (useful for noticing that an object has moved since last frame)
+		uint32_t world_version() const { return cache.version; }
+
+		//position of this transform in its scene's 'streams' (see below):
+		// (assigned by Scene::pack_transforms(); -1U if never packed)
+		mutable uint32_t index = -1U;
+
 		//since hierarchy is tracked through pointers, copy-constructing a transform  is not advised:
 		Transform(Transform const &) = delete;
 		//if we delete some constructors, we need to let the compiler know that the default constructor is still okay:
@@ -54,6 +105,11 @@ struct Scene {
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
+		//Bounding box in local space (usually copied from Mesh::min/max):
+		// drawables whose box is outside the view are skipped; an empty box (the default) is never skipped
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
 			GLuint program = 0; //shader program; passed to glUseProgram
@@ -66,11 +122,37 @@ struct Scene {
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
 
 			//uniforms:
-			GLuint CLIP_FROM_OBJECT_mat4 = -1U; //uniform location for object to clip space matrix
-			GLuint LIGHT_FROM_OBJECT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
-			GLuint LIGHT_FROM_NORMAL_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
+			// draw() provides the Frame and Object uniform blocks (see UniformBlocks.hpp) --
+			// CLIP_FROM_OBJECT, LIGHT_FROM_OBJECT, and LIGHT_FROM_NORMAL are in 'Object'
+
+			//(optional) any other useful uniforms, set before drawing:
+			// values are stored inline, so pipelines (and drawables) stay trivially copyable
+			struct Uniforms {
+				enum : uint32_t { MaxUniforms = 4, MaxValues = 16 }; //(enough for one mat4, or several smaller values)
+				enum Type : uint8_t { Int, Float, Vec2, Vec3, Vec4, Mat3, Mat4 };
+				struct Entry {
+					GLint location;
+					Type type;
+					uint8_t offset; //index of first value in 'values'
+				} entries[MaxUniforms] = {};
+				uint8_t count = 0; //entries in use
+				uint8_t used = 0; //values in use
+				float values[MaxValues] = {}; //(ints are stored bit-for-bit)
+
+				bool empty() const { return count == 0; }
 
-			std::function< void() > set_uniforms; //(optional) function to set any other useful uniforms
+				//add a uniform (throws if out of space):
+				void set(GLint location, int32_t value);
+				void set(GLint location, float value);
+				void set(GLint location, glm::vec2 const &value);
+				void set(GLint location, glm::vec3 const &value);
+				void set(GLint location, glm::vec4 const &value);
+				void set(GLint location, glm::mat3 const &value);
+				void set(GLint location, glm::mat4 const &value);
+
+				//send to the current program with glUniform*:
+				void apply() const;
+			} uniforms;
 
 			//texture objects to bind for the first TextureCount textures:
 			enum : uint32_t { TextureCount = 4 };
@@ -78,8 +160,17 @@ struct Scene {
 				GLuint texture = 0;
 				GLenum target = GL_TEXTURE_2D;
 			} textures[TextureCount];
+
+			//(optional) instanced version of 'program':
+			// runs of drawables with the same program, vao, type, start, count, and textures (and no other uniforms)
+			// are drawn with one glDrawArraysInstanced call using this program instead (see Scene::draw()).
+			// it must read vertex attributes from the same locations as 'program' (so 'vao' works with both)
+			// and per-instance matrices from the instance buffer bound to Scene::InstanceTextureUnit,
+			// starting at Object's INSTANCE_BASE
+			GLuint instanced_program = 0;
 		} pipeline;
 	};
+	static_assert(std::is_trivially_copyable< Drawable >::value, "Drawables can be copied with memcpy.");
 
 	struct Camera {
 		//a 'Camera' attaches camera data to a transform:
@@ -117,20 +208,193 @@ struct Scene {
 	};
 
 	//Scenes, of course, may have many of the above objects:
+	// (transforms, cameras, and lights are held in lists so that pointers to them stay valid;
+	//  drawables are held contiguously -- pointers to drawables are invalidated by adding more)
 	std::list< Transform > transforms;
-	std::list< Drawable > drawables;
+	std::vector< Drawable > drawables;
 	std::list< Camera > cameras;
 	std::list< Light > lights;
 
+	//Per-frame passes over the hierarchy use a contiguous, structure-of-arrays copy of 'transforms':
+	// - entries are sorted so that parents come before children and every subtree is a contiguous range;
+	// - Transform pointers remain the handles used by gameplay code; 'transform[i]->index == i'.
+	struct TransformStreams {
+		std::vector< Transform * > transform; //handle for each entry
+		std::vector< uint32_t > parent; //index of parent entry (-1U for roots); always less than own index
+		std::vector< uint32_t > subtree_end; //one past the index of the last descendant
+		std::vector< glm::vec3 > position;
+		std::vector< glm::quat > rotation;
+		std::vector< glm::vec3 > scale;
+		std::vector< glm::mat4x3 > world_from_local;
+
+		std::vector< uint8_t > dirty; //scratch: entries recomputed during the current update
+
+		uint32_t generation = 0; //incremented each time pack_transforms() rebuilds the streams
+
+		//roots whose 'parent' is a transform from some other scene (rare; always recomputed):
+		std::vector< uint32_t > external_roots;
+		std::vector< glm::mat4x3 > external_parent_world; //scratch: world matrix of each external root's parent
+
+		//boundaries of ranges of whole root subtrees, used to split updates across threads:
+		// (range c is [chunks[c], chunks[c+1]); empty until a scene big enough to split is updated)
+		std::vector< uint32_t > chunks;
+
+		//index of each drawable's transform in the streams (parallel to 'drawables'):
+		std::vector< uint32_t > drawable_transform;
+
+		//what each drawable's box in drawable_bvh was computed from (parallel to 'drawables'):
+		struct DrawableBounds {
+			uint32_t world_version = 0; //transform's world_version()
+			glm::vec3 min = glm::vec3(0.0f), max = glm::vec3(0.0f);
+		};
+		std::vector< DrawableBounds > drawable_bounds;
+		std::vector< uint32_t > unbounded_drawables; //drawables with empty boxes (never culled, not in drawable_bvh)
+
+		size_t size() const { return transform.size(); }
+	};
+	mutable TransformStreams streams;
+
+	//(Re-)build 'streams' from 'transforms':
+	// happens automatically (in update_world_matrices()) when transforms are added, removed, or re-parented
+	// throws if the hierarchy contains a cycle
+	void pack_transforms() const;
+
+	//Refresh the world matrices of every transform in one linear pass over 'streams':
+	// (only transforms that moved -- or whose ancestors moved -- are recomputed, using the batched TransformKernels;
+	//  their caches are updated as well)
+	// afterward, streams.world_from_local holds every world matrix in the scene
+	// this is the only place Transform caches are written: call it after moving things and before reading
+	//  world matrices (draw(), load(), and interpolate_transforms() call it themselves), on one thread at a time
+	// large scenes are split into root subtrees, updated in parallel on WorkerPool::get() (with identical results)
+	void update_world_matrices() const;
+
+	//scenes with at least this many transforms update on multiple threads (-1U to never do so, 0 to always):
+	// this is a manual tuning knob, not derived from anything -- below it, handing work to other threads
+	// cost more than it saved in 'scene-bench transforms' runs (which time both paths; re-run it to re-tune)
+	uint32_t parallel_min_transforms = 8192;
+
+	//Look up transforms by name:
+	// find returns the first transform (in 'transforms' order) with the given name, or nullptr if there isn't one
+	// find_all returns all transforms whose names start with 'prefix' (sorted by name, then 'transforms' order)
+	Transform *find(std::string_view name);
+	Transform const *find(std::string_view name) const;
+	std::vector< Transform * > find_all(std::string_view prefix);
+	std::vector< Transform const * > find_all(std::string_view prefix) const;
+
+	//The index behind find() is built on first use and rebuilt automatically when transforms are added;
+	// call this after renaming (or removing) transforms:
+	void rebuild_name_index() const;
+
+	struct NameIndex {
+		size_t transform_count = -1; //size of 'transforms' when the index was built (-1 if not built)
+		std::vector< std::pair< std::string_view, Transform * > > sorted; //every named transform, sorted by name
+		std::vector< uint32_t > slots; //open addressing (linear probing) over distinct names: first index in 'sorted', or -1U
+	};
+	mutable NameIndex name_index;
+
+	//world matrix of drawables[d]'s transform (after update_world_matrices()):
+	glm::mat4x3 const &drawable_world_from_local(size_t d) const;
+
+	//Bounding volume hierarchy over drawables' world-space boxes (item d is drawables[d]):
+	// update_drawable_bvh() brings it up to date, recomputing boxes only for drawables that moved;
+	// gameplay code can use it for its own queries (call update_drawable_bvh() first).
+	// drawables without bounds (see Drawable::min/max) are not in the tree
+	mutable BVH drawable_bvh;
+	void update_drawable_bvh() const;
+
+	//Render interpolation, for modes that update at a fixed timestep (see Mode::fixed_timestep):
+	// save_previous_transforms() -- call before each update step -- remembers every transform's position/rotation/scale;
+	// interpolate_transforms(alpha) -- call before drawing -- moves transforms that changed since then to
+	//   mix(previous, current, alpha) (slerp for rotations), and restore_transforms() -- call after drawing -- puts them back.
+	//   (both bring world matrices up to date with the values they leave in place)
+	// (saved state is forgotten if transforms are added or removed after saving; copies of a scene don't copy it)
+	void save_previous_transforms();
+	void interpolate_transforms(float alpha);
+	void restore_transforms();
+
+	struct TransformHistory {
+		std::vector< Transform * > transform; //as of the last save
+		std::vector< glm::vec3 > position; //previous values, per transform
+		std::vector< glm::quat > rotation;
+		std::vector< glm::vec3 > scale;
+		std::vector< uint32_t > blended; //entries moved by interpolate_transforms()
+		std::vector< glm::vec3 > current_position; //their real values, per 'blended' entry
+		std::vector< glm::quat > current_rotation;
+		std::vector< glm::vec3 > current_scale;
+		uint32_t generation = 0; //streams.generation as of the last save
+	};
+	TransformHistory history;
+
+	//draw() culls with drawable_bvh in scenes with at least this many drawables:
+	// (for fewer, a linear pass over every drawable is quicker than keeping the tree up to date)
+	uint32_t bvh_threshold = 256;
+
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
+	// (drawables outside the view frustum are skipped before any GL calls are made for them;
+	//  the rest are sorted by program, vertex array, textures, and then front-to-back, and state is only set when it changes;
+	//  drawables that can be instanced are sorted by mesh instead of depth, and each run of one mesh is a single draw call)
 	void draw(Camera const &camera) const;
 
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world = glm::mat4x3(1.0f)) const;
 
+	//Light sent (with the camera) in the Frame uniform block by draw():
+	// (this is the light LitColorTextureProgram shades with)
+	struct FrameLight {
+		enum Type : int32_t { Point = 0, Hemisphere = 1, Spot = 2, Directional = 3 } type = Hemisphere;
+		glm::vec3 location = glm::vec3(0.0f); //in light space
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f,-1.0f); //in light space
+		glm::vec3 energy = glm::vec3(1.0f);
+		float cutoff = 0.0f; //(spot) cosine of the cone's half-angle
+	} frame_light;
+
+	//set to false to draw everything regardless of view (e.g., when clip_from_world isn't a camera):
+	bool frustum_culling = true;
+
+	//draw() uses Pipeline::instanced_program for runs of at least this many otherwise-identical drawables (-1U to never do so):
+	uint32_t instancing_threshold = 2;
+
+	//Instanced programs read per-instance matrices from a GL_TEXTURE_BUFFER (GL_RGBA32F) bound to this texture unit:
+	// instance i is texels [6*i, 6*i+6): three rows of world_from_object then three rows of world_from_normal,
+	// where world_from_normal = inverse(transpose(mat3(world_from_object))); see LitColorTextureProgram for a reader.
+	enum : uint32_t { InstanceTextureUnit = Drawable::Pipeline::TextureCount, InstanceTexels = 6 };
+
+	//statistics from the most recent draw() call:
+	struct DrawCounters {
+		uint32_t tested = 0; //drawables tested against the view frustum
+		uint32_t culled = 0; //...and skipped because they were outside it
+		uint32_t bvh_nodes = 0; //drawable_bvh nodes visited while culling (0 if culling was linear)
+		uint32_t draws = 0; //draw calls issued
+		uint32_t programs = 0; //glUseProgram calls (those gl_state didn't skip, as for the next two)
+		uint32_t vaos = 0; //glBindVertexArray calls
+		uint32_t textures = 0; //glBindTexture calls
+		uint32_t instanced_draws = 0; //...of 'draws', instanced draw calls
+		uint32_t instances = 0; //drawables drawn by instanced draw calls
+		uint32_t triangles = 0; //triangles drawn (GL_TRIANGLES pipelines only; counting every instance)
+	};
+	mutable DrawCounters counters;
+
+	//scratch space for draw():
+	mutable Frustum::Boxes drawable_boxes;
+	mutable std::vector< uint8_t > drawable_visible;
+	struct QueueEntry {
+		uint64_t key; //GL state and depth (see draw())
+		uint32_t drawable; //index in 'drawables'
+	};
+	mutable std::vector< QueueEntry > render_queue, render_queue_scratch;
+	struct Batch {
+		uint32_t begin, end; //range of render_queue
+		uint32_t instance_base; //index of first instance in instance_data, or -1U if not instanced
+		uint32_t object; //index of first Object uniform block in object_data (one per draw)
+	};
+	mutable std::vector< Batch > render_batches;
+	mutable std::vector< glm::vec4 > instance_data; //InstanceTexels per instance
+	mutable std::vector< uint8_t > object_data; //UniformBlocks::Object per draw, UniformBlocks::object_stride() apart
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
 	// throws on file format errors
+	// (world matrices are up to date afterward)
 	void load(std::string const &filename,
 		std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable = nullptr
 	);
@@ -146,8 +410,11 @@ struct Scene {
 	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
 
 	//copy a scene (with proper pointer fixup):
+	// pointers are fixed up through stream indices, and streams/cached matrices are copied in bulk,
+	// so the copy starts with up-to-date world matrices and doesn't need re-packing
 	Scene(Scene const &); //...as a constructor
 	Scene &operator=(Scene const &); //...as scene = scene
 	//... as a set() function that optionally returns the transform->transform mapping:
+	// (the mapping is only built when asked for)
 	void set(Scene const &, std::unordered_map< Transform const *, Transform * > *transform_map = nullptr);
 };
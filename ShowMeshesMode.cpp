@@ -2,6 +2,7 @@
 
 #include "ShowMeshesProgram.hpp"
 #include "DrawLines.hpp"
+#include "GLState.hpp"
 
 #include <iostream>
 
@@ -114,13 +115,14 @@ void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 	scene_camera->transform->position = camera.target + camera.radius * (scene_camera->transform->rotation * glm::vec3(0.0f, 0.0f, 1.0f));
 	scene_camera->transform->scale = glm::vec3(1.0f);
 	scene_camera->aspect = float(drawable_size.x) / float(drawable_size.y);
+	scene.update_world_matrices();
 
 
 	//--- actual drawing ---
-	glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
+	gl_state.clear_color(glm::vec4(0.5f, 0.5f, 0.5f, 0.0f));
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
+	gl_state.disable(GL_BLEND);
+	gl_state.enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
 	scene.draw(*scene_camera);
@@ -19,11 +19,10 @@ struct ShowMeshesProgram {
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
 
-	//Uniform (per-invocation variable) locations:
-	GLuint CLIP_FROM_OBJECT_mat4 = -1U;
-	GLuint LIGHT_FROM_OBJECT_mat4x3 = -1U;
-	GLuint LIGHT_FROM_NORMAL_mat3 = -1U;
+	//Uniforms:
+	//Object block - CLIP_FROM_OBJECT, LIGHT_FROM_OBJECT, LIGHT_FROM_NORMAL (see UniformBlocks.hpp)
 
+	//Uniform (per-invocation variable) locations:
 	GLuint INSPECT_MODE_int = -1U; //0: basic lighting; 1: position only; 2: normal only; 3: color only; 4: texcoord only
 
 	//Textures:
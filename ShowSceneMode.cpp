@@ -1,5 +1,6 @@
 #include "ShowSceneMode.hpp"
 #include "DrawLines.hpp"
+#include "GLState.hpp"
 
 #include <iostream>
 
@@ -61,6 +62,13 @@ bool ShowSceneMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_
 			return true;
 		}
 	}
+	//'B': toggle static batches
+	if (evt.type == SDL_EVENT_KEY_DOWN && evt.key.key == SDLK_B && !evt.key.repeat) {
+		if (static_batches) {
+			static_batches->set_enabled(!static_batches->enabled);
+			return true;
+		}
+	}
 	//mouse wheel: dolly
 	if (evt.type == SDL_EVENT_MOUSE_WHEEL) {
 		camera.radius *= std::pow(0.5f, 0.1f * evt.wheel.y);
@@ -82,13 +90,14 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 	scene_camera->transform->position = camera.target + camera.radius * (scene_camera->transform->rotation * glm::vec3(0.0f, 0.0f, 1.0f));
 	scene_camera->transform->scale = glm::vec3(1.0f);
 	scene_camera->aspect = float(drawable_size.x) / float(drawable_size.y);
+	camera_scene.update_world_matrices();
 
 
 	//--- actual drawing ---
-	glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
+	gl_state.clear_color(glm::vec4(0.5f, 0.5f, 0.5f, 0.0f));
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
+	gl_state.disable(GL_BLEND);
+	gl_state.enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
 	scene.draw(*scene_camera);
@@ -121,7 +130,7 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 			draw_lines.draw(xf(glm::vec3(0.0f)), xf(glm::vec3(0.0f, 0.0f, -len)), glm::u8vec4(0x00, 0x00, 0x88, 0xff));
 
 			//transform name:
-			draw_lines.draw_text("'" + transform.name + "'",
+			draw_lines.draw_text("'" + std::string(transform.name) + "'",
 				xf(glm::vec3(0.05f, 0.0f, 0.05f)),
 				0.15f * xfd(glm::vec3(1.0f, 0.0f, 0.0f)),
 				0.15f * xfd(glm::vec3(0.0f, 0.0f, 1.0f)),
@@ -136,4 +145,49 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 		*/
 	}
 
+	{ //statistics from scene.draw():
+		gl_state.disable(GL_DEPTH_TEST);
+		float aspect = float(drawable_size.x) / float(drawable_size.y);
+		DrawLines lines(glm::mat4(
+			1.0f / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		));
+
+		constexpr float H = 0.05f;
+		lines.draw_text("drawables: " + std::to_string(scene.drawables.size())
+			+ "  tested: " + std::to_string(scene.counters.tested)
+			+ "  culled: " + std::to_string(scene.counters.culled),
+			glm::vec3(-aspect + 0.5f * H, 1.0f - 1.5f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+		lines.draw_text("draws: " + std::to_string(scene.counters.draws)
+			+ "  programs: " + std::to_string(scene.counters.programs)
+			+ "  vaos: " + std::to_string(scene.counters.vaos)
+			+ "  textures: " + std::to_string(scene.counters.textures),
+			glm::vec3(-aspect + 0.5f * H, 1.0f - 3.0f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+		lines.draw_text("instanced draws: " + std::to_string(scene.counters.instanced_draws)
+			+ "  instances: " + std::to_string(scene.counters.instances),
+			glm::vec3(-aspect + 0.5f * H, 1.0f - 4.5f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+		lines.draw_text("gl state calls: " + std::to_string(gl_state.last_frame.calls)
+			+ "  elided: " + std::to_string(gl_state.last_frame.elided),
+			glm::vec3(-aspect + 0.5f * H, 1.0f - 6.0f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+		if (static_batches) {
+			lines.draw_text("static batches ('B'): " + std::string(static_batches->enabled ? "on" : "off")
+				+ "  baked: " + std::to_string(static_batches->baked)
+				+ "  batches: " + std::to_string(static_batches->batches),
+				glm::vec3(-aspect + 0.5f * H, 1.0f - 7.5f * H, 0.0f),
+				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+				glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+		}
+		gl_state.enable(GL_DEPTH_TEST);
+	}
+
 }
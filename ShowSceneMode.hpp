@@ -10,6 +10,7 @@
 #include "Mode.hpp"
 #include "Scene.hpp"
 #include "Mesh.hpp"
+#include "StaticBatches.hpp"
 
 struct ShowSceneMode : Mode {
 	ShowSceneMode(Scene const &scene);
@@ -30,6 +31,9 @@ struct ShowSceneMode : Mode {
 	//Scene being viewed:
 	Scene const &scene;
 
+	//(optional) static batches baked into 'scene'; 'B' toggles them so draw counts can be compared:
+	StaticBatches *static_batches = nullptr;
+
 	//mode uses a secondary Scene to hold a camera:
 	Scene camera_scene;
 	Scene::Camera *scene_camera = nullptr;
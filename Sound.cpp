@@ -1,6 +1,7 @@
 #include "Sound.hpp"
 #include "load_wav.hpp"
 #include "load_opus.hpp"
+#include "Profiler.hpp"
 
 #include <SDL3/SDL.h>
 
@@ -38,6 +39,7 @@ void mix_audio(void *, SDL_AudioStream *stream, int additional_amount, int total
 //------------------------ public-facing --------------------------------
 
 Sound::Sample::Sample(std::string const &filename) {
+	PROFILE_SCOPE("Sound::Sample load");
 	if (filename.size() >= 4 && filename.substr(filename.size()-4) == ".wav") {
 		load_wav(filename, &data);
 	} else if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".opus") {
@@ -303,6 +305,8 @@ void step_direction_ramp(float step, Sound::Ramp< glm::vec3 > &ramp) {
 //The audio callback -- invoked by SDL when it needs more sound to play:
 void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount, int total_amount) {
 	if (total_amount <= 0) return;
+	Profiler::name_thread("audio");
+	PROFILE_SCOPE("mix_audio");
 	assert(stream_ == stream && "callback should only be used with our main stream");
 
 	struct LR {
@@ -434,6 +438,8 @@ void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount,
 
 	SDL_PutAudioStreamData(stream, buffer_, len);
 	SDL_stack_free(buffer_);
+
+	PROFILE_COUNTER("audio voices", playing_samples.size());
 }
 
 
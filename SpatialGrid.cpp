@@ -0,0 +1,130 @@
+#include "SpatialGrid.hpp"
+
+#include <stdexcept>
+#include <string>
+
+SpatialGrid::SpatialGrid(float cell_size_) : cell_size(cell_size_), inv_cell_size(1.0f / cell_size_) {
+	if (!(cell_size > 0.0f)) {
+		throw std::runtime_error("SpatialGrid cell size must be positive (got " + std::to_string(cell_size) + ").");
+	}
+	buckets.assign(64, -1U);
+}
+
+uint32_t SpatialGrid::insert(Scene::Transform const *transform) {
+	assert(transform);
+
+	uint32_t id;
+	if (!free_ids.empty()) {
+		id = free_ids.back();
+		free_ids.pop_back();
+	} else {
+		id = uint32_t(transforms.size());
+		transforms.emplace_back(nullptr);
+		versions.emplace_back(0);
+		positions.emplace_back(0.0f);
+		cells.emplace_back(0);
+		next.emplace_back(-1U);
+		prev.emplace_back(-1U);
+	}
+
+	transforms[id] = transform;
+	versions[id] = transform->world_version();
+	positions[id] = transform->make_world_from_local()[3];
+	cells[id] = cell_of(positions[id]);
+	live += 1;
+
+	if (live > buckets.size()) {
+		rehash(uint32_t(buckets.size()) * 2);
+	} else {
+		link(id);
+	}
+	return id;
+}
+
+void SpatialGrid::remove(uint32_t id) {
+	assert(id < transforms.size() && transforms[id]);
+	unlink(id);
+	transforms[id] = nullptr;
+	free_ids.emplace_back(id);
+	live -= 1;
+}
+
+void SpatialGrid::update() {
+	relinked = 0;
+	for (uint32_t id = 0; id < transforms.size(); ++id) {
+		Scene::Transform const *transform = transforms[id];
+		if (!transform) continue;
+
+		uint32_t version = transform->world_version();
+		if (version == versions[id]) continue;
+		versions[id] = version;
+
+		positions[id] = transform->make_world_from_local()[3];
+		glm::ivec3 cell = cell_of(positions[id]);
+		if (cell == cells[id]) continue;
+
+		unlink(id);
+		cells[id] = cell;
+		link(id);
+		relinked += 1;
+	}
+}
+
+void SpatialGrid::link(uint32_t id) {
+	uint32_t &head = buckets[bucket_of(cells[id])];
+	prev[id] = -1U;
+	next[id] = head;
+	if (head != -1U) prev[head] = id;
+	head = id;
+}
+
+void SpatialGrid::unlink(uint32_t id) {
+	if (prev[id] != -1U) next[prev[id]] = next[id];
+	else buckets[bucket_of(cells[id])] = next[id];
+	if (next[id] != -1U) prev[next[id]] = prev[id];
+	prev[id] = next[id] = -1U;
+}
+
+void SpatialGrid::rehash(uint32_t bucket_count) {
+	assert((bucket_count & (bucket_count - 1)) == 0);
+	buckets.assign(bucket_count, -1U);
+	for (uint32_t id = 0; id < transforms.size(); ++id) {
+		if (transforms[id]) link(id);
+	}
+}
+
+void SpatialGrid::in_radius(glm::vec3 const &center, float radius, std::vector< uint32_t > *ids) const {
+	assert(ids);
+	ids->clear();
+	for_each_in_radius(center, radius, [&](uint32_t id, float) {
+		ids->emplace_back(id);
+	});
+}
+
+void SpatialGrid::nearest(glm::vec3 const &center, uint32_t k, std::vector< uint32_t > *ids, uint32_t exclude, float max_radius) const {
+	assert(ids);
+	ids->clear();
+	uint32_t available = live - ((exclude < transforms.size() && transforms[exclude]) ? 1 : 0);
+	k = std::min(k, available);
+	if (k == 0) return;
+
+	//search ever-larger spheres until one holds k items (everything within a sphere is found, so its k nearest are the answer):
+	std::vector< std::pair< float, uint32_t > > found;
+	float radius = cell_size;
+	while (true) {
+		radius = std::min(radius, max_radius);
+		found.clear();
+		for_each_in_radius(center, radius, [&](uint32_t id, float distance2) {
+			if (id != exclude) found.emplace_back(distance2, id);
+		});
+		if (found.size() >= k || radius >= max_radius) break;
+		//(grow faster when the sphere was nearly empty)
+		radius *= (found.empty() ? 4.0f : 2.0f);
+	}
+
+	k = std::min(k, uint32_t(found.size()));
+	std::partial_sort(found.begin(), found.begin() + k, found.end());
+	for (uint32_t i = 0; i < k; ++i) {
+		ids->emplace_back(found[i].second);
+	}
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+/*
+ * SpatialGrid is a spatial hash of points -- the world positions of Scene::Transforms --
+ * for neighborhood and perception queries among many moving agents:
+ *
+ * SpatialGrid grid(4.0f); //cell size (about the typical query radius works well)
+ * uint32_t id = grid.insert(transform);
+ *
+ * //each frame, after moving things (and updating their scene's world matrices):
+ * grid.update();
+ *
+ * grid.for_each_in_radius(center, radius, [&](uint32_t id, float distance2) { ... });
+ * grid.nearest(center, k, &ids);
+ * grid.for_each_in_cone(eye, forward, std::cos(half_fov), range, [&](uint32_t id, float distance2) { ... });
+ *
+ * Space is divided into cubical cells, and cells are hashed into a fixed number of buckets
+ * (so the world doesn't need bounds); each bucket is a linked list of the items in it.
+ * update() only re-reads transforms whose world matrix changed, and only relinks items that changed cells.
+ *
+ */
+
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+struct SpatialGrid {
+	SpatialGrid(float cell_size = 4.0f);
+
+	//--- items ---
+
+	//start tracking a transform's world position; returns its id:
+	// (ids of removed items are re-used)
+	uint32_t insert(Scene::Transform const *transform);
+	void remove(uint32_t id);
+
+	//bring positions up to date with the transforms:
+	void update();
+
+	uint32_t size() const { return live; }
+	Scene::Transform const *transform(uint32_t id) const { return transforms[id]; }
+	glm::vec3 const &position(uint32_t id) const { return positions[id]; } //(as of the last update() or insert())
+
+	//--- queries ---
+
+	//fn(id, distance2) for every item within 'radius' of 'center':
+	template< typename F >
+	void for_each_in_radius(glm::vec3 const &center, float radius, F &&fn) const;
+
+	//the ids of items within 'radius' of 'center' (in no particular order):
+	void in_radius(glm::vec3 const &center, float radius, std::vector< uint32_t > *ids) const;
+
+	//the ids of the 'k' items nearest 'center' (nearest first), ignoring item 'exclude' and anything past 'max_radius':
+	void nearest(glm::vec3 const &center, uint32_t k, std::vector< uint32_t > *ids,
+		uint32_t exclude = -1U, float max_radius = std::numeric_limits< float >::infinity()) const;
+
+	//fn(id, distance2) for every item within 'range' of 'apex' and within the cone around 'direction' (unit length)
+	// whose half-angle has cosine 'cos_half_angle':
+	// (an item exactly at 'apex' is not in the cone)
+	template< typename F >
+	void for_each_in_cone(glm::vec3 const &apex, glm::vec3 const &direction, float cos_half_angle, float range, F &&fn) const;
+
+	//--- statistics ---
+
+	uint32_t relinked = 0; //items that changed cells during the last update()
+	mutable uint32_t cells_visited = 0; //running count of cells looked at by queries (reset it whenever you like)
+
+	//--- internals ---
+
+	float cell_size;
+	float inv_cell_size;
+
+	//per item (structure-of-arrays):
+	std::vector< Scene::Transform const * > transforms; //nullptr => free
+	std::vector< uint32_t > versions; //transform's world_version() when 'positions' was read
+	std::vector< glm::vec3 > positions;
+	std::vector< glm::ivec3 > cells;
+	std::vector< uint32_t > next, prev; //neighbors in bucket list (-1U at ends)
+	std::vector< uint32_t > free_ids;
+	uint32_t live = 0;
+
+	//bucket heads (power-of-two count, grown to keep about one item per bucket):
+	std::vector< uint32_t > buckets;
+
+	glm::ivec3 cell_of(glm::vec3 const &position) const {
+		return glm::ivec3(glm::floor(position * inv_cell_size));
+	}
+	uint32_t bucket_of(glm::ivec3 const &cell) const {
+		uint32_t h = (uint32_t(cell.x) * 73856093U) ^ (uint32_t(cell.y) * 19349663U) ^ (uint32_t(cell.z) * 83492791U);
+		return h & uint32_t(buckets.size() - 1);
+	}
+	void link(uint32_t id);
+	void unlink(uint32_t id);
+	void rehash(uint32_t bucket_count);
+};
+
+//----------------------------
+//query implementations:
+
+template< typename F >
+void SpatialGrid::for_each_in_radius(glm::vec3 const &center, float radius, F &&fn) const {
+	if (live == 0 || !(radius >= 0.0f)) return;
+	float radius2 = radius * radius;
+	auto test = [&](uint32_t id) {
+		glm::vec3 d = positions[id] - center;
+		float distance2 = d.x * d.x + d.y * d.y + d.z * d.z;
+		if (distance2 <= radius2) fn(id, distance2);
+	};
+
+	//(range computed in floating point first, since huge radii don't fit in cell coordinates)
+	glm::vec3 lo_f = glm::floor((center - glm::vec3(radius)) * inv_cell_size);
+	glm::vec3 hi_f = glm::floor((center + glm::vec3(radius)) * inv_cell_size);
+	float cell_count = (hi_f.x - lo_f.x + 1.0f) * (hi_f.y - lo_f.y + 1.0f) * (hi_f.z - lo_f.z + 1.0f);
+
+	//big queries are cheaper as a scan over all items:
+	if (!(cell_count <= float(transforms.size()))) {
+		for (uint32_t id = 0; id < transforms.size(); ++id) {
+			if (transforms[id]) test(id);
+		}
+		return;
+	}
+
+	glm::ivec3 lo = glm::ivec3(lo_f), hi = glm::ivec3(hi_f);
+	for (int32_t z = lo.z; z <= hi.z; ++z) {
+		for (int32_t y = lo.y; y <= hi.y; ++y) {
+			for (int32_t x = lo.x; x <= hi.x; ++x) {
+				glm::ivec3 cell(x, y, z);
+				cells_visited += 1;
+				for (uint32_t id = buckets[bucket_of(cell)]; id != -1U; id = next[id]) {
+					//(buckets are shared by every cell that hashes to them)
+					if (cells[id] == cell) test(id);
+				}
+			}
+		}
+	}
+}
+
+template< typename F >
+void SpatialGrid::for_each_in_cone(glm::vec3 const &apex, glm::vec3 const &direction, float cos_half_angle, float range, F &&fn) const {
+	for_each_in_radius(apex, range, [&](uint32_t id, float distance2) {
+		if (distance2 == 0.0f) return;
+		glm::vec3 d = positions[id] - apex;
+		float along = d.x * direction.x + d.y * direction.y + d.z * direction.z;
+		//along / |d| >= cos_half_angle, without a square root (x * |x| keeps the order of x):
+		if (along * std::abs(along) >= cos_half_angle * std::abs(cos_half_angle) * distance2) {
+			fn(id, distance2);
+		}
+	});
+}
@@ -0,0 +1,175 @@
+#include "StaticBatches.hpp"
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+
+StaticBatches::StaticBatches(Scene &scene_, MeshBuffer const &source, GLuint source_vao,
+	std::function< bool(Scene::Drawable const &) > const &is_static,
+	float region_size) : scene(scene_) {
+
+	if (!(region_size > 0.0f)) {
+		throw std::runtime_error("Static batch region size must be positive (got " + std::to_string(region_size) + ").");
+	}
+
+	//drawables that can be merged share everything but their transform and vertex range:
+	struct Key {
+		GLuint program;
+		GLuint instanced_program;
+		GLenum type;
+		Scene::Drawable::Pipeline::TextureInfo textures[Scene::Drawable::Pipeline::TextureCount];
+		glm::ivec3 region;
+
+		auto tie() const {
+			return std::tie(program, instanced_program, type,
+				textures[0].texture, textures[0].target, textures[1].texture, textures[1].target,
+				textures[2].texture, textures[2].target, textures[3].texture, textures[3].target,
+				region.x, region.y, region.z);
+		}
+		bool operator<(Key const &o) const { return tie() < o.tie(); }
+	};
+	static_assert(Scene::Drawable::Pipeline::TextureCount == 4, "Key::tie() lists every texture.");
+
+	std::map< Key, std::vector< uint32_t > > groups; //(std::map, so batch order doesn't depend on pointer values)
+
+	for (uint32_t i = 0; i < scene.drawables.size(); ++i) {
+		Scene::Drawable const &drawable = scene.drawables[i];
+		auto const &pipeline = drawable.pipeline;
+		if (pipeline.program != 0 && pipeline.count != 0) draws_before += 1;
+
+		if (pipeline.program == 0 || pipeline.count == 0) continue;
+		if (pipeline.vao != source_vao) continue;
+		//only primitive types that can be concatenated:
+		if (!(pipeline.type == GL_TRIANGLES || pipeline.type == GL_LINES || pipeline.type == GL_POINTS)) continue;
+		//per-drawable uniforms can't be merged:
+		if (!pipeline.uniforms.empty()) continue;
+		if (!(pipeline.start <= source.vertices.size() && pipeline.count <= source.vertices.size() - pipeline.start)) {
+			throw std::runtime_error("Drawable '" + std::string(drawable.transform->name) + "' draws vertices outside its mesh buffer.");
+		}
+		if (!is_static(drawable)) continue;
+
+		//region from the center of the drawable's world-space box (or its origin if it has no box):
+		glm::mat4x3 world_from_local = drawable.transform->make_world_from_local();
+		glm::vec3 center = world_from_local[3];
+		if (drawable.min.x <= drawable.max.x) {
+			center = world_from_local * glm::vec4(0.5f * (drawable.min + drawable.max), 1.0f);
+		}
+
+		Key key;
+		key.program = pipeline.program;
+		key.instanced_program = pipeline.instanced_program;
+		key.type = pipeline.type;
+		std::copy(pipeline.textures, pipeline.textures + Scene::Drawable::Pipeline::TextureCount, key.textures);
+		key.region = glm::ivec3(glm::floor(center / region_size));
+
+		groups[key].emplace_back(i);
+	}
+
+	//a batch of one drawable would just be a copy:
+	for (auto gi = groups.begin(); gi != groups.end(); ) {
+		if (gi->second.size() < 2) gi = groups.erase(gi);
+		else ++gi;
+	}
+
+	if (groups.empty()) {
+		draws_after = draws_before;
+		return;
+	}
+
+	//transform vertices into merged storage:
+	std::vector< MeshBuffer::Vertex > vertices;
+	std::map< std::string, Mesh > meshes;
+	std::vector< std::pair< Key const *, Mesh const * > > made;
+	for (auto const &[key, members] : groups) {
+		Mesh mesh;
+		mesh.type = key.type;
+		mesh.start = GLuint(vertices.size());
+		for (uint32_t i : members) {
+			Scene::Drawable const &drawable = scene.drawables[i];
+			glm::mat4x3 world_from_local = drawable.transform->make_world_from_local();
+			//n.b. not re-normalized, since the shader will normalize the transformed normal (as it would have before baking):
+			glm::mat3 world_from_normal = glm::inverse(glm::transpose(glm::mat3(world_from_local)));
+
+			auto begin = source.vertices.begin() + drawable.pipeline.start;
+			for (auto v = begin; v != begin + drawable.pipeline.count; ++v) {
+				MeshBuffer::Vertex vertex = *v;
+				vertex.Position = world_from_local * glm::vec4(v->Position, 1.0f);
+				vertex.Normal = world_from_normal * v->Normal;
+				mesh.min = glm::min(mesh.min, vertex.Position);
+				mesh.max = glm::max(mesh.max, vertex.Position);
+				vertices.emplace_back(vertex);
+			}
+		}
+		mesh.count = GLuint(vertices.size()) - mesh.start;
+
+		auto ret = meshes.emplace("static batch " + std::to_string(made.size()), mesh);
+		made.emplace_back(&key, &ret.first->second);
+	}
+
+	buffer = std::make_unique< MeshBuffer >(std::move(vertices), std::move(meshes));
+
+	//add one drawable per batch:
+	scene.transforms.emplace_back();
+	Scene::Transform *transform = &scene.transforms.back();
+	transform->name = scene.intern("static batch");
+
+	for (auto const &[key, mesh] : made) {
+		std::vector< uint32_t > const &members = groups.at(*key);
+		Scene::Drawable drawable(transform);
+		drawable.pipeline = scene.drawables[members[0]].pipeline;
+
+		auto vao = vaos.find(key->program);
+		if (vao == vaos.end()) {
+			vao = vaos.emplace(key->program, buffer->make_vao_for_program(key->program)).first;
+		}
+		drawable.pipeline.vao = vao->second;
+		drawable.pipeline.start = mesh->start;
+		drawable.pipeline.count = mesh->count;
+		drawable.min = mesh->min;
+		drawable.max = mesh->max;
+
+		merged.emplace_back(Swap{uint32_t(scene.drawables.size()), key->program});
+		scene.drawables.emplace_back(drawable);
+
+		for (uint32_t i : members) {
+			originals.emplace_back(Swap{i, scene.drawables[i].pipeline.program});
+			scene.drawables[i].pipeline.program = 0;
+		}
+	}
+
+	baked = uint32_t(originals.size());
+	batches = uint32_t(merged.size());
+	draws_after = draws_before - baked + batches;
+}
+
+StaticBatches::~StaticBatches() {
+	for (auto const &[program, vao] : vaos) {
+		glDeleteVertexArrays(1, &vao);
+	}
+	if (buffer) glDeleteBuffers(1, &buffer->buffer);
+	gl_state.invalidate(); //(in case any of those were bound)
+}
+
+void StaticBatches::set_enabled(bool enabled_) {
+	if (enabled == enabled_) return;
+	enabled = enabled_;
+	for (Swap const &swap : originals) {
+		scene.drawables[swap.drawable].pipeline.program = (enabled ? 0 : swap.program);
+	}
+	for (Swap const &swap : merged) {
+		scene.drawables[swap.drawable].pipeline.program = (enabled ? swap.program : 0);
+	}
+}
+
+std::function< bool(Scene::Drawable const &) > StaticBatches::except_under(std::vector< std::string > const &prefixes) {
+	return [prefixes](Scene::Drawable const &drawable) {
+		for (Scene::Transform const *t = drawable.transform; t != nullptr; t = t->parent) {
+			for (std::string const &prefix : prefixes) {
+				if (t->name.substr(0, prefix.size()) == prefix) return false;
+			}
+		}
+		return true;
+	};
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * StaticBatches bakes drawables that never move into a few large world-space meshes:
+ *
+ * StaticBatches *batches = new StaticBatches(scene, *meshes, meshes_vao,
+ *     StaticBatches::except_under({"Player", "Enemy"}));
+ *
+ * Static drawables that draw from 'meshes' through 'meshes_vao' are grouped by
+ * program, textures, primitive type, and region (a cube of world space 'region_size' on a side).
+ * Each group's vertices are transformed to world space and copied into one MeshBuffer,
+ * and a single drawable (on a new, identity transform named "static batch") draws the group.
+ *
+ * The original drawables stay in the scene -- with pipeline.program = 0, so draw() skips them --
+ * which keeps their per-object bounding boxes in Scene::drawable_bvh for gameplay queries.
+ *
+ * The baked buffers belong to the StaticBatches object, so it must outlive the scene (and copies of it).
+ *
+ */
+
+#include "Scene.hpp"
+#include "Mesh.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+
+struct StaticBatches {
+	//is_static: should this drawable be baked? (only drawables that use source_vao and have no extra uniforms are considered)
+	StaticBatches(Scene &scene, MeshBuffer const &source, GLuint source_vao,
+		std::function< bool(Scene::Drawable const &) > const &is_static,
+		float region_size = 20.0f);
+	~StaticBatches();
+
+	//predicate that accepts drawables unless their transform (or one of its parents) has a name starting with one of 'prefixes':
+	static std::function< bool(Scene::Drawable const &) > except_under(std::vector< std::string > const &prefixes);
+
+	//switch between drawing the batches (true, the default) and the original drawables (false):
+	// (only affects the scene passed to the constructor)
+	void set_enabled(bool enabled);
+	bool enabled = true;
+
+	//counts for reporting:
+	uint32_t baked = 0; //drawables merged into batches
+	uint32_t batches = 0; //drawables that draw them
+	uint32_t draws_before = 0; //drawables with something to draw before baking (i.e., draw calls with nothing culled or instanced)
+	uint32_t draws_after = 0; //...and after
+
+	//--- internals ---
+	Scene &scene;
+	std::unique_ptr< MeshBuffer > buffer; //merged world-space vertices (one "mesh" per batch)
+	std::map< GLuint, GLuint > vaos; //program -> vao for 'buffer'
+
+	struct Swap {
+		uint32_t drawable; //index in scene.drawables
+		GLuint program; //its program when drawn
+	};
+	std::vector< Swap > originals; //baked drawables
+	std::vector< Swap > merged; //batch drawables
+};
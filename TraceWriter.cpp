@@ -0,0 +1,179 @@
+#include "TraceWriter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+TraceWriter::TraceWriter(uint32_t capacity_) : ring(new Event[std::max(1U, capacity_)]), capacity(std::max(1U, capacity_)) {
+}
+
+TraceWriter::~TraceWriter() {
+	finish();
+}
+
+void TraceWriter::start(std::string const &filename_, float seconds) {
+	finish();
+
+	file.open(filename_, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open trace file '" + filename_ + "'.");
+	filename = filename_;
+
+	written = 0;
+	read = 0;
+	dropped = 0;
+	named_lanes = 0;
+	finishing = false;
+	end_time = Profiler::get().now() + uint64_t(std::max(0.0f, seconds) * 1e9f);
+	active = true;
+
+	Event gpu;
+	gpu.kind = Event::ThreadName;
+	gpu.tid = GPUThread;
+	gpu.name = "GPU";
+	gpu.time = 0;
+	gpu.duration = 0;
+	push(gpu);
+
+	writer = std::thread([this]() { write_events(); });
+	std::cout << "Capturing " << seconds << " seconds of trace to '" << filename << "'." << std::endl;
+}
+
+void TraceWriter::stop() {
+	if (!active) return;
+	active = false;
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		finishing = true;
+	}
+	wake.notify_one();
+}
+
+void TraceWriter::finish() {
+	stop();
+	if (writer.joinable()) writer.join();
+}
+
+void TraceWriter::push(Event const &event) {
+	uint64_t w = written.load(std::memory_order_relaxed);
+	if (w - read.load(std::memory_order_acquire) >= capacity) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	ring[w % capacity] = event;
+	written.store(w + 1, std::memory_order_release);
+}
+
+void TraceWriter::add_frame(Profiler const &profiler) {
+	if (!active) return;
+	Profiler::Frame const &frame = profiler.frame;
+
+	Event event;
+	for (; named_lanes < profiler.lanes.size(); ++named_lanes) {
+		event.kind = Event::ThreadName;
+		event.tid = named_lanes;
+		event.name = profiler.lanes[named_lanes].name;
+		event.time = 0;
+		event.duration = 0;
+		push(event);
+	}
+
+	for (Profiler::Scope const &scope : frame.scopes) {
+		event.kind = Event::Scope;
+		event.tid = scope.lane;
+		event.name = scope.name;
+		event.time = scope.begin;
+		event.duration = scope.end - scope.begin;
+		push(event);
+	}
+
+	for (Profiler::Counter const &counter : frame.counters) {
+		event.kind = Event::Counter;
+		event.tid = counter.lane;
+		event.name = counter.name;
+		event.time = counter.time;
+		event.value = counter.value;
+		push(event);
+	}
+
+	if (frame.gpu_new) {
+		for (Profiler::Scope const &scope : frame.gpu_scopes) {
+			event.kind = Event::Scope;
+			event.tid = GPUThread;
+			event.name = scope.name;
+			event.time = uint64_t(std::max< int64_t >(0, int64_t(scope.begin) + frame.gpu_to_cpu));
+			event.duration = scope.end - scope.begin;
+			push(event);
+		}
+	}
+
+	if (frame.end >= end_time) stop();
+}
+
+//copy 'name' into 'out' as the inside of a JSON string:
+static void escape(char const *name, char *out, size_t size) {
+	size_t o = 0;
+	for (char const *c = name; *c && o + 7 < size; ++c) {
+		unsigned char ch = static_cast< unsigned char >(*c);
+		if (ch == '"' || ch == '\\') {
+			out[o++] = '\\';
+			out[o++] = char(ch);
+		} else if (ch < 0x20) {
+			o += size_t(std::snprintf(out + o, size - o, "\\u%04x", ch));
+		} else {
+			out[o++] = char(ch);
+		}
+	}
+	out[o] = '\0';
+}
+
+void TraceWriter::write_events() {
+	//(the Chrome trace format: an object holding an array of events; timestamps in microseconds)
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+	uint64_t count = 0;
+
+	char name[256];
+	char line[512];
+	while (true) {
+		bool done;
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			wake.wait_for(lock, std::chrono::milliseconds(20), [this]() {
+				return finishing || read.load(std::memory_order_relaxed) != written.load(std::memory_order_relaxed);
+			});
+			done = finishing;
+		}
+
+		uint64_t w = written.load(std::memory_order_acquire);
+		for (uint64_t r = read.load(std::memory_order_relaxed); r < w; ++r) {
+			Event const &event = ring[r % capacity];
+			escape(event.name, name, sizeof(name));
+			int length = 0;
+			if (event.kind == Event::Scope) {
+				length = std::snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					name, event.tid, double(event.time) * 1e-3, double(event.duration) * 1e-3);
+			} else if (event.kind == Event::Counter) {
+				length = std::snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%.17g}}",
+					name, event.tid, double(event.time) * 1e-3, event.value);
+			} else {
+				length = std::snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+					event.tid, name);
+			}
+			if (!first) file.write(",\n", 2);
+			first = false;
+			file.write(line, std::min(std::max(length, 0), int(sizeof(line)) - 1));
+			count += 1;
+		}
+		read.store(w, std::memory_order_release);
+
+		//(stop() is only called after the last push, so everything is in once 'finishing' is seen)
+		if (done) break;
+	}
+
+	uint32_t lost = dropped.load(std::memory_order_relaxed);
+	file << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":\"" << lost << "\"}}\n";
+	file.close();
+	std::cout << "Saved trace '" << filename << "' (" << count << " events" << (lost ? ", " + std::to_string(lost) + " dropped" : std::string()) << ")." << std::endl;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+ * TraceWriter saves a few seconds of Profiler timeline -- CPU and GPU scopes, counters, and thread names --
+ * as a Chrome trace (JSON) file, for inspecting in chrome://tracing or ui.perfetto.dev:
+ *
+ * TraceWriter trace;
+ * trace.start("trace.json", 5.0f); //capture the next five seconds
+ *
+ * //each frame, after Profiler::get().next_frame():
+ * trace.add_frame(Profiler::get());
+ *
+ * add_frame() copies the frame's events into a fixed-size ring (allocated up front, so capturing never allocates
+ * on the game's thread); a background thread formats them and streams them to the file. If the writer falls
+ * behind and the ring fills up, events are dropped (and counted in the file's metadata) rather than waiting.
+ *
+ * GPU scopes are shifted onto the CPU clock (see Profiler::Frame::gpu_to_cpu) and shown as a "GPU" thread.
+ *
+ */
+
+#include "Profiler.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+struct TraceWriter {
+	//capacity: events that can wait for the writer thread at once
+	TraceWriter(uint32_t capacity = 1 << 16);
+	~TraceWriter(); //ends any capture (and waits for its file to be finished)
+
+	TraceWriter(TraceWriter const &) = delete;
+	TraceWriter &operator=(TraceWriter const &) = delete;
+
+	//begin capturing frames to 'filename' for 'seconds' (throws if the file can't be opened):
+	// (any earlier capture is finished first)
+	void start(std::string const &filename, float seconds);
+	//end the capture early (the file is finished in the background):
+	void stop();
+	bool capturing() const { return active; }
+
+	//copy the profiler's last frame into the capture (call once per frame, after Profiler::next_frame):
+	void add_frame(Profiler const &profiler);
+
+	//--- internals ---
+
+	struct Event {
+		enum Kind : uint8_t { Scope, Counter, ThreadName } kind;
+		uint32_t tid;
+		char const *name;
+		uint64_t time; //nanoseconds (Profiler::now() clock)
+		union {
+			uint64_t duration; //Scope
+			double value; //Counter
+		};
+	};
+	std::unique_ptr< Event[] > ring;
+	uint32_t capacity;
+	std::atomic< uint64_t > written{0}, read{0};
+	std::atomic< uint32_t > dropped{0};
+	void push(Event const &event);
+
+	bool active = false;
+	uint64_t end_time = 0; //Profiler::now() at which the capture stops
+	uint32_t named_lanes = 0; //thread names sent so far
+	enum : uint32_t { GPUThread = 1000 }; //tid of GPU scopes
+
+	std::string filename;
+	std::ofstream file;
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool finishing = false; //(guarded by mutex)
+	void write_events(); //writer thread
+	void finish(); //stop and wait for the writer thread
+};
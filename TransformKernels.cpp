@@ -0,0 +1,236 @@
+#include "TransformKernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define TRANSFORM_KERNELS_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define TARGET_AVX2
+	#else
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+static_assert(sizeof(glm::vec3) == 3*4, "vec3 is packed.");
+static_assert(sizeof(glm::quat) == 4*4, "quat is packed.");
+static_assert(sizeof(glm::mat4x3) == 4*3*4, "mat4x3 is packed.");
+
+//-------------------------
+//scalar kernels -- identical to Scene::Transform's per-transform math:
+
+static void scalar_trs_to_mat4x3(size_t count, glm::vec3 const *position, glm::quat const *rotation, glm::vec3 const *scale, glm::mat4x3 *parent_from_local) {
+	for (size_t i = 0; i < count; ++i) {
+		glm::mat3 rot = glm::mat3_cast(rotation[i]);
+		parent_from_local[i] = glm::mat4x3(
+			rot[0] * scale[i].x,
+			rot[1] * scale[i].y,
+			rot[2] * scale[i].z,
+			position[i]
+		);
+	}
+}
+
+static void scalar_propagate(uint32_t begin, uint32_t end, uint32_t const *parent, glm::mat4x3 *matrices) {
+	for (uint32_t i = begin; i < end; ++i) {
+		if (parent[i] == -1U) continue;
+		matrices[i] = matrices[parent[i]] * glm::mat4(matrices[i]); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+	}
+}
+
+static TransformKernels const scalar_kernels{ "scalar", scalar_trs_to_mat4x3, scalar_propagate };
+
+#ifdef TRANSFORM_KERNELS_X86
+
+//-------------------------
+//helpers to move between array-of-structures and structure-of-arrays layouts:
+
+//three consecutive vec3's starting at 'v' (i.e., 4 vectors) -> x, y, z registers:
+static inline void load4_vec3(float const *v, __m128 &x, __m128 &y, __m128 &z) {
+	__m128 a = _mm_loadu_ps(v + 0); //x0 y0 z0 x1
+	__m128 b = _mm_loadu_ps(v + 4); //y1 z1 x2 y2
+	__m128 c = _mm_loadu_ps(v + 8); //z2 x3 y3 z3
+	x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1,1,2,2)), _MM_SHUFFLE(2,0,3,0));
+	y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,1,1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2,2,3,3)), _MM_SHUFFLE(2,0,2,0));
+	z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1,1,2,2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3,3,0,0)), _MM_SHUFFLE(2,0,2,0));
+}
+
+//four consecutive quats starting at 'q' -> x, y, z, w registers (glm stores quats as xyzw):
+static inline void load4_quat(float const *q, __m128 &x, __m128 &y, __m128 &z, __m128 &w) {
+	x = _mm_loadu_ps(q + 0);
+	y = _mm_loadu_ps(q + 4);
+	z = _mm_loadu_ps(q + 8);
+	w = _mm_loadu_ps(q + 12);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+}
+
+//twelve registers holding the (column-major) elements of four matrices -> four consecutive mat4x3's at 'm':
+static inline void store4_mat4x3(float *m, __m128 const (&e)[12]) {
+	__m128 a0 = e[0], a1 = e[1], a2 = e[2], a3 = e[3];
+	__m128 b0 = e[4], b1 = e[5], b2 = e[6], b3 = e[7];
+	__m128 c0 = e[8], c1 = e[9], c2 = e[10], c3 = e[11];
+	_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+	_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	_mm_storeu_ps(m +  0, a0); _mm_storeu_ps(m +  4, b0); _mm_storeu_ps(m +  8, c0);
+	_mm_storeu_ps(m + 12, a1); _mm_storeu_ps(m + 16, b1); _mm_storeu_ps(m + 20, c1);
+	_mm_storeu_ps(m + 24, a2); _mm_storeu_ps(m + 28, b2); _mm_storeu_ps(m + 32, c2);
+	_mm_storeu_ps(m + 36, a3); _mm_storeu_ps(m + 40, b3); _mm_storeu_ps(m + 44, c3);
+}
+
+//-------------------------
+//SSE2 kernels:
+
+//the same arithmetic as glm::mat3_cast + column scaling, four transforms at once:
+#define TRS_TO_MAT4X3_BODY(V, SET1, ADD, SUB, MUL) \
+	V one = SET1(1.0f), two = SET1(2.0f); \
+	V qxx = MUL(qx, qx), qyy = MUL(qy, qy), qzz = MUL(qz, qz); \
+	V qxz = MUL(qx, qz), qxy = MUL(qx, qy), qyz = MUL(qy, qz); \
+	V qwx = MUL(qw, qx), qwy = MUL(qw, qy), qwz = MUL(qw, qz); \
+	e[0]  = MUL(SUB(one, MUL(two, ADD(qyy, qzz))), sx); \
+	e[1]  = MUL(MUL(two, ADD(qxy, qwz)), sx); \
+	e[2]  = MUL(MUL(two, SUB(qxz, qwy)), sx); \
+	e[3]  = MUL(MUL(two, SUB(qxy, qwz)), sy); \
+	e[4]  = MUL(SUB(one, MUL(two, ADD(qxx, qzz))), sy); \
+	e[5]  = MUL(MUL(two, ADD(qyz, qwx)), sy); \
+	e[6]  = MUL(MUL(two, ADD(qxz, qwy)), sz); \
+	e[7]  = MUL(MUL(two, SUB(qyz, qwx)), sz); \
+	e[8]  = MUL(SUB(one, MUL(two, ADD(qxx, qyy))), sz); \
+	e[9]  = px; \
+	e[10] = py; \
+	e[11] = pz;
+
+static void sse2_trs_to_mat4x3(size_t count, glm::vec3 const *position, glm::quat const *rotation, glm::vec3 const *scale, glm::mat4x3 *parent_from_local) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 px, py, pz, qx, qy, qz, qw, sx, sy, sz;
+		load4_vec3(&position[i].x, px, py, pz);
+		load4_quat(&rotation[i].x, qx, qy, qz, qw);
+		load4_vec3(&scale[i].x, sx, sy, sz);
+
+		__m128 e[12];
+		TRS_TO_MAT4X3_BODY(__m128, _mm_set1_ps, _mm_add_ps, _mm_sub_ps, _mm_mul_ps)
+
+		store4_mat4x3(&parent_from_local[i][0][0], e);
+	}
+	//leftovers:
+	scalar_trs_to_mat4x3(count - i, position + i, rotation + i, scale + i, parent_from_local + i);
+}
+
+//world = parent_world * [local; 0 0 0 1], one column of the result per register:
+// (adds are done in the same order as glm's mat4x3 * mat4 so results match exactly)
+static inline void sse2_propagate_one(float const *w, float *m) {
+	__m128 w0 = _mm_loadu_ps(w + 0); //(lane 3 of each column is junk)
+	__m128 w1 = _mm_loadu_ps(w + 3);
+	__m128 w2 = _mm_loadu_ps(w + 6);
+	__m128 w3 = _mm_shuffle_ps(_mm_loadu_ps(w + 8), _mm_loadu_ps(w + 8), _MM_SHUFFLE(0,3,2,1));
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+
+	__m128 r[4];
+	for (uint32_t c = 0; c < 4; ++c) {
+		__m128 sum = _mm_mul_ps(w0, _mm_set1_ps(m[3*c+0]));
+		sum = _mm_add_ps(sum, _mm_mul_ps(w1, _mm_set1_ps(m[3*c+1])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(w2, _mm_set1_ps(m[3*c+2])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(w3, (c == 3 ? one : zero)));
+		r[c] = sum;
+	}
+
+	//pack the four 3-element columns back into twelve consecutive floats:
+	__m128 o0 = _mm_shuffle_ps(r[0], _mm_shuffle_ps(r[0], r[1], _MM_SHUFFLE(0,0,2,2)), _MM_SHUFFLE(2,0,1,0));
+	__m128 o1 = _mm_shuffle_ps(r[1], r[2], _MM_SHUFFLE(1,0,2,1));
+	__m128 o2 = _mm_shuffle_ps(_mm_shuffle_ps(r[2], r[3], _MM_SHUFFLE(0,0,2,2)), r[3], _MM_SHUFFLE(2,1,2,0));
+	_mm_storeu_ps(m + 0, o0);
+	_mm_storeu_ps(m + 4, o1);
+	_mm_storeu_ps(m + 8, o2);
+}
+
+static void sse2_propagate(uint32_t begin, uint32_t end, uint32_t const *parent, glm::mat4x3 *matrices) {
+	for (uint32_t i = begin; i < end; ++i) {
+		if (parent[i] == -1U) continue;
+		sse2_propagate_one(&matrices[parent[i]][0][0], &matrices[i][0][0]);
+	}
+}
+
+static TransformKernels const sse2_kernels{ "sse2", sse2_trs_to_mat4x3, sse2_propagate };
+
+//-------------------------
+//AVX2 kernels:
+
+TARGET_AVX2 static void avx2_trs_to_mat4x3(size_t count, glm::vec3 const *position, glm::quat const *rotation, glm::vec3 const *scale, glm::mat4x3 *parent_from_local) {
+	__m256i const stride3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	__m256i const stride4 = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		float const *p = &position[i].x;
+		float const *q = &rotation[i].x;
+		float const *s = &scale[i].x;
+		__m256 px = _mm256_i32gather_ps(p + 0, stride3, 4);
+		__m256 py = _mm256_i32gather_ps(p + 1, stride3, 4);
+		__m256 pz = _mm256_i32gather_ps(p + 2, stride3, 4);
+		__m256 qx = _mm256_i32gather_ps(q + 0, stride4, 4);
+		__m256 qy = _mm256_i32gather_ps(q + 1, stride4, 4);
+		__m256 qz = _mm256_i32gather_ps(q + 2, stride4, 4);
+		__m256 qw = _mm256_i32gather_ps(q + 3, stride4, 4);
+		__m256 sx = _mm256_i32gather_ps(s + 0, stride3, 4);
+		__m256 sy = _mm256_i32gather_ps(s + 1, stride3, 4);
+		__m256 sz = _mm256_i32gather_ps(s + 2, stride3, 4);
+
+		__m256 e[12];
+		TRS_TO_MAT4X3_BODY(__m256, _mm256_set1_ps, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps)
+
+		//write out as two groups of four:
+		__m128 lo[12], hi[12];
+		for (uint32_t k = 0; k < 12; ++k) {
+			lo[k] = _mm256_castps256_ps128(e[k]);
+			hi[k] = _mm256_extractf128_ps(e[k], 1);
+		}
+		store4_mat4x3(&parent_from_local[i][0][0], lo);
+		store4_mat4x3(&parent_from_local[i+4][0][0], hi);
+	}
+	//leftovers:
+	sse2_trs_to_mat4x3(count - i, position + i, rotation + i, scale + i, parent_from_local + i);
+}
+
+//propagation is a chain of dependent 3x4 products, so wider registers don't help; AVX2 uses the SSE2 version:
+static TransformKernels const avx2_kernels{ "avx2", avx2_trs_to_mat4x3, sse2_propagate };
+
+#undef TRS_TO_MAT4X3_BODY
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!(osxsave && avx)) return false;
+	if ((_xgetbv(0) & 0x6) != 0x6) return false; //OS must save ymm registers
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif //TRANSFORM_KERNELS_X86
+
+//-------------------------
+
+TransformKernels const &TransformKernels::get() {
+	static TransformKernels const &best = *available().back();
+	return best;
+}
+
+std::vector< TransformKernels const * > TransformKernels::available() {
+	std::vector< TransformKernels const * > ret;
+	ret.emplace_back(&scalar_kernels);
+#ifdef TRANSFORM_KERNELS_X86
+	ret.emplace_back(&sse2_kernels); //(every x86-64 CPU has SSE2)
+	if (cpu_has_avx2()) ret.emplace_back(&avx2_kernels);
+#endif
+	return ret;
+}
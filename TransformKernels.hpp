@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+ * TransformKernels are batched versions of the per-transform matrix math in Scene:
+ *  - trs_to_mat4x3 converts arrays of (position, rotation, scale) to parent-from-local matrices
+ *  - propagate multiplies each matrix by its parent's world-from-local matrix
+ *
+ * Implementations exist for SSE2 and AVX2 (on x86-64) and as plain scalar code;
+ * the best one supported by the running CPU is selected at runtime by TransformKernels::get().
+ *
+ * All implementations perform the same floating point operations in the same order
+ * as Scene::Transform::make_parent_from_local() / make_world_from_local(),
+ * so they produce identical results.
+ *
+ */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct TransformKernels {
+	char const *name; //"scalar", "sse2", or "avx2"
+
+	//parent_from_local[i] = translate(position[i]) * rotate(rotation[i]) * scale(scale[i]) for i in [0,count):
+	void (*trs_to_mat4x3)(size_t count, glm::vec3 const *position, glm::quat const *rotation, glm::vec3 const *scale, glm::mat4x3 *parent_from_local);
+
+	//in place: on entry matrices[i] holds parent_from_local, on exit world_from_local, for i in [begin,end):
+	// parent[i] is the index of i's parent (-1U for roots, which are left unchanged)
+	// parents must come before their children (parent[i] < i); parents outside [begin,end) must already be world_from_local
+	void (*propagate)(uint32_t begin, uint32_t end, uint32_t const *parent, glm::mat4x3 *matrices);
+
+	//the best kernels for this CPU:
+	static TransformKernels const &get();
+
+	//every implementation this CPU can run (useful for benchmarking):
+	static std::vector< TransformKernels const * > available();
+};
@@ -0,0 +1,102 @@
+#include "UniformBlocks.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+//n.b. declared static so they don't conflict with similarly named global variables elsewhere:
+static GLuint frame_buffer = 0;
+static GLuint object_buffer = 0;
+static GLsizeiptr object_capacity = 0; //size of object_buffer's current storage
+static GLsizeiptr object_head = 0; //where the next stream_objects() call writes
+
+//the ring is at least this big, so most frames fit many times over before it is replaced:
+static constexpr GLsizeiptr MinObjectCapacity = 1 << 20;
+
+static void set_columns(glm::vec4 *columns, glm::mat4x3 const &m) {
+	for (uint32_t c = 0; c < 4; ++c) columns[c] = glm::vec4(m[c], 0.0f);
+}
+
+static void set_columns(glm::vec4 *columns, glm::mat3 const &m) {
+	for (uint32_t c = 0; c < 3; ++c) columns[c] = glm::vec4(m[c], 0.0f);
+}
+
+void UniformBlocks::Frame::set_light_from_world(glm::mat4x3 const &light_from_world) {
+	set_columns(LIGHT_FROM_WORLD, light_from_world);
+	set_columns(LIGHT_FROM_WORLD_NORMAL, glm::inverse(glm::transpose(glm::mat3(light_from_world))));
+}
+
+void UniformBlocks::Object::set(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world, glm::mat4x3 const &world_from_object) {
+	//CLIP_FROM_OBJECT takes vertices from object space to clip space:
+	CLIP_FROM_OBJECT = clip_from_world * glm::mat4(world_from_object);
+
+	//LIGHT_FROM_OBJECT takes vertices from object space to light space:
+	glm::mat4x3 light_from_object = light_from_world * glm::mat4(world_from_object);
+	set_columns(LIGHT_FROM_OBJECT, light_from_object);
+
+	//LIGHT_FROM_NORMAL takes normals from object space to light space:
+	set_columns(LIGHT_FROM_NORMAL, glm::inverse(glm::transpose(glm::mat3(light_from_object))));
+}
+
+void UniformBlocks::Object::set(glm::mat4 const &clip_from_object) {
+	CLIP_FROM_OBJECT = clip_from_object;
+	set_columns(LIGHT_FROM_OBJECT, glm::mat4x3(1.0f));
+	set_columns(LIGHT_FROM_NORMAL, glm::mat3(1.0f));
+}
+
+void UniformBlocks::bind_blocks(GLuint program) {
+	GLuint frame = glGetUniformBlockIndex(program, "Frame");
+	if (frame != GL_INVALID_INDEX) glUniformBlockBinding(program, frame, FrameBinding);
+	GLuint object = glGetUniformBlockIndex(program, "Object");
+	if (object != GL_INVALID_INDEX) glUniformBlockBinding(program, object, ObjectBinding);
+}
+
+void UniformBlocks::set_frame(Frame const &frame) {
+	if (frame_buffer == 0) glGenBuffers(1, &frame_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer);
+	//(re-specifying the whole buffer gives it fresh storage, so this doesn't wait on last frame's draws)
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), &frame, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameBinding, frame_buffer);
+}
+
+uint32_t UniformBlocks::object_stride() {
+	static uint32_t stride = [](){
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = std::max(alignment, GLint(1));
+		return uint32_t((sizeof(Object) + alignment - 1) / alignment * alignment);
+	}();
+	return stride;
+}
+
+GLintptr UniformBlocks::stream_objects(void const *data, GLsizeiptr size) {
+	if (object_buffer == 0) glGenBuffers(1, &object_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, object_buffer);
+
+	if (object_head + size > object_capacity) {
+		//out of room -- start over in fresh storage (the old storage lives on until draws reading it are done):
+		object_capacity = std::max(object_capacity, std::max(MinObjectCapacity, 2 * size));
+		glBufferData(GL_UNIFORM_BUFFER, object_capacity, nullptr, GL_STREAM_DRAW);
+		object_head = 0;
+	}
+
+	//nothing the GPU might be reading has been written since the storage was last replaced, so no need to synchronize:
+	GLintptr offset = object_head;
+	void *dst = glMapBufferRange(GL_UNIFORM_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!dst) {
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		throw std::runtime_error("Failed to map uniform buffer for streaming.");
+	}
+	std::memcpy(dst, data, size_t(size));
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	GLsizeiptr stride = object_stride();
+	object_head = (offset + size + stride - 1) / stride * stride;
+	return offset;
+}
+
+void UniformBlocks::bind_object(GLintptr offset) {
+	glBindBufferRange(GL_UNIFORM_BUFFER, ObjectBinding, object_buffer, offset, sizeof(Object));
+}
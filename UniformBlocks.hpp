@@ -0,0 +1,96 @@
+#pragma once
+
+/*
+ * Uniform blocks shared by the shader programs in this code (std140 layout):
+ *
+ *  - 'Frame' holds per-frame camera and light constants;
+ *    it is uploaded once per Scene::draw() and bound to FrameBinding.
+ *  - 'Object' holds per-draw constants;
+ *    blocks for many draws are streamed into one buffer and each draw only binds its range to ObjectBinding.
+ *
+ * Programs paste UniformBlocks::FrameGLSL / ObjectGLSL into their shader source
+ * and call UniformBlocks::bind_blocks(program) after linking.
+ *
+ * The structs below mirror the GLSL declarations byte-for-byte
+ * (std140 pads every matrix column -- and every vec3 -- to 16 bytes).
+ *
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+struct UniformBlocks {
+	enum : GLuint {
+		FrameBinding = 0,
+		ObjectBinding = 1,
+	};
+
+	static constexpr char const *FrameGLSL =
+		"layout(std140) uniform Frame {\n"
+		"	mat4 CLIP_FROM_WORLD;\n"
+		"	mat4x3 LIGHT_FROM_WORLD;\n"
+		"	mat3 LIGHT_FROM_WORLD_NORMAL;\n"
+		"	vec3 LIGHT_LOCATION;\n"
+		"	int LIGHT_TYPE;\n" //0: point, 1: hemisphere, 2: spot, 3: directional
+		"	vec3 LIGHT_DIRECTION;\n"
+		"	float LIGHT_CUTOFF;\n"
+		"	vec3 LIGHT_ENERGY;\n"
+		"};\n";
+
+	struct Frame {
+		glm::mat4 CLIP_FROM_WORLD = glm::mat4(1.0f);
+		glm::vec4 LIGHT_FROM_WORLD[4]; //columns
+		glm::vec4 LIGHT_FROM_WORLD_NORMAL[3]; //columns
+		glm::vec3 LIGHT_LOCATION = glm::vec3(0.0f);
+		int32_t LIGHT_TYPE = 1;
+		glm::vec3 LIGHT_DIRECTION = glm::vec3(0.0f, 0.0f,-1.0f);
+		float LIGHT_CUTOFF = 0.0f;
+		glm::vec3 LIGHT_ENERGY = glm::vec3(1.0f);
+		float padding_ = 0.0f;
+
+		//sets LIGHT_FROM_WORLD and LIGHT_FROM_WORLD_NORMAL:
+		void set_light_from_world(glm::mat4x3 const &light_from_world);
+	};
+	static_assert(sizeof(Frame) == 224, "Frame matches std140 layout.");
+
+	static constexpr char const *ObjectGLSL =
+		"layout(std140) uniform Object {\n"
+		"	mat4 CLIP_FROM_OBJECT;\n"
+		"	mat4x3 LIGHT_FROM_OBJECT;\n"
+		"	mat3 LIGHT_FROM_NORMAL;\n"
+		"	int INSTANCE_BASE;\n" //(instanced programs) index of the first instance in the instance buffer
+		"};\n";
+
+	struct Object {
+		glm::mat4 CLIP_FROM_OBJECT = glm::mat4(1.0f);
+		glm::vec4 LIGHT_FROM_OBJECT[4]; //columns
+		glm::vec4 LIGHT_FROM_NORMAL[3]; //columns
+		int32_t INSTANCE_BASE = 0;
+		int32_t padding_[3] = {0, 0, 0};
+
+		//sets all three matrices:
+		void set(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world, glm::mat4x3 const &world_from_object);
+		//sets CLIP_FROM_OBJECT only (the others become identity):
+		void set(glm::mat4 const &clip_from_object);
+	};
+	static_assert(sizeof(Object) == 192, "Object matches std140 layout.");
+
+	//attach whichever of the blocks 'program' uses to their binding points:
+	static void bind_blocks(GLuint program);
+
+	//upload 'frame' and bind it to FrameBinding:
+	static void set_frame(Frame const &frame);
+
+	//distance between consecutive Objects in a stream (sizeof(Object) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT):
+	static uint32_t object_stride();
+
+	//copy 'size' bytes of Objects (spaced object_stride() apart) into the object ring buffer; returns their offset:
+	// (the ring is written without waiting on the GPU -- when it fills up, it is replaced with fresh storage)
+	static GLintptr stream_objects(void const *data, GLsizeiptr size);
+
+	//bind the Object at 'offset' (as returned by stream_objects(), plus multiples of object_stride()) to ObjectBinding:
+	static void bind_object(GLintptr offset);
+};
@@ -0,0 +1,134 @@
+#include "WorkerPool.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <iostream>
+
+WorkerPool::WorkerPool(uint32_t count) {
+	threads.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		threads.emplace_back([this]() {
+			Profiler::name_thread("worker");
+			std::unique_lock< std::mutex > lock(mutex);
+			while (true) {
+				wake.wait(lock, [this]() { return quit || !jobs.empty(); });
+				if (jobs.empty()) break; //(quit, and nothing left to do)
+				std::function< void() > job = std::move(jobs.front());
+				jobs.pop_front();
+				lock.unlock();
+				{
+					PROFILE_SCOPE("WorkerPool job");
+					job();
+				}
+				lock.lock();
+			}
+		});
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::parallel_for(uint32_t count, std::function< void(uint32_t) > const &fn) {
+	if (count == 0) return;
+	if (count == 1 || threads.empty()) {
+		for (uint32_t i = 0; i < count; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	//state shared with helper jobs, which might only get to run after this call returns:
+	struct Shared {
+		std::function< void(uint32_t) > const *fn;
+		uint32_t count;
+		std::atomic< uint32_t > next{0}; //next index to claim
+		std::atomic< uint32_t > finished{0}; //indices whose calls have returned
+		std::mutex mutex;
+		std::condition_variable done;
+		std::exception_ptr exception;
+
+		//claim and run indices until none are left:
+		void work() {
+			while (true) {
+				uint32_t i = next.fetch_add(1);
+				if (i >= count) return;
+				try {
+					(*fn)(i);
+				} catch (...) {
+					std::unique_lock< std::mutex > lock(mutex);
+					if (!exception) exception = std::current_exception();
+				}
+				if (finished.fetch_add(1) + 1 == count) {
+					std::unique_lock< std::mutex > lock(mutex);
+					done.notify_all();
+				}
+			}
+		}
+	};
+	auto shared = std::make_shared< Shared >();
+	shared->fn = &fn;
+	shared->count = count;
+
+	//one helper per worker (no more than there are indices beyond the caller's first):
+	uint32_t helpers = std::min(uint32_t(threads.size()), count - 1);
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		for (uint32_t h = 0; h < helpers; ++h) {
+			jobs.emplace_back([shared]() { shared->work(); });
+		}
+	}
+	if (helpers == 1) wake.notify_one();
+	else wake.notify_all();
+
+	shared->work();
+
+	{
+		std::unique_lock< std::mutex > lock(shared->mutex);
+		shared->done.wait(lock, [&]() { return shared->finished.load() == count; });
+	}
+
+	if (shared->exception) std::rethrow_exception(shared->exception);
+}
+
+void WorkerPool::run(std::function< void() > const &job) {
+	auto guarded = [job]() {
+		try {
+			job();
+		} catch (std::exception const &e) {
+			std::cerr << "Background job threw: " << e.what() << std::endl;
+		} catch (...) {
+			std::cerr << "Background job threw (unknown type)." << std::endl;
+		}
+	};
+
+	if (threads.empty()) {
+		guarded();
+		return;
+	}
+
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		jobs.emplace_back(guarded);
+	}
+	wake.notify_one();
+}
+
+WorkerPool &WorkerPool::get() {
+	static WorkerPool pool([]() -> uint32_t {
+		uint32_t hardware = std::thread::hardware_concurrency();
+		return (hardware > 1 ? hardware - 1 : 0);
+	}());
+	return pool;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+ * WorkerPool is a small pool of threads for splitting CPU-heavy per-frame work across cores.
+ *
+ * //split work over the shared pool:
+ * WorkerPool::get().parallel_for(chunks, [&](uint32_t chunk) {
+ *     //...process chunk...
+ * });
+ *
+ * The calling thread takes part in the work, so parallel_for is safe to call from
+ * inside a job (and still makes progress if every worker is busy).
+ *
+ * //or run something in the background:
+ * WorkerPool::get().run([result]() {
+ *     //...fill in result...
+ * });
+ *
+ */
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+struct WorkerPool {
+	//threads: number of worker threads to start (in addition to the calling thread)
+	WorkerPool(uint32_t threads);
+	~WorkerPool();
+
+	WorkerPool(WorkerPool const &) = delete;
+	WorkerPool &operator=(WorkerPool const &) = delete;
+
+	//call fn(i) for every i in [0,count), returning once all calls have finished:
+	// (calls happen in no particular order and on any thread, including the caller's)
+	// if any call throws, the first exception is re-thrown here after the rest finish
+	void parallel_for(uint32_t count, std::function< void(uint32_t) > const &fn);
+
+	//queue 'job' to run on some worker thread, returning immediately:
+	// (with no worker threads, 'job' runs before this returns)
+	// exceptions thrown by 'job' are printed and otherwise ignored
+	void run(std::function< void() > const &job);
+
+	//number of worker threads (not counting the caller):
+	uint32_t size() const { return uint32_t(threads.size()); }
+
+	//shared pool with one worker per additional hardware thread:
+	// (started on first use; may have zero workers on single-core machines)
+	static WorkerPool &get();
+
+private:
+	std::vector< std::thread > threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque< std::function< void() > > jobs;
+	bool quit = false;
+};
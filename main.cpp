@@ -12,10 +12,19 @@
 
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
+#include "GLState.hpp"
+#include "gl_errors.hpp"
 
 //for screenshots:
 #include "load_save_png.hpp"
 
+//for recording and replaying sessions:
+#include "InputLog.hpp"
+
+//for timing scopes and the profiler overlay:
+#include "Profiler.hpp"
+#include "TraceWriter.hpp"
+
 //Includes for libSDL:
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
@@ -26,6 +35,35 @@
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+//input for --bench without a recorded session: 60fps, walking a loop (W, D, S, A) for 'frames' frames:
+static InputLog make_bench_script(uint32_t frames, glm::uvec2 const &window_size) {
+	static SDL_Keycode const keys[4] = { SDLK_W, SDLK_D, SDLK_S, SDLK_A };
+	constexpr uint32_t FramesPerKey = 90;
+
+	InputLog script;
+	for (uint32_t f = 0; f < frames; ++f) {
+		script.begin_frame(window_size);
+		if (f % FramesPerKey == 0) {
+			SDL_Event evt;
+			std::memset(&evt, 0, sizeof(evt));
+			if (f != 0) {
+				evt.type = SDL_EVENT_KEY_UP;
+				evt.key.key = keys[(f / FramesPerKey + 3) % 4];
+				script.add_event(evt);
+			}
+			evt.type = SDL_EVENT_KEY_DOWN;
+			evt.key.key = keys[(f / FramesPerKey) % 4];
+			evt.key.down = true;
+			script.add_event(evt);
+		}
+		script.end_frame(1.0f / 60.0f, 0.0f, 0.0f);
+	}
+	script.timings.clear(); //(no timings of its own)
+	return script;
+}
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -46,8 +84,69 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command line ------------
+
+	//--record <file> saves this session's input (and frame timings) when the game exits;
+	//--replay <file> plays a recorded session back instead of taking input, then prints its frame timings
+	//  (and, with --timings <file>, saves a copy of the log holding this run's timings, to compare builds);
+	//--bench <frames> runs that many frames headless -- hidden window, offscreen framebuffer, no vsync --
+	//  with a built-in input script (or the first frames of --replay <file>), then prints frame timings.
+	//  (draw timings include waiting for the GPU to finish; SDL_VIDEO_DRIVER / SDL_AUDIO_DRIVER override the
+	//   "offscreen" / "dummy" drivers used by default, e.g., LIBGL_ALWAYS_SOFTWARE=1 for Mesa's software rasterizer)
+	std::string record_file, replay_file, timings_file;
+	uint32_t bench_frames = 0;
+	{
+		bool usage = false;
+		for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if (arg == "--record" && i + 1 < argc) record_file = argv[++i];
+			else if (arg == "--replay" && i + 1 < argc) replay_file = argv[++i];
+			else if (arg == "--timings" && i + 1 < argc) timings_file = argv[++i];
+			else if (arg == "--bench" && i + 1 < argc) {
+				char *end = nullptr;
+				long frames = std::strtol(argv[++i], &end, 10);
+				if (*end != '\0' || frames <= 0) usage = true;
+				else bench_frames = uint32_t(std::min(frames, 10000000L));
+			}
+			else usage = true;
+		}
+		if (!record_file.empty() && (!replay_file.empty() || bench_frames)) usage = true;
+		if (!timings_file.empty() && replay_file.empty() && !bench_frames) usage = true;
+		if (usage) {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--record <file> | --replay <file> | --bench <frames> [--replay <file>]] [--timings <file>]" << std::endl;
+			return 1;
+		}
+	}
+
+	bool bench = (bench_frames != 0);
+	glm::uvec2 const bench_size = glm::uvec2(1280, 720);
+
+	std::unique_ptr< InputLog > recording, replay;
+	std::vector< InputLog::Timing > replay_timings;
+	if (!record_file.empty()) recording = std::make_unique< InputLog >();
+	if (!replay_file.empty()) replay = std::make_unique< InputLog >(replay_file);
+	if (bench) {
+		if (!replay) replay = std::make_unique< InputLog >(make_bench_script(bench_frames, bench_size));
+		if (replay->frames.size() > bench_frames) {
+			replay->frames.resize(bench_frames);
+			if (!replay->timings.empty()) replay->timings.resize(bench_frames);
+		} else if (replay->frames.size() < bench_frames) {
+			std::cout << "NOTE: '" << replay_file << "' only has " << replay->frames.size() << " frames to benchmark." << std::endl;
+		}
+	}
+	Mode::deterministic = (recording || replay);
+
+	//headless: render offscreen, and don't need an audio device:
+	// (SDL_SetHint leaves environment variables in charge)
+	if (bench) {
+		SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+		SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+	}
+
 	//------------  initialization ------------
 
+	Profiler::name_thread("main");
+
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -70,7 +169,7 @@ int main(int argc, char **argv) {
 		"Zoo Escape", //TODO: remember to set a title for your game!
 		1280, 720, //TODO: modify window size if you'd like
 		SDL_WINDOW_OPENGL
-		| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
+		| (bench ? SDL_WINDOW_HIDDEN : SDL_WINDOW_RESIZABLE) //uncomment to allow resizing (benchmarks stay hidden)
 		| SDL_WINDOW_HIGH_PIXEL_DENSITY //uncomment for full resolution on high-DPI screens
 	);
 
@@ -95,7 +194,10 @@ int main(int argc, char **argv) {
 	init_GL();
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (!SDL_GL_SetSwapInterval(-1)) {
+	if (bench) {
+		//(benchmarks run as fast as they can)
+		SDL_GL_SetSwapInterval(0);
+	} else if (!SDL_GL_SetSwapInterval(-1)) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
 		if (!SDL_GL_SetSwapInterval(1)) {
 			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
@@ -134,24 +236,59 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	//benchmarks draw into a framebuffer of their own (a hidden/offscreen window may not have a usable one):
+	GLuint bench_framebuffer = 0;
+	GLuint bench_renderbuffers[2] = {0, 0};
+	if (bench) {
+		window_size = drawable_size = bench_size;
+		glGenRenderbuffers(2, bench_renderbuffers);
+		glBindRenderbuffer(GL_RENDERBUFFER, bench_renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, bench_size.x, bench_size.y);
+		glBindRenderbuffer(GL_RENDERBUFFER, bench_renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, bench_size.x, bench_size.y);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &bench_framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, bench_framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, bench_renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, bench_renderbuffers[1]);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Benchmark framebuffer is incomplete.");
+		}
+		//(left bound: nothing else in the game binds draw framebuffers)
+		glViewport(0, 0, bench_size.x, bench_size.y);
+		GL_ERRORS();
+	}
+
+	//timeline captures (see the F12 key, below):
+	TraceWriter trace;
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
 		{ //(1) process any events that are pending
-			static SDL_Event evt;
-			while (SDL_PollEvent(&evt)) {
-				//handle resizing:
-				if (evt.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED) {
-					on_resize();
-				}
-				//handle input:
-				if (Mode::current && Mode::current->handle_event(evt, window_size)) {
+			PROFILE_SCOPE("events");
+			if (replay && replay_timings.size() == replay->frames.size()) {
+				//(end of the recorded session)
+				Mode::set_current(nullptr);
+				break;
+			}
+			if (recording) recording->begin_frame(window_size);
+
+			//'replayed' events come from a recording -- the hotkeys below are skipped for those,
+			// since toggling the overlay, saving screenshots, or capturing traces would skew the timings being replayed:
+			auto handle_input = [&](SDL_Event const &evt, glm::uvec2 const &size, bool replayed) {
+				if (Mode::current && Mode::current->handle_event(evt, size)) {
 					// mode handled it; great
 				} else if (evt.type == SDL_EVENT_QUIT) {
 					Mode::set_current(nullptr);
-					break;
+				} else if (replayed) {
+					// (no hotkeys during replay)
+				} else if (evt.type == SDL_EVENT_KEY_DOWN && evt.key.key == SDLK_F3) {
+					// --- profiler overlay key ---
+					Profiler::get().show_overlay = !Profiler::get().show_overlay;
 				} else if (evt.type == SDL_EVENT_KEY_DOWN && evt.key.key == SDLK_PRINTSCREEN) {
 					// --- screenshot key ---
 					std::string filename = "screenshot.png";
@@ -166,36 +303,142 @@ int main(int argc, char **argv) {
 						px.a = 0xff;
 					}
 					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+				} else if (evt.type == SDL_EVENT_KEY_DOWN && evt.key.key == SDLK_F12) {
+					// --- trace capture key (press again to stop early) ---
+					if (trace.capturing()) trace.stop();
+					else trace.start("trace.json", 5.0f);
+				}
+			};
+
+			static SDL_Event evt;
+			while (SDL_PollEvent(&evt)) {
+				//handle resizing:
+				if (evt.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED && !bench) {
+					on_resize();
+				}
+				//during a replay, live input is ignored (apart from closing the window):
+				if (replay) {
+					if (evt.type == SDL_EVENT_QUIT) Mode::set_current(nullptr);
+					if (!Mode::current) break;
+					continue;
+				}
+				if (recording) recording->add_event(evt);
+				//handle input:
+				handle_input(evt, window_size, false);
+				if (!Mode::current) break;
+			}
+			if (replay && Mode::current) {
+				//recorded input for this frame, with the window size it was recorded at:
+				InputLog::Frame const &frame = replay->frames[replay_timings.size()];
+				for (uint32_t e = frame.event_begin; e < frame.event_begin + frame.event_count; ++e) {
+					handle_input(replay->events[e], glm::uvec2(frame.window_width, frame.window_height), true);
+					if (!Mode::current) break;
 				}
 			}
 			if (!Mode::current) break;
 		}
 
+		float elapsed = 0.0f; //(as passed to update, for the recording)
+		float update_seconds = 0.0f, draw_seconds = 0.0f; //(frame timings, for recording or replay)
+
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
+			PROFILE_SCOPE("update");
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
-			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
+			elapsed = std::chrono::duration< float >(current_time - previous_time).count();
 			previous_time = current_time;
 
 			//if frames are taking a very long time to process,
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
-			Mode::current->update(elapsed);
+			//replays step exactly as the recording did:
+			if (replay) elapsed = replay->frames[replay_timings.size()].elapsed;
+
+			if (Mode::current->fixed_timestep > 0.0f) {
+				//run as many fixed steps as real time allows (carrying the remainder to the next frame):
+				static float accumulated = 0.0f;
+				std::shared_ptr< Mode > mode = Mode::current;
+				float step = mode->fixed_timestep;
+				accumulated += elapsed;
+				uint32_t steps = 0;
+				while (accumulated >= step && steps < mode->max_steps_per_frame) {
+					mode->update(step);
+					accumulated -= step;
+					steps += 1;
+					if (Mode::current != mode) break;
+				}
+				if (!Mode::current) break;
+				if (Mode::current != mode) {
+					//(a new mode starts from scratch)
+					accumulated = 0.0f;
+					Mode::current->interpolation = 1.0f;
+				} else {
+					//(too far behind -- drop the backlog rather than falling further behind)
+					accumulated = std::min(accumulated, step);
+					mode->interpolation = std::min(accumulated / step, 1.0f);
+				}
+			} else {
+				Mode::current->interpolation = 1.0f;
+				Mode::current->update(elapsed);
+			}
+			update_seconds = std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - current_time).count();
 			if (!Mode::current) break;
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
-			Mode::current->draw(drawable_size);
+			PROFILE_SCOPE("draw");
+			auto before = std::chrono::high_resolution_clock::now();
+			{
+				PROFILE_GPU_SCOPE("draw");
+				Mode::current->draw(drawable_size);
+			}
+			if (bench) glFinish(); //(count the GPU's work too -- there's no swap to wait on it)
+			draw_seconds = std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - before).count();
+
+			if (Profiler::get().show_overlay) Profiler::get().draw_overlay(drawable_size);
 		}
 
+		if (recording) recording->end_frame(elapsed, update_seconds, draw_seconds);
+		if (replay) replay_timings.emplace_back(InputLog::Timing{update_seconds, draw_seconds});
+
 		//Wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(Mode::window);
+		if (!bench) {
+			PROFILE_SCOPE("swap");
+			SDL_GL_SwapWindow(Mode::window);
+		}
+		gl_state.next_frame();
+		Profiler::get().next_frame();
+		trace.add_frame(Profiler::get());
 	}
 
 
+	//------------  recording / replay results ------------
+	if (recording) {
+		//(the last frame ends early when the game quits during it)
+		if (recording->timings.size() < recording->frames.size()) recording->end_frame(0.0f, 0.0f, 0.0f);
+		std::cout << "Saving " << recording->frames.size() << " recorded frames to '" << record_file << "'." << std::endl;
+		recording->save(record_file);
+		recording->report(std::cout, "Recorded session");
+	}
+	if (replay) {
+		if (!replay->timings.empty()) replay->report(std::cout, "Recording of '" + replay_file + "'");
+		replay->timings = std::move(replay_timings);
+		replay->frames.resize(replay->timings.size()); //(in case the replay was cut short)
+		replay->report(std::cout, bench ? "Benchmark" : "This replay");
+		if (!timings_file.empty()) {
+			std::cout << "Saving replay timings to '" << timings_file << "'." << std::endl;
+			replay->save(timings_file);
+		}
+	}
+
 	//------------  teardown ------------
+	if (bench) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &bench_framebuffer);
+		glDeleteRenderbuffers(2, bench_renderbuffers);
+	}
+
 	Sound::shutdown();
 
 	SDL_GL_DestroyContext(context);
@@ -0,0 +1,823 @@
+/*
+ * scene-bench runs CPU-side scene benchmarks without opening a window.
+ *
+ * Usage:
+ *   scene-bench transforms <path/to/file.scene> [frames] [copies]
+ *     times per-frame world matrix computation for the transforms in a scene
+ *     ('copies' loads the scene several times over to make a bigger hierarchy)
+ *   scene-bench copy <path/to/file.scene> [frames] [copies]
+ *     times copying a scene (as PlayMode does when a level starts)
+ *   scene-bench bvh [count...]
+ *     times BVH build/refit/queries against linear scans over random boxes
+ *     (default counts: 1000 10000 100000)
+ *   scene-bench kernels [count...]
+ *     times TransformKernels against per-transform glm code on synthetic hierarchies
+ *     (default counts: 1000 10000 100000)
+ *   scene-bench grid [count...]
+ *     times SpatialGrid updates and radius / nearest / cone queries (every agent sensing its neighbors)
+ *     against linear scans, for wandering agents at constant density
+ *     (default counts: 100 1000 10000 50000)
+ *   scene-bench agents [count...]
+ *     times Agents patrol/vision updates on one thread and on the worker pool, for patrolling agents
+ *     watching a wandering target (and checks that both give the same results)
+ *     (default counts: 100 1000 10000 100000)
+ *   scene-bench interpolate [count...]
+ *     times fixed-timestep render interpolation (save / interpolate / restore) on synthetic hierarchies
+ *     (and checks that assigning a scene -- or replacing a transform -- forgets the old saved transforms)
+ *     (default counts: 1000 10000 100000)
+ *   scene-bench navmesh [size...]
+ *     times NavMesh building and path queries (uncached, cached, and through NavMesh::Requests)
+ *     on square floors 'size' units across, scattered with walls
+ *     (default sizes: 50 100 200)
+ *
+ */
+
+#include "Scene.hpp"
+#include "TransformKernels.hpp"
+#include "WorkerPool.hpp"
+#include "BVH.hpp"
+#include "Frustum.hpp"
+#include "SpatialGrid.hpp"
+#include "Agents.hpp"
+#include "NavMesh.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+//run 'fn' for 'frames' frames, report per-frame time:
+static void time_frames(std::string const &label, uint32_t frames, std::function< void(uint32_t) > const &fn) {
+	//warm up caches and such:
+	fn(0);
+
+	auto before = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 1; frame <= frames; ++frame) {
+		fn(frame);
+	}
+	auto after = std::chrono::high_resolution_clock::now();
+
+	double us = std::chrono::duration< double, std::micro >(after - before).count() / double(frames);
+	std::cout << "  " << std::left << std::setw(40) << label << std::right << std::setw(12) << std::fixed << std::setprecision(3) << us << " us/frame" << std::endl;
+}
+
+//(a sink so the compiler doesn't throw away benchmark results)
+static volatile float sink = 0.0f;
+
+static int bench_transforms(std::string const &scene_file, uint32_t frames, uint32_t copies) {
+	Scene scene;
+	for (uint32_t c = 0; c < copies; ++c) {
+		scene.load(scene_file);
+	}
+
+	//gather some statistics about the hierarchy:
+	uint32_t max_depth = 0;
+	uint64_t total_depth = 0;
+	std::vector< Scene::Transform * > roots, leaves;
+	{
+		std::vector< bool > has_child;
+		std::unordered_map< Scene::Transform const *, uint32_t > index;
+		for (auto &t : scene.transforms) {
+			index.emplace(&t, uint32_t(index.size()));
+		}
+		has_child.assign(index.size(), false);
+		for (auto &t : scene.transforms) {
+			uint32_t depth = 1;
+			for (Scene::Transform const *p = t.parent; p; p = p->parent) depth += 1;
+			max_depth = std::max(max_depth, depth);
+			total_depth += depth;
+			if (t.parent) has_child[index.at(t.parent)] = true;
+			else roots.emplace_back(&t);
+		}
+		for (auto &t : scene.transforms) {
+			if (!has_child[index.at(&t)]) leaves.emplace_back(&t);
+		}
+	}
+
+	std::cout << "(" << WorkerPool::get().size() << " worker threads; parallel_min_transforms is " << scene.parallel_min_transforms << ")" << std::endl;
+	std::cout << "Scene '" << scene_file << "' x" << copies << ": "
+		<< scene.transforms.size() << " transforms, "
+		<< roots.size() << " roots, "
+		<< leaves.size() << " leaves, "
+		<< "max depth " << max_depth << ", "
+		<< "mean depth " << (scene.transforms.empty() ? 0.0 : double(total_depth) / double(scene.transforms.size())) << "."
+		<< std::endl;
+
+	//the way Scene::draw used to work -- walk to the root for every transform, every frame:
+	std::function< glm::mat4x3(Scene::Transform const &) > walk_world_from_local = [&](Scene::Transform const &t) -> glm::mat4x3 {
+		if (!t.parent) return t.make_parent_from_local();
+		return walk_world_from_local(*t.parent) * glm::mat4(t.make_parent_from_local());
+	};
+
+	auto wiggle = [](Scene::Transform *t, uint32_t frame) {
+		t->rotation = glm::angleAxis(0.01f * float(frame & 1 ? 1 : -1), glm::vec3(0.0f, 0.0f, 1.0f)) * t->rotation;
+	};
+
+	time_frames("uncached walk (static)", frames, [&](uint32_t) {
+		for (auto const &t : scene.transforms) {
+			sink = sink + walk_world_from_local(t)[3].x;
+		}
+	});
+
+	time_frames("update_world_matrices (static)", frames, [&](uint32_t) {
+		scene.update_world_matrices();
+	});
+
+	time_frames("uncached walk (roots move)", frames, [&](uint32_t frame) {
+		for (auto t : roots) wiggle(t, frame);
+		for (auto const &t : scene.transforms) {
+			sink = sink + walk_world_from_local(t)[3].x;
+		}
+	});
+
+	time_frames("update_world_matrices (roots move)", frames, [&](uint32_t frame) {
+		for (auto t : roots) wiggle(t, frame);
+		scene.update_world_matrices();
+	});
+
+	time_frames("update_world_matrices (leaves move)", frames, [&](uint32_t frame) {
+		for (auto t : leaves) wiggle(t, frame);
+		scene.update_world_matrices();
+	});
+
+	//reading matrices afterward only touches the cache:
+	time_frames("make_world_from_local (every transform)", frames, [&](uint32_t) {
+		for (auto const &t : scene.transforms) {
+			sink = sink + t.make_world_from_local()[3].x;
+		}
+	});
+
+	//same again, forcing each of the serial and multi-threaded paths:
+	// (the default threshold picks between them automatically)
+	uint32_t default_threshold = scene.parallel_min_transforms;
+	for (uint32_t threshold : { -1U, 0U }) {
+		scene.parallel_min_transforms = threshold;
+		std::string suffix = (threshold == 0U ? std::string(", threads") : std::string(", serial"));
+		time_frames("update_world_matrices (roots move" + suffix + ")", frames, [&](uint32_t frame) {
+			for (auto t : roots) wiggle(t, frame);
+			scene.update_world_matrices();
+		});
+	}
+	scene.parallel_min_transforms = default_threshold;
+
+	return 0;
+}
+
+static int bench_copy(std::string const &scene_file, uint32_t frames, uint32_t copies) {
+	Scene scene;
+	for (uint32_t c = 0; c < copies; ++c) {
+		scene.load(scene_file);
+	}
+	//(give every transform a drawable, as a level scene might have)
+	for (auto &t : scene.transforms) {
+		scene.drawables.emplace_back(&t);
+	}
+	scene.update_world_matrices();
+
+	std::cout << "Scene '" << scene_file << "' x" << copies << ": "
+		<< scene.transforms.size() << " transforms, "
+		<< scene.drawables.size() << " drawables." << std::endl;
+
+	time_frames("copy", frames, [&](uint32_t) {
+		Scene copy(scene);
+		sink = sink + copy.transforms.back().position.x;
+	});
+
+	time_frames("copy + update_world_matrices", frames, [&](uint32_t) {
+		Scene copy(scene);
+		copy.update_world_matrices();
+		sink = sink + copy.streams.world_from_local.back()[3].x;
+	});
+
+	std::unordered_map< Scene::Transform const *, Scene::Transform * > transform_map;
+	time_frames("copy (with transform map)", frames, [&](uint32_t) {
+		Scene copy;
+		copy.set(scene, &transform_map);
+		sink = sink + copy.transforms.back().position.x;
+	});
+
+	return 0;
+}
+
+static int bench_bvh(std::vector< uint32_t > const &counts) {
+	for (uint32_t count : counts) {
+		//random boxes, spread so that density doesn't depend on count:
+		std::mt19937 mt(0xb0b0b0b0);
+		auto rnd = [&]() { return std::uniform_real_distribution< float >(0.0f, 1.0f)(mt); };
+		float world = 20.0f * std::cbrt(float(count));
+		std::vector< glm::vec3 > min(count), max(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			glm::vec3 center = world * glm::vec3(rnd(), rnd(), rnd());
+			glm::vec3 extent = glm::vec3(0.5f + 2.0f * rnd(), 0.5f + 2.0f * rnd(), 0.5f + 2.0f * rnd());
+			min[i] = center - extent;
+			max[i] = center + extent;
+		}
+
+		std::cout << count << " boxes:" << std::endl;
+		uint32_t frames = std::max(10U, 1000000U / count);
+
+		BVH bvh;
+		bvh.resize(count);
+		time_frames("build", std::max(3U, frames / 10), [&](uint32_t frame) {
+			bvh.resize(0);
+			bvh.resize(count);
+			for (uint32_t i = 0; i < count; ++i) bvh.set(i, min[i], max[i]);
+			bvh.update();
+		});
+
+		//move a tenth of the boxes a little each frame:
+		time_frames("refit (10% move)", frames, [&](uint32_t frame) {
+			glm::vec3 step = glm::vec3(0.1f * float(frame & 1 ? 1 : -1), 0.0f, 0.0f);
+			for (uint32_t i = frame % 10; i < count; i += 10) {
+				bvh.set(i, min[i] + step, max[i] + step);
+			}
+			bvh.update();
+		});
+		for (uint32_t i = 0; i < count; ++i) bvh.set(i, min[i], max[i]);
+		bvh.update();
+
+		//frustum: camera in the middle of the world looking along +x, 60 degree fov:
+		glm::mat4 clip_from_world(0.0f);
+		{
+			float f = 1.0f / std::tan(glm::radians(30.0f));
+			glm::mat4 projection(0.0f);
+			projection[0][0] = f; projection[1][1] = f;
+			projection[2][2] = -1.0f; projection[2][3] = -1.0f; projection[3][2] = -0.2f;
+			//view: camera at center, -z along +x, +y along +z:
+			glm::vec3 eye = glm::vec3(0.5f * world);
+			glm::mat4 view(1.0f);
+			view[0] = glm::vec4(0.0f, 0.0f, -1.0f, 0.0f); //world x -> view -z
+			view[1] = glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f); //world y -> view -x
+			view[2] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f); //world z -> view y
+			view[3] = glm::vec4(glm::vec3(view * glm::vec4(-eye, 0.0f)), 1.0f);
+			clip_from_world = projection * view;
+		}
+		Frustum frustum = Frustum::from_clip(clip_from_world);
+
+		Frustum::Boxes boxes;
+		boxes.resize(count);
+		for (uint32_t i = 0; i < count; ++i) boxes.set(i, glm::mat4x3(1.0f), min[i], max[i]);
+		std::vector< uint8_t > visible(count);
+		uint32_t linear_visible = 0, bvh_visible = 0;
+		time_frames("frustum: linear (SIMD batch)", frames, [&](uint32_t) {
+			linear_visible = frustum.test(boxes, visible.data());
+		});
+		time_frames("frustum: bvh", frames, [&](uint32_t) {
+			bvh_visible = 0;
+			bvh.for_each_in_frustum(frustum, [&](uint32_t) { bvh_visible += 1; });
+		});
+
+		//small box and ray queries:
+		constexpr uint32_t Queries = 100;
+		std::vector< glm::vec3 > q_min(Queries), q_max(Queries), r_from(Queries), r_dir(Queries);
+		for (uint32_t q = 0; q < Queries; ++q) {
+			glm::vec3 center = world * glm::vec3(rnd(), rnd(), rnd());
+			q_min[q] = center - glm::vec3(5.0f);
+			q_max[q] = center + glm::vec3(5.0f);
+			r_from[q] = world * glm::vec3(rnd(), rnd(), rnd());
+			r_dir[q] = 50.0f * glm::normalize(glm::vec3(rnd() - 0.5f, rnd() - 0.5f, rnd() - 0.5f));
+		}
+		auto overlaps = [&](uint32_t i, uint32_t q) {
+			return min[i].x <= q_max[q].x && q_min[q].x <= max[i].x
+			    && min[i].y <= q_max[q].y && q_min[q].y <= max[i].y
+			    && min[i].z <= q_max[q].z && q_min[q].z <= max[i].z;
+		};
+		uint32_t linear_overlaps = 0, bvh_overlaps = 0;
+		time_frames("100 box queries: linear", frames, [&](uint32_t) {
+			linear_overlaps = 0;
+			for (uint32_t q = 0; q < Queries; ++q) {
+				for (uint32_t i = 0; i < count; ++i) linear_overlaps += overlaps(i, q);
+			}
+		});
+		time_frames("100 box queries: bvh", frames, [&](uint32_t) {
+			bvh_overlaps = 0;
+			for (uint32_t q = 0; q < Queries; ++q) {
+				bvh.for_each_overlapping(q_min[q], q_max[q], [&](uint32_t) { bvh_overlaps += 1; });
+			}
+		});
+
+		auto ray_hits = [&](uint32_t i, uint32_t q) {
+			float t_min = 0.0f, t_max = 1.0f;
+			for (int c = 0; c < 3; ++c) {
+				float t0 = (min[i][c] - r_from[q][c]) / r_dir[q][c];
+				float t1 = (max[i][c] - r_from[q][c]) / r_dir[q][c];
+				t_min = std::max(t_min, std::min(t0, t1));
+				t_max = std::min(t_max, std::max(t0, t1));
+			}
+			return t_min <= t_max;
+		};
+		uint32_t linear_rays = 0, bvh_rays = 0;
+		time_frames("100 ray queries (any hit): linear", frames, [&](uint32_t) {
+			linear_rays = 0;
+			for (uint32_t q = 0; q < Queries; ++q) {
+				for (uint32_t i = 0; i < count; ++i) {
+					if (ray_hits(i, q)) { linear_rays += 1; break; }
+				}
+			}
+		});
+		time_frames("100 ray queries (any hit): bvh", frames, [&](uint32_t) {
+			bvh_rays = 0;
+			for (uint32_t q = 0; q < Queries; ++q) {
+				bvh.for_each_on_ray(r_from[q], r_dir[q], 1.0f, [&](uint32_t, float) { bvh_rays += 1; return true; });
+			}
+		});
+
+		if (linear_visible != bvh_visible || linear_overlaps != bvh_overlaps || linear_rays != bvh_rays) {
+			std::cerr << "  (bvh results don't match linear results: "
+				<< bvh_visible << " vs " << linear_visible << " visible, "
+				<< bvh_overlaps << " vs " << linear_overlaps << " overlaps, "
+				<< bvh_rays << " vs " << linear_rays << " rays hit)" << std::endl;
+			return 1;
+		}
+		std::cout << "  (" << bvh_visible << " visible, " << bvh_overlaps << " overlaps, " << bvh_rays << " rays hit; "
+			<< bvh.nodes.size() << " nodes, cost " << bvh.cost << ")" << std::endl;
+	}
+	return 0;
+}
+
+static int bench_kernels(std::vector< uint32_t > const &counts) {
+	std::vector< TransformKernels const * > kernels = TransformKernels::available();
+	std::cout << "Selected kernels: " << TransformKernels::get().name << std::endl;
+
+	for (uint32_t count : counts) {
+		//synthetic hierarchy -- a forest of chains and fans, parents before children:
+		std::mt19937 mt(0xfeedf00d);
+		std::vector< uint32_t > parent(count);
+		std::vector< glm::vec3 > position(count), scale(count);
+		std::vector< glm::quat > rotation(count);
+		auto rnd = [&]() { return std::uniform_real_distribution< float >(-1.0f, 1.0f)(mt); };
+		for (uint32_t i = 0; i < count; ++i) {
+			if (i == 0 || mt() % 16 == 0) parent[i] = -1U;
+			else parent[i] = i - 1 - uint32_t(mt() % std::min(i, 4U));
+			position[i] = glm::vec3(rnd(), rnd(), rnd());
+			rotation[i] = glm::normalize(glm::quat(rnd(), rnd(), rnd(), rnd()));
+			scale[i] = glm::vec3(1.0f + 0.1f * rnd(), 1.0f + 0.1f * rnd(), 1.0f + 0.1f * rnd());
+		}
+
+		std::cout << count << " transforms:" << std::endl;
+
+		uint32_t frames = std::max(10U, 10000000U / count);
+
+		//per-transform glm code, the way Scene::Transform computes matrices:
+		std::vector< glm::mat4x3 > reference(count);
+		time_frames("per-transform glm", frames, [&](uint32_t) {
+			for (uint32_t i = 0; i < count; ++i) {
+				glm::mat3 rot = glm::mat3_cast(rotation[i]);
+				glm::mat4x3 parent_from_local(
+					rot[0] * scale[i].x,
+					rot[1] * scale[i].y,
+					rot[2] * scale[i].z,
+					position[i]
+				);
+				if (parent[i] == -1U) reference[i] = parent_from_local;
+				else reference[i] = reference[parent[i]] * glm::mat4(parent_from_local);
+			}
+			sink = sink + reference[count-1][3].x;
+		});
+
+		for (TransformKernels const *k : kernels) {
+			std::vector< glm::mat4x3 > matrices(count);
+			time_frames(std::string("kernels: ") + k->name, frames, [&](uint32_t) {
+				k->trs_to_mat4x3(count, position.data(), rotation.data(), scale.data(), matrices.data());
+				k->propagate(0, count, parent.data(), matrices.data());
+				sink = sink + matrices[count-1][3].x;
+			});
+			if (std::memcmp(matrices.data(), reference.data(), sizeof(glm::mat4x3) * count) != 0) {
+				std::cerr << "  (kernels '" << k->name << "' do not match per-transform results!)" << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int bench_grid(std::vector< uint32_t > const &counts) {
+	for (uint32_t count : counts) {
+		//agents on a plane, spread so that density doesn't depend on count:
+		std::mt19937 mt(0x5eed5eed);
+		auto rnd = [&]() { return std::uniform_real_distribution< float >(0.0f, 1.0f)(mt); };
+		float world = 4.0f * std::sqrt(float(count)); //(about 1/16 agent per square unit)
+		Scene scene;
+		std::vector< Scene::Transform * > agents;
+		std::vector< glm::vec3 > heading;
+		for (uint32_t i = 0; i < count; ++i) {
+			scene.transforms.emplace_back();
+			agents.emplace_back(&scene.transforms.back());
+			agents.back()->position = glm::vec3(world * rnd(), world * rnd(), 0.0f);
+			float angle = 6.2831853f * rnd();
+			heading.emplace_back(std::cos(angle), std::sin(angle), 0.0f);
+		}
+
+		std::cout << count << " agents:" << std::endl;
+		uint32_t frames = std::max(10U, 1000000U / count);
+
+		constexpr float Radius = 8.0f; //sensing radius
+		constexpr uint32_t K = 8; //neighbors for nearest queries
+		float const cos_half_fov = std::cos(glm::radians(35.0f));
+
+		scene.update_world_matrices();
+		SpatialGrid grid(Radius);
+		for (auto *agent : agents) grid.insert(agent);
+
+		//wander: everyone steps along their heading each frame (bouncing off the edges):
+		auto step = [&]() {
+			for (uint32_t i = 0; i < count; ++i) {
+				glm::vec3 &p = agents[i]->position;
+				p += 0.1f * heading[i];
+				if (p.x < 0.0f || p.x > world) heading[i].x = -heading[i].x;
+				if (p.y < 0.0f || p.y > world) heading[i].y = -heading[i].y;
+			}
+			scene.update_world_matrices();
+		};
+		uint32_t relinked = 0;
+		time_frames("move + update", frames, [&](uint32_t) {
+			step();
+			grid.update();
+			relinked += grid.relinked;
+		});
+
+		uint64_t grid_radius = 0, grid_cone = 0, grid_nearest = 0;
+		time_frames("radius queries: grid", frames, [&](uint32_t) {
+			grid_radius = 0;
+			for (uint32_t i = 0; i < count; ++i) {
+				grid.for_each_in_radius(grid.position(i), Radius, [&](uint32_t, float) { grid_radius += 1; });
+			}
+		});
+		time_frames("cone queries: grid", frames, [&](uint32_t) {
+			grid_cone = 0;
+			for (uint32_t i = 0; i < count; ++i) {
+				grid.for_each_in_cone(grid.position(i), heading[i], cos_half_fov, Radius, [&](uint32_t, float) { grid_cone += 1; });
+			}
+		});
+		std::vector< uint32_t > ids;
+		time_frames("nearest (k = 8) queries: grid", frames, [&](uint32_t) {
+			grid_nearest = 0;
+			for (uint32_t i = 0; i < count; ++i) {
+				grid.nearest(grid.position(i), K, &ids, i);
+				grid_nearest += ids.size();
+			}
+		});
+
+		//the O(N^2) scans being replaced (skipped when they'd take forever):
+		if (count <= 10000) {
+			uint32_t linear_frames = std::max(3U, frames / 10);
+			uint64_t linear_radius = 0, linear_cone = 0;
+			time_frames("radius queries: linear", linear_frames, [&](uint32_t) {
+				linear_radius = 0;
+				for (uint32_t i = 0; i < count; ++i) {
+					glm::vec3 const &a = grid.position(i);
+					for (uint32_t j = 0; j < count; ++j) {
+						glm::vec3 d = grid.position(j) - a;
+						if (glm::dot(d, d) <= Radius * Radius) linear_radius += 1;
+					}
+				}
+			});
+			time_frames("cone queries: linear", linear_frames, [&](uint32_t) {
+				linear_cone = 0;
+				for (uint32_t i = 0; i < count; ++i) {
+					glm::vec3 const &a = grid.position(i);
+					for (uint32_t j = 0; j < count; ++j) {
+						glm::vec3 d = grid.position(j) - a;
+						float d2 = glm::dot(d, d);
+						if (d2 == 0.0f || d2 > Radius * Radius) continue;
+						float along = glm::dot(d, heading[i]);
+						if (along * std::abs(along) >= cos_half_fov * cos_half_fov * d2) linear_cone += 1;
+					}
+				}
+			});
+			if (linear_radius != grid_radius || linear_cone != grid_cone) {
+				std::cerr << "  (grid results don't match linear results: "
+					<< grid_radius << " vs " << linear_radius << " in radius, "
+					<< grid_cone << " vs " << linear_cone << " in cone)" << std::endl;
+				return 1;
+			}
+		} else {
+			std::cout << "  (linear scans skipped for more than 10000 agents)" << std::endl;
+		}
+
+		std::cout << "  (" << double(grid_radius) / count << " in radius, " << double(grid_cone) / count << " in cone, "
+			<< double(grid_nearest) / count << " nearest per agent; "
+			<< double(relinked) / (frames + 1) << " relinked per update, " << grid.buckets.size() << " buckets)" << std::endl;
+	}
+	return 0;
+}
+
+static int bench_agents(std::vector< uint32_t > const &counts) {
+	for (uint32_t count : counts) {
+		//two identical crowds -- one updated on one thread, one on the worker pool:
+		struct Crowd {
+			Scene scene;
+			Agents agents;
+			Scene::Transform *target = nullptr;
+		} crowds[2];
+
+		float world = 4.0f * std::sqrt(float(count)); //(about 1/16 agent per square unit)
+		for (Crowd &crowd : crowds) {
+			std::mt19937 mt(0xa6e475);
+			auto rnd = [&]() { return std::uniform_real_distribution< float >(0.0f, 1.0f)(mt); };
+
+			crowd.scene.transforms.emplace_back();
+			crowd.target = &crowd.scene.transforms.back();
+			crowd.target->position = glm::vec3(0.5f * world, 0.5f * world, 1.0f);
+
+			for (uint32_t i = 0; i < count; ++i) {
+				crowd.scene.transforms.emplace_back();
+				Scene::Transform *agent = &crowd.scene.transforms.back();
+				agent->position = glm::vec3(world * rnd(), world * rnd(), 0.0f);
+				agent->rotation = glm::angleAxis(6.2831853f * rnd(), glm::vec3(0.0f, 0.0f, 1.0f));
+
+				Agents::Params params;
+				params.speed = 2.0f + 4.0f * rnd();
+				params.view_distance = 6.0f + 6.0f * rnd();
+				params.fov_degrees = 50.0f + 60.0f * rnd();
+				params.eye = glm::vec3(0.0f, 0.0f, 1.5f);
+				float R = 2.0f + 6.0f * rnd();
+				glm::vec3 p = agent->position;
+				crowd.agents.add(agent, params, {
+					p + glm::vec3(0.0f, R, 0.0f), p + glm::vec3(R, 0.0f, 0.0f),
+					p + glm::vec3(0.0f, -R, 0.0f), p + glm::vec3(-R, 0.0f, 0.0f)
+				});
+			}
+		}
+		crowds[0].agents.parallel_threshold = -1U;
+		crowds[1].agents.parallel_threshold = 0;
+
+		std::cout << count << " agents (" << WorkerPool::get().size() + 1 << " threads available):" << std::endl;
+		uint32_t frames = std::max(10U, 2000000U / count);
+
+		//the target wanders through the crowd in a big circle:
+		auto target_at = [&](uint32_t frame) {
+			float angle = 0.01f * float(frame);
+			return glm::vec3(0.5f * world + 0.4f * world * std::cos(angle), 0.5f * world + 0.4f * world * std::sin(angle), 1.0f);
+		};
+
+		uint64_t watching[2] = { 0, 0 }, latched[2] = { 0, 0 };
+		char const *labels[2] = { "update: one thread", "update: worker pool" };
+		for (uint32_t c = 0; c < 2; ++c) {
+			Crowd &crowd = crowds[c];
+			time_frames(labels[c], frames, [&](uint32_t frame) {
+				crowd.target->position = target_at(frame);
+				crowd.scene.update_world_matrices();
+				crowd.agents.update(1.0f / 60.0f, crowd.target->position);
+				watching[c] += crowd.agents.watching_count;
+				latched[c] += crowd.agents.latched_count;
+			});
+		}
+
+		//the same arithmetic runs in both cases, so results should be identical:
+		for (uint32_t i = 0; i < count; ++i) {
+			Scene::Transform const *a = crowds[0].agents.transforms[i], *b = crowds[1].agents.transforms[i];
+			if (a->position != b->position || a->rotation != b->rotation || crowds[0].agents.latched[i] != crowds[1].agents.latched[i]) {
+				std::cerr << "  (agent " << i << " differs between one-thread and worker pool updates)" << std::endl;
+				return 1;
+			}
+		}
+
+		std::cout << "  (" << double(watching[0]) / (frames + 1) << " watching, "
+			<< double(latched[0]) / (frames + 1) << " latched per update)" << std::endl;
+	}
+	return 0;
+}
+
+static int bench_interpolate(std::vector< uint32_t > const &counts) {
+	for (uint32_t count : counts) {
+		//synthetic hierarchies -- forests of chains and fans, parents before children:
+		auto build = [&](Scene &scene, uint32_t seed) {
+			std::mt19937 mt(seed);
+			auto rnd = [&]() { return std::uniform_real_distribution< float >(-1.0f, 1.0f)(mt); };
+			std::vector< Scene::Transform * > made;
+			for (uint32_t i = 0; i < count; ++i) {
+				scene.transforms.emplace_back();
+				Scene::Transform *t = &scene.transforms.back();
+				if (i > 0 && mt() % 16 != 0) t->parent = made[i - 1 - uint32_t(mt() % std::min(i, 4U))];
+				t->position = glm::vec3(rnd(), rnd(), rnd());
+				t->rotation = glm::normalize(glm::quat(rnd(), rnd(), rnd(), rnd()));
+				made.emplace_back(t);
+			}
+			scene.update_world_matrices();
+			return made;
+		};
+		Scene scene, other;
+		std::vector< Scene::Transform * > made = build(scene, 0x1e4f);
+		build(other, 0xc0ffee);
+
+		//one transform in eight moves each step:
+		std::vector< Scene::Transform * > moving;
+		for (uint32_t i = 0; i < count; i += 8) moving.emplace_back(made[i]);
+		auto step = [&]() {
+			for (auto t : moving) {
+				t->position.x += 0.01f;
+				t->rotation = glm::normalize(t->rotation * glm::angleAxis(0.01f, glm::vec3(0.0f, 0.0f, 1.0f)));
+			}
+		};
+
+		std::cout << count << " transforms (" << moving.size() << " moving):" << std::endl;
+		uint32_t frames = std::max(10U, 2000000U / count);
+
+		time_frames("save_previous_transforms + step", frames, [&](uint32_t) {
+			scene.save_previous_transforms();
+			step();
+		});
+
+		time_frames("interpolate + restore_transforms", frames, [&](uint32_t frame) {
+			scene.interpolate_transforms(float(frame % 8) / 8.0f);
+			sink = sink + scene.streams.world_from_local.back()[3].x;
+			scene.restore_transforms();
+		});
+
+		//assigning a scene over one with saved (and interpolated) transforms must forget them:
+		// (blending with -- or restoring -- transforms that no longer exist would write through dangling pointers)
+		scene.save_previous_transforms();
+		step();
+		scene.interpolate_transforms(0.5f);
+		scene = other;
+		scene.interpolate_transforms(0.5f);
+		scene.restore_transforms();
+		for (auto a = scene.transforms.begin(), b = other.transforms.begin(); b != other.transforms.end(); ++a, ++b) {
+			if (a->position != b->position || a->rotation != b->rotation || a->scale != b->scale
+			 || a->make_world_from_local() != b->make_world_from_local()) {
+				std::cerr << "  (assigned scene was blended with the previous scene's saved transforms!)" << std::endl;
+				return 1;
+			}
+		}
+
+		//...and so must removing one transform and adding another, before interpolating or before restoring:
+		// (the count doesn't change, and the new transform may well reuse the removed one's memory)
+		// (the last transform is removed, since it is nobody's parent)
+		glm::vec3 const placed = glm::vec3(1.0f, 2.0f, 3.0f);
+		for (bool while_interpolated : { false, true }) {
+			scene.save_previous_transforms();
+			for (auto &t : scene.transforms) t.position.z += 1.0f;
+			if (while_interpolated) scene.interpolate_transforms(0.5f);
+			scene.transforms.pop_back();
+			scene.transforms.emplace_back();
+			scene.transforms.back().position = placed;
+			if (!while_interpolated) scene.interpolate_transforms(0.5f);
+			scene.restore_transforms();
+			scene.update_world_matrices();
+			if (scene.transforms.back().position != placed || scene.transforms.back().make_world_from_local()[3] != placed) {
+				std::cerr << "  (added transform was blended with a removed transform's saved values!)" << std::endl;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static int bench_navmesh(std::vector< uint32_t > const &sizes) {
+	for (uint32_t size : sizes) {
+		std::mt19937 mt(0x7a7a);
+		auto rnd = [&]() { return std::uniform_real_distribution< float >(0.0f, 1.0f)(mt); };
+		float world = float(size);
+
+		//floor, and walls (about one per 40 square units) of random length and direction:
+		std::vector< glm::vec3 > triangles;
+		auto quad = [&](glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d) {
+			triangles.insert(triangles.end(), { a, b, c, a, c, d });
+		};
+		quad(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(world, 0.0f, 0.0f), glm::vec3(world, world, 0.0f), glm::vec3(0.0f, world, 0.0f));
+		uint32_t walls = uint32_t(world * world / 40.0f);
+		for (uint32_t w = 0; w < walls; ++w) {
+			glm::vec2 a = glm::vec2(world * rnd(), world * rnd());
+			float angle = 6.2831853f * rnd();
+			glm::vec2 b = a + (1.0f + 5.0f * rnd()) * glm::vec2(std::cos(angle), std::sin(angle));
+			quad(glm::vec3(a, 0.0f), glm::vec3(b, 0.0f), glm::vec3(b, 2.5f), glm::vec3(a, 2.5f));
+		}
+
+		std::cout << size << "x" << size << " floor, " << walls << " walls:" << std::endl;
+
+		NavMesh::Params params;
+		std::unique_ptr< NavMesh > navmesh;
+		time_frames("build", 3, [&](uint32_t) {
+			navmesh = std::make_unique< NavMesh >(triangles, params);
+		});
+
+		//queries between random points (the same ones for every test):
+		constexpr uint32_t Queries = 1000;
+		std::vector< std::pair< glm::vec3, glm::vec3 > > queries;
+		for (uint32_t q = 0; q < Queries; ++q) {
+			queries.emplace_back(glm::vec3(world * rnd(), world * rnd(), 0.0f), glm::vec3(world * rnd(), world * rnd(), 0.0f));
+		}
+		std::vector< glm::vec3 > path;
+		uint32_t found = 0;
+		size_t points = 0;
+		navmesh->cache_capacity = 0;
+		time_frames("1000 queries: uncached", 5, [&](uint32_t) {
+			found = 0;
+			points = 0;
+			for (auto const &q : queries) {
+				if (navmesh->find_path(q.first, q.second, &path)) {
+					found += 1;
+					points += path.size();
+				}
+			}
+		});
+		uint32_t expanded = navmesh->nodes_expanded / (6 * Queries);
+
+		navmesh->cache_capacity = 2 * Queries;
+		time_frames("1000 queries: cached", 5, [&](uint32_t) {
+			for (auto const &q : queries) {
+				navmesh->find_path(q.first, q.second, &path);
+			}
+		});
+
+		navmesh->cache_capacity = 0;
+		navmesh->clear_cache();
+		time_frames("1000 queries: requests (uncached)", 5, [&](uint32_t) {
+			NavMesh::Requests requests(*navmesh);
+			std::vector< uint32_t > tickets;
+			for (auto const &q : queries) {
+				tickets.emplace_back(requests.request(q.first, q.second));
+			}
+			for (uint32_t ticket : tickets) {
+				while (requests.take(ticket, &path) == NavMesh::Requests::Pending) {
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		std::cout << "  (" << navmesh->polys.size() << " regions, " << navmesh->links.size() << " portals; "
+			<< found << " of " << Queries << " queries found paths, " << double(points) / std::max(1U, found) << " points per path, "
+			<< expanded << " regions expanded per search)" << std::endl;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	std::vector< std::string > args(argv + 1, argv + argc);
+
+	auto usage = [&]() {
+		std::cerr << "Usage:\n"
+			<< "\t" << argv[0] << " transforms <path/to/file.scene> [frames] [copies]\n"
+			<< "\t" << argv[0] << " copy <path/to/file.scene> [frames] [copies]\n"
+			<< "\t" << argv[0] << " bvh [count...]\n"
+			<< "\t" << argv[0] << " kernels [count...]\n"
+			<< "\t" << argv[0] << " grid [count...]\n"
+			<< "\t" << argv[0] << " agents [count...]\n"
+			<< "\t" << argv[0] << " interpolate [count...]\n"
+			<< "\t" << argv[0] << " navmesh [size...]\n"
+			<< std::flush;
+		return 1;
+	};
+
+	if (args.empty()) return usage();
+
+	if (args[0] == "transforms" || args[0] == "copy") {
+		if (args.size() < 2 || args.size() > 4) return usage();
+		uint32_t frames = (args.size() >= 3 ? uint32_t(std::stoul(args[2])) : 1000);
+		uint32_t copies = (args.size() >= 4 ? uint32_t(std::stoul(args[3])) : 1);
+		if (frames == 0 || copies == 0) return usage();
+		if (args[0] == "copy") return bench_copy(args[1], frames, copies);
+		else return bench_transforms(args[1], frames, copies);
+	} else if (args[0] == "kernels" || args[0] == "bvh" || args[0] == "grid" || args[0] == "agents" || args[0] == "interpolate" || args[0] == "navmesh") {
+		std::vector< uint32_t > counts;
+		for (size_t i = 1; i < args.size(); ++i) {
+			counts.emplace_back(uint32_t(std::stoul(args[i])));
+			if (counts.back() == 0) return usage();
+		}
+		if (args[0] == "grid") {
+			if (counts.empty()) counts = { 100, 1000, 10000, 50000 };
+			return bench_grid(counts);
+		}
+		if (args[0] == "agents") {
+			if (counts.empty()) counts = { 100, 1000, 10000, 100000 };
+			return bench_agents(counts);
+		}
+		if (args[0] == "interpolate") {
+			if (counts.empty()) counts = { 1000, 10000, 100000 };
+			return bench_interpolate(counts);
+		}
+		if (args[0] == "navmesh") {
+			if (counts.empty()) counts = { 50, 100, 200 };
+			return bench_navmesh(counts);
+		}
+		if (counts.empty()) counts = { 1000, 10000, 100000 };
+		if (args[0] == "bvh") return bench_bvh(counts);
+		else return bench_kernels(counts);
+	} else {
+		return usage();
+	}
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -2,6 +2,8 @@
 #include "ShowMeshesMode.hpp"
 #include "Load.hpp"
 #include "GL.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
 #include "load_save_png.hpp"
 
 #include <SDL3/SDL.h>
@@ -179,6 +181,8 @@ int main(int argc, char **argv) {
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
 		SDL_GL_SwapWindow(Mode::window);
+		gl_state.next_frame();
+		Profiler::get().next_frame();
 	}
 
 
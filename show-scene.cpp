@@ -2,8 +2,11 @@
 #include "ShowSceneMode.hpp"
 #include "Load.hpp"
 #include "GL.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
 #include "load_save_png.hpp"
 #include "ShowSceneProgram.hpp"
+#include "StaticBatches.hpp"
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
@@ -124,6 +127,8 @@ int main(int argc, char **argv) {
 				drawable.pipeline.start = mesh.start;
 				drawable.pipeline.count = mesh.count;
 
+				drawable.min = mesh.min;
+				drawable.max = mesh.max;
 			});
 		} catch (std::exception &e) {
 			std::cerr << "ERROR loading scene '" << scene_file << "': " << e.what() << std::endl;
@@ -144,7 +149,19 @@ int main(int argc, char **argv) {
 	} else {
 		std::cout << " no meshes -- consider passing a '.pnct' file as the second argument." << std::endl;
 	}
-	Mode::set_current(std::make_shared< ShowSceneMode >(*scene));
+
+	//nothing moves in this viewer, so everything can be baked into static batches:
+	StaticBatches *batches = nullptr;
+	if (buffer) {
+		batches = new StaticBatches(*scene, *buffer, buffer_vao, [](Scene::Drawable const &) { return true; });
+		std::cout << "Static batching: baked " << batches->baked << " drawables into " << batches->batches << " batches;"
+			<< " draw calls (nothing culled) " << batches->draws_before << " before, " << batches->draws_after << " after."
+			<< " Press 'B' to toggle." << std::endl;
+	}
+
+	auto mode = std::make_shared< ShowSceneMode >(*scene);
+	mode->static_batches = batches;
+	Mode::set_current(mode);
 
 	//------------ main loop ------------
 
@@ -221,6 +238,8 @@ int main(int argc, char **argv) {
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
 		SDL_GL_SwapWindow(Mode::window);
+		gl_state.next_frame();
+		Profiler::get().next_frame();
 	}
 
 